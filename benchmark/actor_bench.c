@@ -0,0 +1,146 @@
+// message passing between actors: the main script spawns pairs of actors, in each pair a producer sends a stream of messages to a consumer, which counts them
+// compares payloads that cross as they are (numbers), strings the compiler put into the shared table already (literals) and strings made at runtime, which are promoted into the shared table when they're sent
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/actor_bench.c $(ls c_lox/*.c | grep -v main.c) -o actor_bench.out -lpthread -lm
+//   ./actor_bench.out
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vm.h"
+
+#define MESSAGES 200000
+
+static char directory[] = "/tmp/actor_benchXXXXXX";
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void writeScript(
+  const char *name,
+  const char *source
+) {
+  char path[256];
+
+  snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+
+  fputs(source, file);
+  fclose(file);
+}
+
+static const char *payloads[][2] = {
+  {"number", "i"},
+  {"literal", "\"payload\""},
+  {"runtime", "\"pay\" + \"load\""},
+};
+
+static void measure(
+  int pairs,
+  int payload
+) {
+  char source[1024];
+
+  // the producer ends the stream with nil, and then tells the consumer where to report to
+  snprintf(
+    source,
+    sizeof(source),
+    "var consumer = spawn(\"%s/consumer.lox\");\n"
+    "for (var i = 0; i < %d; i = i + 1) send(consumer, %s);\n"
+    "send(consumer, nil);\n"
+    "send(consumer, parent());\n",
+    directory,
+    MESSAGES,
+    payloads[payload][1]
+  );
+
+  writeScript("producer.lox", source);
+
+  snprintf(
+    source,
+    sizeof(source),
+    "for (var i = 0; i < %d; i = i + 1) spawn(\"%s/producer.lox\");\n"
+    "var total = 0;\n"
+    "var count = receive();\n"
+    "while (count != nil) {\n"
+    "  total = total + count;\n"
+    "  count = receive();\n"
+    "}\n"
+    "if (total != %d) print \"lost messages\";\n",
+    pairs,
+    directory,
+    pairs * MESSAGES
+  );
+
+  VM vm;
+  double start = now();
+
+  initVM(&vm);
+  interpret(&vm, source);
+  freeVM(&vm);
+
+  double elapsed = now() - start;
+  double messages = (double)pairs * (MESSAGES + 1);
+
+  printf(
+    "  %-8s %2d pairs  %7.2f M messages/s  (%.3f s)\n",
+    payloads[payload][0],
+    pairs,
+    messages / elapsed / 1e6,
+    elapsed
+  );
+}
+
+int main() {
+  if (mkdtemp(directory) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  // counts what arrives and reports to the main script, the consumer's parent's parent
+  writeScript(
+    "consumer.lox",
+    "var count = 0;\n"
+    "var message = receive();\n"
+    "while (message != nil) {\n"
+    "  count = count + 1;\n"
+    "  message = receive();\n"
+    "}\n"
+    "send(receive(), count);\n"
+  );
+
+  printf("%d messages per pair\n", MESSAGES);
+
+  int counts[] = {1, 2, 4, 8};
+
+  for (int payload = 0; payload < 3; payload++) {
+    for (int i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++) {
+      measure(counts[i], payload);
+    }
+  }
+
+  char path[256];
+  const char *names[] = {"consumer.lox", "producer.lox"};
+
+  for (int i = 0; i < 2; i++) {
+    snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+    unlink(path);
+  }
+
+  rmdir(directory);
+
+  return 0;
+}
\ No newline at end of file
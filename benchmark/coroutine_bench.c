@@ -0,0 +1,132 @@
+// coroutines: how long a switch takes, and how little a suspended coroutine costs
+// - ping-pong: the main script resumes one coroutine that yields straight back, a million times
+// - pipeline: a chain of n coroutines, each one suspended and forwarding what it gets to the one before it, then a value sent through the whole chain
+// memory per coroutine is the coroutine objects plus their stacks, as the vm's heap counts them, divided by how many there are
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/coroutine_bench.c $(ls c_lox/*.c | grep -v main.c) -o coroutine_bench.out -lpthread -lm
+//   ./coroutine_bench.out
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "memory.h"
+#include "vm.h"
+
+#define SWITCHES 1000000
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static double run(
+  VM *vm,
+  const char *source
+) {
+  double start = now();
+
+  if (interpret(vm, source) != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(1);
+  }
+
+  return now() - start;
+}
+
+// includes the bytecode of both loops, a switch is a native call that swaps four pointers
+static void pingPong() {
+  char source[512];
+  VM vm;
+
+  snprintf(
+    source,
+    sizeof(source),
+    "var c = coroutine { while (true) yield(); };\n"
+    "for (var i = 0; i < %d; i = i + 1) resume(c);\n",
+    SWITCHES
+  );
+
+  initVM(&vm);
+
+  double seconds = run(&vm, source);
+
+  freeVM(&vm);
+
+  printf(
+    "ping-pong: %d resume/yield round trips in %.3f s, %.1f ns per switch\n",
+    SWITCHES,
+    seconds,
+    seconds / (2.0 * SWITCHES) * 1e9
+  );
+}
+
+// every stage remembers the one made before it (`last` when it first runs), adds one to what it gets, and hands it on
+static const char *chain =
+  "var last = nil;\n"
+  "for (var i = 0; i < %d; i = i + 1) {\n"
+  "  var stage = coroutine {\n"
+  "    var previous = last;\n"
+  "    var value = yield();\n"
+  "    while (true) {\n"
+  "      if (previous != nil) value = resume(previous, value);\n"
+  "      value = yield(value + 1);\n"
+  "    }\n"
+  "  };\n"
+  "  resume(stage);\n"
+  "  last = stage;\n"
+  "}\n";
+
+static void pipeline(int stages) {
+  char source[1024];
+  VM vm;
+
+  // just the chain first, for its memory and how long it takes to set up
+  int length = snprintf(source, sizeof(source), chain, stages);
+
+  initVM(&vm);
+
+  double build = run(&vm, source);
+
+  // the main script's stack (a few slots) is in there too
+  size_t bytes = vm.heap.bytes[MEMORY_OBJ_COROUTINE] + vm.heap.bytes[MEMORY_STACK];
+
+  freeVM(&vm);
+
+  // coroutines belong to the run that made them, so the value goes through in the same script
+  snprintf(
+    source + length,
+    sizeof(source) - length,
+    "if (resume(last, 0) != %d) print \"wrong result\";\n",
+    stages
+  );
+
+  initVM(&vm);
+
+  double total = run(&vm, source);
+
+  freeVM(&vm);
+
+  printf(
+    "pipeline of %7d: %6.1f bytes per suspended coroutine, made in %.3f s, one value through all of them in %.3f s (%.1f ns per stage)\n",
+    stages,
+    (double)bytes / stages,
+    build,
+    total - build,
+    (total - build) / stages * 1e9
+  );
+}
+
+int main() {
+  pingPong();
+
+  int stages[] = {10000, 100000, 1000000};
+
+  for (int i = 0; i < (int)(sizeof(stages) / sizeof(stages[0])); i++) {
+    pipeline(stages[i]);
+  }
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,275 @@
+// string hashing microbenchmarks: raw hashing throughput, and how well `vm.strings` (and a globals-style table) do with the hash on realistic identifier sets
+//
+// build and run from the repository root, once per hash function:
+//   cc -O2 -Ic_lox benchmark/hash_bench.c $(ls c_lox/*.c | grep -v main.c) -o hash_bench.out -lpthread -lm
+//   cc -O2 -Ic_lox -DSTRING_HASH_FNV1A benchmark/hash_bench.c $(ls c_lox/*.c | grep -v main.c) -o hash_bench_fnv.out -lpthread -lm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "memory.h"
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+static VM vm;
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// throughput
+
+static void throughput() {
+  static const int lengths[] = {3, 6, 8, 12, 16, 24, 32, 64, 256, 4096, 1 << 20};
+  int bufferSize = (1 << 20) + 64;
+  char *buffer = malloc(bufferSize);
+
+  for (int i = 0; i < bufferSize; i++) {
+    buffer[i] = 'a' + i % 26;
+  }
+
+  printf("throughput\n");
+
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+    int length = lengths[l];
+    long iterations = (256L << 20) / length;
+    uint32_t sink = 0;
+
+    if (iterations > 50000000) iterations = 50000000;
+
+    double start = now();
+
+    // shift the start around a bit so the compiler can't hoist the hash out of the loop
+    for (long i = 0; i < iterations; i++) {
+      sink += hashString(buffer + (i & 63), length);
+    }
+
+    double elapsed = now() - start;
+
+    printf(
+      "  %8d bytes  %8.2f ns/hash  %7.2f GB/s  (%08x)\n",
+      length,
+      elapsed * 1e9 / iterations,
+      (double)length * iterations / elapsed / 1e9,
+      sink
+    );
+  }
+
+  free(buffer);
+}
+
+// identifier sets
+
+typedef struct {
+  char **names;
+  int count;
+  int capacity;
+} Names;
+
+static void addName(
+  Names *names,
+  const char *name
+) {
+  if (names->count == names->capacity) {
+    names->capacity = names->capacity == 0 ? 1024 : names->capacity * 2;
+    names->names = realloc(names->names, sizeof(char *) * names->capacity);
+  }
+
+  names->names[names->count++] = strdup(name);
+}
+
+static void freeNames(Names *names) {
+  for (int i = 0; i < names->count; i++) {
+    free(names->names[i]);
+  }
+  free(names->names);
+}
+
+static const char *verbs[] = {
+  "get", "set", "is", "has", "make", "find", "add", "remove", "update", "read", "write", "parse", "emit", "load",
+  "store", "init", "free", "reset", "check", "build", "handle", "compute", "resolve", "print", "format", "to",
+};
+
+static const char *nouns[] = {
+  "User", "Name", "Count", "Index", "Value", "List", "Item", "Node", "Buffer", "Token", "Line", "Error", "Result",
+  "Config", "Path", "File", "Table", "Entry", "Key", "Size", "Length", "State", "Scope", "Frame", "Stack", "Chunk",
+  "String", "Number", "Id", "Time", "Width", "Height", "Color", "Point", "Total", "Price", "Order", "Account",
+};
+
+static const char *suffixes[] = {"", "s", "At", "By", "For", "Of", "2", "Tmp", "Old", "New"};
+
+#define LENGTH(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+// camelCase names like a real program's globals and properties, plus the usual short locals
+static void programIdentifiers(Names *names) {
+  char name[64];
+
+  for (int v = 0; v < LENGTH(verbs); v++) {
+    for (int n = 0; n < LENGTH(nouns); n++) {
+      for (int s = 0; s < LENGTH(suffixes); s++) {
+        snprintf(name, sizeof(name), "%s%s%s", verbs[v], nouns[n], suffixes[s]);
+        addName(names, name);
+      }
+    }
+  }
+
+  for (int n = 0; n < LENGTH(nouns); n++) {
+    for (int m = 0; m < LENGTH(nouns); m++) {
+      snprintf(name, sizeof(name), "%c%s%s", nouns[n][0] + 'a' - 'A', nouns[n] + 1, nouns[m]);
+      addName(names, name);
+    }
+  }
+
+  for (char c = 'a'; c <= 'z'; c++) {
+    for (int i = 0; i < 10; i++) {
+      snprintf(name, sizeof(name), "%c%d", c, i);
+      addName(names, name);
+    }
+  }
+}
+
+// generated code tends to look like this
+static void sequentialIdentifiers(Names *names) {
+  char name[32];
+
+  for (int i = 0; i < 100000; i++) {
+    snprintf(name, sizeof(name), "var%d", i);
+    addName(names, name);
+  }
+}
+
+// every 1 to 3 letter lowercase name
+static void shortIdentifiers(Names *names) {
+  char name[4] = {0};
+
+  for (int a = 0; a < 26; a++) {
+    name[0] = 'a' + a;
+    name[1] = '\0';
+    addName(names, name);
+
+    for (int b = 0; b < 26; b++) {
+      name[1] = 'a' + b;
+      name[2] = '\0';
+      addName(names, name);
+
+      for (int c = 0; c < 26; c++) {
+        name[2] = 'a' + c;
+        addName(names, name);
+      }
+    }
+  }
+}
+
+static int compareHashes(
+  const void *a,
+  const void *b
+) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void identifierSet(
+  const char *label,
+  Names *names
+) {
+  // a fresh vm, so `vm.strings` holds exactly this set
+  initVM(&vm);
+
+  double start = now();
+
+  ObjString **strings = malloc(sizeof(ObjString *) * names->count);
+
+  for (int i = 0; i < names->count; i++) {
+    strings[i] = copyString(&vm, names->names[i], (int)strlen(names->names[i]));
+  }
+
+  double elapsed = now() - start;
+
+  // full 32-bit collisions
+  uint32_t *hashes = malloc(sizeof(uint32_t) * names->count);
+
+  for (int i = 0; i < names->count; i++) {
+    hashes[i] = strings[i]->hash;
+  }
+
+  qsort(hashes, names->count, sizeof(uint32_t), compareHashes);
+
+  int collisions = 0;
+
+  for (int i = 1; i < names->count; i++) {
+    collisions += hashes[i] == hashes[i - 1];
+  }
+
+  InternStats internStats;
+  internSetStats(&vm.strings, &internStats);
+
+  // the same names as globals
+  Table globals;
+  initTable(&globals, &vm.heap);
+
+  for (int i = 0; i < names->count; i++) {
+    tableSet(&globals, strings[i], NIL_VAL);
+  }
+
+  TableStats tableStats_;
+  tableStats(&globals, &tableStats_);
+
+  printf(
+    "  %-10s %6d names  intern %6.1f ns/name  hash collisions %3d\n"
+    "             vm.strings: capacity %7d  probe avg %5.2f max %4d  displaced %5.1f%%\n"
+    "             globals:    capacity %7d  group probe avg %5.2f max %4d\n",
+    label,
+    names->count,
+    elapsed * 1e9 / names->count,
+    collisions,
+    vm.strings.capacity,
+    internStats.averageProbe,
+    internStats.maxProbe,
+    100.0 * internStats.displaced / names->count,
+    globals.capacity,
+    tableStats_.averageProbe,
+    tableStats_.maxProbe
+  );
+
+  freeTable(&globals);
+  free(hashes);
+  free(strings);
+
+  freeVM(&vm);
+}
+
+int main() {
+#ifdef STRING_HASH_FNV1A
+  printf("fnv-1a\n\n");
+#else
+  printf("word-at-a-time\n\n");
+#endif
+
+  throughput();
+
+  printf("\nidentifier sets\n");
+
+  Names program = {NULL, 0, 0};
+  Names sequential = {NULL, 0, 0};
+  Names shortNames = {NULL, 0, 0};
+
+  programIdentifiers(&program);
+  sequentialIdentifiers(&sequential);
+  shortIdentifiers(&shortNames);
+
+  identifierSet("program", &program);
+  identifierSet("sequential", &sequential);
+  identifierSet("short", &shortNames);
+
+  freeNames(&program);
+  freeNames(&sequential);
+  freeNames(&shortNames);
+
+  return 0;
+}
\ No newline at end of file
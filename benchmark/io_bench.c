@@ -0,0 +1,154 @@
+// async i/o: one vm, one thread, thousands of operations in flight on the event loop
+// - echo: a server and n clients in the same script, each client an async coroutine with its own connection over a unix domain socket, sending m messages one after the other
+// - timers: n coroutines sleeping at once, all of them woken by the loop after about the same time
+// both report the total and the time per operation, the clients' round trips overlap, so it's far less than one round trip each
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/io_bench.c $(ls c_lox/*.c | grep -v main.c) -o io_bench.out -lpthread -lm
+//   ./io_bench.out
+// every connection takes two fds, so the larger runs need a high enough `ulimit -n` (the benchmark raises it as far as it may)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vm.h"
+
+#define SOCKET_PATH "/tmp/clox_io_bench.sock"
+#define MESSAGES 100
+#define SLEEP_MS 50
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static double run(const char *source) {
+  VM vm;
+
+  initVM(&vm);
+
+  double start = now();
+
+  if (interpret(&vm, source) != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(1);
+  }
+
+  double seconds = now() - start;
+
+  freeVM(&vm);
+
+  return seconds;
+}
+
+// no closures, so the acceptor hands each connection over in `pending` and yields, so its handler picks it up before the next `accept`
+static const char *echo =
+  "var server = listen(\"" SOCKET_PATH "\");\n"
+  "var pending;\n"
+  "var clients = %d;\n"
+  "var finished = 0;\n"
+  "async(coroutine {\n"
+  "  for (var i = 0; i < clients; i = i + 1) {\n"
+  "    pending = accept(server);\n"
+  "    async(coroutine {\n"
+  "      var connection = pending;\n"
+  "      var data = read(connection);\n"
+  "      while (data != nil) {\n"
+  "        write(connection, data);\n"
+  "        data = read(connection);\n"
+  "      }\n"
+  "      close(connection);\n"
+  "    });\n"
+  "    yield();\n"
+  "  }\n"
+  "});\n"
+  "for (var i = 0; i < clients; i = i + 1) {\n"
+  "  async(coroutine {\n"
+  "    var connection = connect(\"" SOCKET_PATH "\");\n"
+  "    for (var j = 0; j < %d; j = j + 1) {\n"
+  "      write(connection, \"ping\");\n"
+  "      if (read(connection) != \"ping\") print \"wrong reply\";\n"
+  "    }\n"
+  "    close(connection);\n"
+  "    finished = finished + 1;\n"
+  "  });\n"
+  "}\n"
+  "loop();\n"
+  "close(server);\n"
+  "if (finished != clients) print \"lost a client\";\n";
+
+static void echoClients(int clients) {
+  char source[2048];
+
+  snprintf(source, sizeof(source), echo, clients, MESSAGES);
+
+  unlink(SOCKET_PATH);
+
+  double seconds = run(source);
+
+  unlink(SOCKET_PATH);
+
+  int trips = clients * MESSAGES;
+
+  printf(
+    "echo, %5d clients: %7d round trips in %.3f s, %6.2f us each, %9.0f per second\n",
+    clients,
+    trips,
+    seconds,
+    seconds / trips * 1e6,
+    trips / seconds
+  );
+}
+
+static const char *timers =
+  "for (var i = 0; i < %d; i = i + 1) async(coroutine { sleep(%d); });\n"
+  "loop();\n";
+
+static void sleepers(int count) {
+  char source[256];
+
+  snprintf(source, sizeof(source), timers, count, SLEEP_MS);
+
+  double seconds = run(source);
+
+  printf(
+    "timers, %7d coroutines sleeping %d ms at once: done in %.3f s, %.2f us of overhead each\n",
+    count,
+    SLEEP_MS,
+    seconds,
+    (seconds - SLEEP_MS / 1e3) / count * 1e6
+  );
+}
+
+int main() {
+  struct rlimit limit;
+
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  int clients[] = {1, 10, 100, 1000, 4000};
+
+  for (int i = 0; i < (int)(sizeof(clients) / sizeof(clients[0])); i++) {
+    // two fds per connection, and a few to spare
+    if ((rlim_t)clients[i] * 2 + 16 > limit.rlim_cur) {
+      printf("echo, %5d clients: skipped, `ulimit -n` is too low\n", clients[i]);
+      continue;
+    }
+
+    echoClients(clients[i]);
+  }
+
+  int counts[] = {1000, 10000, 100000};
+
+  for (int i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++) {
+    sleepers(counts[i]);
+  }
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+// mapped files read a line at a time: how many GB/s a script gets through a log file, and how much memory that takes
+// - count: the tightest loop, just `nextLine` until nil
+// - filter: compares every line against a string, which hashes it (so the reused line object really gets its contents read)
+// - keep: every 1000th line goes into a global, so those get their own copy, and the rest still reuse one object
+// for comparison, memchr over the same mapping in c, which is as fast as finding the lines can get
+// the file is written once, read once before timing (so it's in the page cache, without mapping it), and deleted at the end
+// max rss is for the whole process, the memchr baseline runs last since it keeps every page it touches
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/lines_bench.c $(ls c_lox/*.c | grep -v main.c) -o lines_bench.out -lpthread -lm
+//   ./lines_bench.out [megabytes]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vm.h"
+
+#define LOG_PATH "/tmp/clox_lines_bench.log"
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// log-like lines, 60 to 140 bytes each
+static long writeLog(long megabytes) {
+  FILE *file = fopen(LOG_PATH, "w");
+
+  if (file == NULL) {
+    fprintf(stderr, "can't write %s\n", LOG_PATH);
+    exit(1);
+  }
+
+  static const char *levels[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+  long size = 0;
+  long lines = 0;
+
+  srand(42);
+
+  while (size < megabytes * 1024 * 1024) {
+    int padding = rand() % 80;
+
+    size += fprintf(
+      file,
+      "2024-05-01T12:%02ld:%02ld.%03ld %-5s request=%08x took=%dms %.*s\n",
+      lines / 60 % 60,
+      lines % 60,
+      lines % 1000,
+      levels[lines % 4],
+      rand(),
+      rand() % 500,
+      padding,
+      "................................................................................"
+    );
+
+    lines++;
+  }
+
+  fclose(file);
+
+  return lines;
+}
+
+// what finding every line costs without any interpreter
+static void baseline(long expected) {
+  int fd = open(LOG_PATH, O_RDONLY);
+  struct stat info;
+
+  fstat(fd, &info);
+
+  const char *start = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  close(fd);
+
+  double begin = now();
+  const char *at = start;
+  const char *end = start + info.st_size;
+  long lines = 0;
+
+  while (at < end) {
+    const char *newline = memchr(at, '\n', end - at);
+
+    lines++;
+    at = newline == NULL ? end : newline + 1;
+  }
+
+  double seconds = now() - begin;
+
+  munmap((char *)start, info.st_size);
+
+  if (lines != expected) printf("baseline counted %ld lines instead of %ld\n", lines, expected);
+
+  printf("  %-8s %6.2f GB/s  %6.1f ns per line\n", "memchr", info.st_size / seconds / 1e9, seconds / lines * 1e9);
+}
+
+static void warmUp() {
+  static char buffer[1 << 20];
+  int fd = open(LOG_PATH, O_RDONLY);
+
+  while (read(fd, buffer, sizeof(buffer)) > 0) {}
+
+  close(fd);
+}
+
+static long maxResidentKilobytes() {
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_maxrss;
+}
+
+static void measure(
+  const char *name,
+  const char *setup,
+  const char *body,
+  long size,
+  long lines
+) {
+  char source[1024];
+  VM vm;
+
+  snprintf(
+    source,
+    sizeof(source),
+    "%s"
+    "var f = lines(\"" LOG_PATH "\");\n"
+    "var count = 0;\n"
+    "var line = nextLine(f);\n"
+    "while (line != nil) {\n"
+    "%s"
+    "  count = count + 1;\n"
+    "  line = nextLine(f);\n"
+    "}\n"
+    "if (count != %ld) print \"wrong count\";\n",
+    setup,
+    body,
+    lines
+  );
+
+  initVM(&vm);
+
+  double begin = now();
+
+  if (interpret(&vm, source) != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(1);
+  }
+
+  double seconds = now() - begin;
+  size_t heap = vm.heap.peak;
+
+  freeVM(&vm);
+
+  printf(
+    "  %-8s %6.2f GB/s  %6.1f ns per line  heap peak %8zu bytes  max rss so far %6ld MB\n",
+    name,
+    size / seconds / 1e9,
+    seconds / lines * 1e9,
+    heap,
+    maxResidentKilobytes() / 1024
+  );
+}
+
+int main(
+  int argc,
+  const char *argv[]
+) {
+  long megabytes = argc > 1 ? atol(argv[1]) : 1024;
+  long lines = writeLog(megabytes);
+  struct stat info;
+
+  stat(LOG_PATH, &info);
+
+  printf("%ld MB, %ld lines\n", (long)(info.st_size / (1024 * 1024)), lines);
+
+  warmUp();
+
+  measure("count", "", "", info.st_size, lines);
+  measure("filter", "", "  if (line == \"never\") print line;\n", info.st_size, lines);
+  measure(
+    "keep",
+    "var last; var skip = 0;\n",
+    "  skip = skip + 1;\n"
+    "  if (skip == 1000) { last = line; skip = 0; }\n",
+    info.st_size,
+    lines
+  );
+
+  baseline(lines);
+
+  unlink(LOG_PATH);
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+// numeric lists: the vectorized natives against the same work as a loop in the script, and against plain c
+// the list is a million numbers from the logistic map (x = 3.99 * x * (1 - x)), filled in by the script, so it's chaotic enough that sorting it is real work
+// - sum, dot, map: the native once per round, against a `while` loop that indexes the list element by element
+// - sort: the radix sort on a fresh copy each round (made by `map(xs, "+", 0)`, which is timed separately), against qsort in c
+// - the c scalar sum is one addition after the other, the way the script's loop adds (the native's several accumulators can round differently)
+// nothing is collected, so every list a round makes stays on the heap until the end, which is most of the heap peak
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/list_bench.c $(ls c_lox/*.c | grep -v main.c) -o list_bench.out -lpthread -lm
+//   ./list_bench.out [elements]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "vm.h"
+
+#define ROUNDS 20
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void run(
+  VM *vm,
+  const char *source
+) {
+  if (interpret(vm, source) != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(1);
+  }
+}
+
+// seconds per round
+static double measure(
+  VM *vm,
+  const char *name,
+  const char *body,
+  int rounds,
+  long elements
+) {
+  char source[1024];
+
+  snprintf(
+    source,
+    sizeof(source),
+    "for (var round = 0; round < %d; round = round + 1) {\n"
+    "%s"
+    "}\n",
+    rounds,
+    body
+  );
+
+  double begin = now();
+
+  run(vm, source);
+
+  double seconds = (now() - begin) / rounds;
+
+  printf("  %-20s %10.3f ms  %7.2f ns per element\n", name, seconds * 1e3, seconds / elements * 1e9);
+
+  return seconds;
+}
+
+static int compareNumbers(
+  const void *a,
+  const void *b
+) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void baselines(long elements) {
+  double *x = malloc(sizeof(double) * elements);
+  double *copy = malloc(sizeof(double) * elements);
+
+  if (
+    x == NULL ||
+    copy == NULL
+  ) {
+    exit(1);
+  }
+
+  double value = 0.3;
+
+  for (long i = 0; i < elements; i++) {
+    value = 3.99 * value * (1 - value);
+    x[i] = value;
+  }
+
+  // volatile, so the sums aren't thrown away
+  volatile double sink = 0;
+  double begin = now();
+
+  for (int round = 0; round < ROUNDS; round++) {
+    double total = 0;
+
+    for (long i = 0; i < elements; i++) {
+      total += x[i];
+    }
+
+    sink = total;
+  }
+
+  double seconds = (now() - begin) / ROUNDS;
+
+  printf("  %-20s %10.3f ms  %7.2f ns per element\n", "c scalar sum", seconds * 1e3, seconds / elements * 1e9);
+
+  seconds = 0;
+
+  for (int round = 0; round < ROUNDS; round++) {
+    for (long i = 0; i < elements; i++) {
+      copy[i] = x[i];
+    }
+
+    begin = now();
+
+    qsort(copy, elements, sizeof(double), compareNumbers);
+
+    seconds += now() - begin;
+  }
+
+  seconds /= ROUNDS;
+
+  printf("  %-20s %10.3f ms  %7.2f ns per element\n", "c qsort", seconds * 1e3, seconds / elements * 1e9);
+
+  (void)sink;
+
+  free(x);
+  free(copy);
+}
+
+int main(
+  int argc,
+  const char *argv[]
+) {
+  long elements = argc > 1 ? atol(argv[1]) : 1000000;
+  char source[512];
+  VM vm;
+
+  initVM(&vm);
+
+  snprintf(
+    source,
+    sizeof(source),
+    "var n = %ld;\n"
+    "var xs = [];\n"
+    "var x = 0.3;\n"
+    "for (var i = 0; i < n; i = i + 1) {\n"
+    "  x = 3.99 * x * (1 - x);\n"
+    "  append(xs, x);\n"
+    "}\n"
+    "var total = 0;\n"
+    "var copy;\n",
+    elements
+  );
+
+  double begin = now();
+
+  run(&vm, source);
+
+  printf("%ld elements, filled in %.1f ms\n", elements, (now() - begin) * 1e3);
+
+  printf("natives\n");
+
+  double nativeSum = measure(&vm, "sum", "  total = sum(xs);\n", ROUNDS, elements);
+  double nativeDot = measure(&vm, "dot", "  total = dot(xs, xs);\n", ROUNDS, elements);
+  double nativeMap = measure(&vm, "map *", "  copy = map(xs, \"*\", 2);\n", ROUNDS, elements);
+  double copyOnly = measure(&vm, "copy (map + 0)", "  copy = map(xs, \"+\", 0);\n", ROUNDS, elements);
+  double nativeSort = measure(&vm, "copy and sort", "  copy = sort(map(xs, \"+\", 0));\n", ROUNDS, elements) - copyOnly;
+
+  printf("  %-20s %10.3f ms  %7.2f ns per element\n", "sort alone", nativeSort * 1e3, nativeSort / elements * 1e9);
+
+  run(
+    &vm,
+    "for (var i = 1; i < n; i = i + 1) if (copy[i - 1] > copy[i]) print \"not sorted\";\n"
+  );
+
+  printf("script loops\n");
+
+  // a few rounds are plenty, each one is a million trips through the interpreter
+  double loopSum = measure(
+    &vm,
+    "sum",
+    "  total = 0;\n"
+    "  var i = 0;\n"
+    "  while (i < n) { total = total + xs[i]; i = i + 1; }\n",
+    3,
+    elements
+  );
+  double loopDot = measure(
+    &vm,
+    "dot",
+    "  total = 0;\n"
+    "  var i = 0;\n"
+    "  while (i < n) { total = total + xs[i] * xs[i]; i = i + 1; }\n",
+    3,
+    elements
+  );
+  double loopMap = measure(
+    &vm,
+    "map *",
+    "  copy = [];\n"
+    "  var i = 0;\n"
+    "  while (i < n) { append(copy, xs[i] * 2); i = i + 1; }\n",
+    3,
+    elements
+  );
+
+  printf("c\n");
+
+  baselines(elements);
+
+  printf(
+    "natives are %.0fx (sum), %.0fx (dot), %.0fx (map) faster than the loops\n",
+    loopSum / nativeSum,
+    loopDot / nativeDot,
+    loopMap / nativeMap
+  );
+
+  printf("heap peak %zu bytes\n", vm.heap.peak);
+
+  freeVM(&vm);
+
+  return 0;
+}
\ No newline at end of file
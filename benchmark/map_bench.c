@@ -0,0 +1,161 @@
+// maps: a bulk load with and without `reserve`, and lookups by number and by string key
+// - in c: tableSetValue on a fresh table, growing as it goes (every resize allocates a new array and moves the old one over), against tableReserve first
+// - in a script: the same with `reserve(m, n)` before the loop, then a pass of `m[key]` lookups
+// string keys ("k0", "k1", ...) are runtime strings, like the ones a script builds, so they're interned by the first load that puts them into a map, which makes that load's average slower than the next one's
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/map_bench.c $(ls c_lox/*.c | grep -v main.c) -o map_bench.out -lpthread -lm
+//   ./map_bench.out [entries]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "list.h"
+#include "memory.h"
+#include "table.h"
+#include "vm.h"
+
+#define ROUNDS 10
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void loadInC(
+  VM *vm,
+  long entries,
+  bool reserve
+) {
+  double seconds = 0;
+  size_t peak = 0;
+
+  for (int round = 0; round < ROUNDS; round++) {
+    Table table;
+
+    initTable(&table, &vm->heap);
+
+    size_t before = vm->heap.current;
+    double begin = now();
+
+    if (reserve) tableReserve(&table, (int)entries);
+
+    for (long i = 0; i < entries; i++) {
+      tableSetValue(&table, NUMBER_VAL(i), NUMBER_VAL(i));
+    }
+
+    seconds += now() - begin;
+
+    if (vm->heap.current - before > peak) peak = vm->heap.current - before;
+
+    freeTable(&table);
+  }
+
+  seconds /= ROUNDS;
+
+  printf(
+    "  %-28s %8.2f ms  %6.1f ns per entry  final table %6zu KB\n",
+    reserve ? "tableReserve, then set" : "set, growing",
+    seconds * 1e3,
+    seconds / entries * 1e9,
+    peak / 1024
+  );
+}
+
+static void measure(
+  VM *vm,
+  const char *name,
+  const char *setup,
+  const char *body,
+  long entries
+) {
+  char source[1024];
+
+  snprintf(
+    source,
+    sizeof(source),
+    "for (var round = 0; round < %d; round = round + 1) {\n"
+    "%s"
+    "  for (var i = 0; i < n; i = i + 1) {\n"
+    "%s"
+    "  }\n"
+    "}\n",
+    ROUNDS,
+    setup,
+    body
+  );
+
+  double begin = now();
+
+  if (interpret(vm, source) != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(1);
+  }
+
+  double seconds = (now() - begin) / ROUNDS;
+
+  printf("  %-28s %8.2f ms  %6.1f ns per entry\n", name, seconds * 1e3, seconds / entries * 1e9);
+}
+
+int main(
+  int argc,
+  const char *argv[]
+) {
+  long entries = argc > 1 ? atol(argv[1]) : 1000000;
+  char source[256];
+  VM vm;
+
+  initVM(&vm);
+
+  printf("%ld entries\n", entries);
+
+  printf("c, number keys\n");
+
+  loadInC(&vm, entries, false);
+  loadInC(&vm, entries, true);
+
+  // a script can't turn a number into a string, so the keys are made here
+  ObjList *names = newList(&vm);
+
+  tableSet(&vm.globals, copyString(&vm, "names", 5), OBJ_VAL(names));
+
+  for (long i = 0; i < entries; i++) {
+    char name[24];
+    int length = snprintf(name, sizeof(name), "k%ld", i);
+    char *chars = ALLOCATE(&vm.heap, MEMORY_STRING_CHARS, char, length + 1);
+
+    memcpy(chars, name, length + 1);
+
+    listAppend(&vm, names, OBJ_VAL(takeString(&vm, chars, length)));
+  }
+
+  snprintf(
+    source,
+    sizeof(source),
+    "var n = %ld;\n"
+    "var m;\n"
+    "var x;\n",
+    entries
+  );
+
+  if (interpret(&vm, source) != INTERPRET_OK) exit(1);
+
+  printf("script, number keys\n");
+
+  measure(&vm, "load", "  m = {};\n", "    m[i] = i;\n", entries);
+  measure(&vm, "reserve, then load", "  m = reserve({}, n);\n", "    m[i] = i;\n", entries);
+  measure(&vm, "get", "", "    x = m[i];\n", entries);
+
+  printf("script, string keys\n");
+
+  measure(&vm, "load (first one interns)", "  m = {};\n", "    m[names[i]] = i;\n", entries);
+  measure(&vm, "reserve, then load", "  m = reserve({}, n);\n", "    m[names[i]] = i;\n", entries);
+  measure(&vm, "get", "", "    x = m[names[i]];\n", entries);
+
+  freeVM(&vm);
+
+  return 0;
+}
\ No newline at end of file
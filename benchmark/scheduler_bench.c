@@ -0,0 +1,110 @@
+// time slicing: many vms on a few threads, a handful of long running scripts queued in front of thousands of short ones (the tenant that hogs the thread and everyone else)
+// without slices (0) a short script waits for every long one queued before it, with slices it only waits for its turn
+// reports when the short scripts finish (since the start) and the overall throughput, for a range of slice lengths
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/scheduler_bench.c $(ls c_lox/*.c | grep -v main.c) -o scheduler_bench.out -lpthread -lm
+//   ./scheduler_bench.out [threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "scheduler.h"
+
+#define LONG_TASKS 8
+#define SHORT_TASKS 4000
+
+static const char *longSource = "var i = 0; while (i < 2000000) i = i + 1;";
+static const char *shortSource = "var i = 0; while (i < 200) i = i + 1;";
+
+static double start;
+static double *finished; // per task, seconds after `start`
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void done(
+  Task *task,
+  InterpretResult result
+) {
+  (void)result;
+
+  finished[(long)task->context] = now() - start;
+}
+
+static int compareDoubles(
+  const void *a,
+  const void *b
+) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void measure(
+  int threads,
+  long slice
+) {
+  int count = LONG_TASKS + SHORT_TASKS;
+  Task *tasks = calloc(count, sizeof(Task));
+  Scheduler scheduler;
+
+  if (tasks == NULL) exit(1);
+
+  initScheduler(&scheduler, slice, done);
+
+  start = now();
+
+  // the long ones first, the worst case for running each task to the end
+  for (long i = 0; i < count; i++) {
+    initTask(&tasks[i], i < LONG_TASKS ? longSource : shortSource, (void *)i);
+    scheduleTask(&scheduler, &tasks[i]);
+  }
+
+  runScheduler(&scheduler, threads);
+
+  double elapsed = now() - start;
+  double *shorts = finished + LONG_TASKS;
+
+  qsort(shorts, SHORT_TASKS, sizeof(double), compareDoubles);
+
+  printf(
+    "  slice %7ld  short ones done after  p50 %8.2f ms  p99 %8.2f ms  all %8.2f ms  total %7.3f s\n",
+    slice,
+    shorts[SHORT_TASKS / 2] * 1e3,
+    shorts[SHORT_TASKS * 99 / 100] * 1e3,
+    shorts[SHORT_TASKS - 1] * 1e3,
+    elapsed
+  );
+
+  freeScheduler(&scheduler);
+  free(tasks);
+}
+
+int main(
+  int argc,
+  const char *argv[]
+) {
+  int threads = argc > 1 ? atoi(argv[1]) : 2;
+
+  finished = malloc(sizeof(double) * (LONG_TASKS + SHORT_TASKS));
+
+  if (finished == NULL) exit(1);
+
+  printf("%d long and %d short scripts on %d threads\n", LONG_TASKS, SHORT_TASKS, threads);
+
+  long slices[] = {0, 1000000, 100000, 10000, 1000, 100};
+
+  for (int i = 0; i < (int)(sizeof(slices) / sizeof(slices[0])); i++) {
+    measure(threads, slices[i]);
+  }
+
+  free(finished);
+
+  return 0;
+}
\ No newline at end of file
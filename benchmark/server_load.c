@@ -0,0 +1,235 @@
+// load generator for `clox --serve`: a number of clients, each on its own connection, send the same small script over and over, and we report requests per second and latency percentiles
+// with --unique every request is a slightly different source, so the server has to compile each one (no help from its program cache)
+//
+// build from the repository root, then start a server and point the generator at it:
+//   cc -O2 -Ic_lox benchmark/server_load.c -o server_load.out -lpthread
+//   ./c_lox/main.out --serve /tmp/clox.sock &
+//   ./server_load.out /tmp/clox.sock [clients] [requests per client] [--unique]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "server.h"
+
+static const char *script =
+  "var total = 0;\n"
+  "for (var i = 0; i < 100; i = i + 1) total = total + i;\n"
+  "print \"total \" + \"is\";\n"
+  "print total;\n";
+
+typedef struct {
+  const char *path;
+  int requests;
+  bool unique;
+  int id;
+  pthread_t thread;
+
+  double *latencies; // seconds, one per request
+  int failures; // requests that didn't come back with exit code 0
+  bool broken; // the connection failed
+} Client;
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static bool readAll(
+  int fd,
+  void *buffer,
+  size_t length
+) {
+  char *bytes = buffer;
+
+  while (length > 0) {
+    ssize_t got = read(fd, bytes, length);
+
+    if (got <= 0) return false;
+
+    bytes += got;
+    length -= got;
+  }
+
+  return true;
+}
+
+static bool writeAll(
+  int fd,
+  const void *buffer,
+  size_t length
+) {
+  const char *bytes = buffer;
+
+  while (length > 0) {
+    ssize_t sent = write(fd, bytes, length);
+
+    if (sent <= 0) return false;
+
+    bytes += sent;
+    length -= sent;
+  }
+
+  return true;
+}
+
+static int connectTo(const char *path) {
+  struct sockaddr_un address;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (
+    fd < 0 ||
+    connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0
+  ) {
+    perror("connect");
+    exit(1);
+  }
+
+  return fd;
+}
+
+// one round trip, false if the connection broke
+static bool request(
+  int fd,
+  const char *source,
+  uint32_t length,
+  uint32_t *status
+) {
+  uint32_t header[3];
+  char discard[4096];
+
+  if (
+    !writeAll(fd, &length, sizeof(length)) ||
+    !writeAll(fd, source, length) ||
+    !readAll(fd, header, sizeof(header))
+  ) {
+    return false;
+  }
+
+  *status = header[0];
+
+  for (size_t left = (size_t)header[1] + header[2]; left > 0; ) {
+    size_t chunk = left < sizeof(discard) ? left : sizeof(discard);
+
+    if (!readAll(fd, discard, chunk)) return false;
+
+    left -= chunk;
+  }
+
+  return true;
+}
+
+static void *run(void *argument) {
+  Client *client = argument;
+  int fd = connectTo(client->path);
+  char source[1024];
+
+  for (int i = 0; i < client->requests; i++) {
+    int length = client->unique
+      ? snprintf(source, sizeof(source), "%s// client %d request %d\n", script, client->id, i)
+      : snprintf(source, sizeof(source), "%s", script);
+
+    uint32_t status;
+    double start = now();
+
+    if (!request(fd, source, (uint32_t)length, &status)) {
+      client->broken = true;
+      break;
+    }
+
+    client->latencies[i] = now() - start;
+
+    if (status != 0) client->failures++;
+  }
+
+  close(fd);
+
+  return NULL;
+}
+
+static int compareDoubles(
+  const void *a,
+  const void *b
+) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+int main(
+  int argc,
+  const char *argv[]
+) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: server_load socket [clients] [requests per client] [--unique]\n");
+    return 64;
+  }
+
+  int clientCount = argc > 2 ? atoi(argv[2]) : 4;
+  int requests = argc > 3 ? atoi(argv[3]) : 20000;
+  bool unique = argc > 4 && strcmp(argv[4], "--unique") == 0;
+
+  Client *clients = calloc(clientCount, sizeof(Client));
+  double *latencies = malloc(sizeof(double) * clientCount * requests);
+
+  double start = now();
+
+  for (int i = 0; i < clientCount; i++) {
+    clients[i].path = argv[1];
+    clients[i].requests = requests;
+    clients[i].unique = unique;
+    clients[i].id = i;
+    clients[i].latencies = latencies + (size_t)i * requests;
+
+    pthread_create(&clients[i].thread, NULL, run, &clients[i]);
+  }
+
+  int failures = 0;
+
+  for (int i = 0; i < clientCount; i++) {
+    pthread_join(clients[i].thread, NULL);
+
+    failures += clients[i].failures;
+
+    if (clients[i].broken) {
+      fprintf(stderr, "client %d lost its connection\n", i);
+      return 1;
+    }
+  }
+
+  double elapsed = now() - start;
+  int total = clientCount * requests;
+
+  qsort(latencies, total, sizeof(double), compareDoubles);
+
+  printf(
+    "%d clients x %d requests (%s sources): %.0f requests/s, %d failed\n"
+    "latency  p50 %7.1f us  p90 %7.1f us  p99 %7.1f us  p99.9 %7.1f us  max %7.1f us\n",
+    clientCount,
+    requests,
+    unique ? "unique" : "repeated",
+    total / elapsed,
+    failures,
+    latencies[(int)(total * 0.50)] * 1e6,
+    latencies[(int)(total * 0.90)] * 1e6,
+    latencies[(int)(total * 0.99)] * 1e6,
+    latencies[(int)(total * 0.999)] * 1e6,
+    latencies[total - 1] * 1e6
+  );
+
+  free(latencies);
+  free(clients);
+
+  return 0;
+}
\ No newline at end of file
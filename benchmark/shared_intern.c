@@ -0,0 +1,154 @@
+// interning from many threads at once: every thread runs vm after vm, and each vm interns the same set of identifiers (as every script of a batch would) plus a few names of its own
+// compares vms with a private `vm.strings` only against vms attached to one `SharedStrings` table, for throughput and for the string memory each vm ends up holding
+//
+// build and run from the repository root:
+//   cc -O2 -Ic_lox benchmark/shared_intern.c $(ls c_lox/*.c | grep -v main.c) -o shared_intern.out -lpthread -lm
+//   ./shared_intern.out
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "memory.h"
+#include "object.h"
+#include "shared.h"
+#include "vm.h"
+
+#define COMMON_NAMES 4000
+#define OWN_NAMES 200
+#define VMS_PER_THREAD 100
+
+static char commonNames[COMMON_NAMES][24];
+
+typedef struct {
+  SharedStrings *shared; // NULL for private vms
+  int id;
+  pthread_t thread;
+
+  VM vm;
+  size_t stringBytes; // held by the last vm when it was done, before it was freed
+  bool mismatch;
+} Thread;
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void *run(void *argument) {
+  Thread *thread = argument;
+  VM *vm = &thread->vm;
+  char name[32];
+
+  for (int round = 0; round < VMS_PER_THREAD; round++) {
+    initVM(vm);
+
+    if (thread->shared != NULL) attachSharedStrings(vm, thread->shared);
+
+    for (int i = 0; i < COMMON_NAMES; i++) {
+      copyString(vm, commonNames[i], (int)strlen(commonNames[i]));
+    }
+
+    // names only this vm uses, they go into the shared table too and get evicted by a later rebuild once the vm is gone
+    for (int i = 0; i < OWN_NAMES; i++) {
+      int length = snprintf(name, sizeof(name), "t%dr%dn%d", thread->id, round, i);
+      copyString(vm, name, length);
+    }
+
+    // a second lookup has to find the very same string
+    for (int i = 0; i < COMMON_NAMES; i += 97) {
+      ObjString *a = copyString(vm, commonNames[i], (int)strlen(commonNames[i]));
+      ObjString *b = copyString(vm, commonNames[i], (int)strlen(commonNames[i]));
+
+      if (a != b || strcmp(a->chars, commonNames[i]) != 0) thread->mismatch = true;
+    }
+
+    thread->stringBytes = vm->heap.bytes[MEMORY_OBJ_STRING] + vm->heap.bytes[MEMORY_STRING_CHARS];
+
+    freeVM(vm);
+  }
+
+  return NULL;
+}
+
+static void measure(
+  int threadCount,
+  bool share
+) {
+  SharedStrings shared;
+  Thread *threads = calloc(threadCount, sizeof(Thread));
+
+  if (share) initSharedStrings(&shared);
+
+  double start = now();
+
+  for (int i = 0; i < threadCount; i++) {
+    threads[i].shared = share ? &shared : NULL;
+    threads[i].id = i;
+
+    pthread_create(&threads[i].thread, NULL, run, &threads[i]);
+  }
+
+  bool mismatch = false;
+  size_t stringBytes = 0;
+
+  for (int i = 0; i < threadCount; i++) {
+    pthread_join(threads[i].thread, NULL);
+
+    mismatch |= threads[i].mismatch;
+    stringBytes += threads[i].stringBytes;
+  }
+
+  double elapsed = now() - start;
+  long interns = (long)threadCount * VMS_PER_THREAD * (COMMON_NAMES + OWN_NAMES);
+
+  printf(
+    "  %-7s %3d threads  %7.1f M interns/s  %7.1f KB of strings per vm%s",
+    share ? "shared" : "private",
+    threadCount,
+    interns / elapsed / 1e6,
+    stringBytes / 1024.0 / threadCount,
+    mismatch ? "  MISMATCH" : ""
+  );
+
+  if (share) {
+    // the common names plus whatever own names the last rebuild didn't get to evict
+    printf("  (%zu strings left in the shared table)", atomic_load(&shared.count));
+
+    freeSharedStrings(&shared);
+  }
+
+  printf("\n");
+
+  free(threads);
+}
+
+int main() {
+  static const char *parts[] = {"get", "set", "user", "name", "count", "index", "value", "list", "node", "total", "line", "item", "path", "file", "size", "key"};
+  int partCount = (int)(sizeof(parts) / sizeof(parts[0]));
+
+  for (int i = 0; i < COMMON_NAMES; i++) {
+    snprintf(
+      commonNames[i],
+      sizeof(commonNames[i]),
+      "%s%s%d",
+      parts[i % partCount],
+      parts[i / partCount % partCount],
+      i / (partCount * partCount)
+    );
+  }
+
+  printf("%d vms per thread, each interning %d common and %d own names\n", VMS_PER_THREAD, COMMON_NAMES, OWN_NAMES);
+
+  int counts[] = {1, 2, 4, 8, 16};
+
+  for (int i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++) {
+    measure(counts[i], false);
+    measure(counts[i], true);
+  }
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+// loading a big generated script: read into a buffer with every literal copied out of it, or mapped with the literals borrowed from the mapping (see source.h)
+// the script is a hundred globals, each set to a long string literal (a chunk holds at most 256 constants, so a big script is big by its literals)
+// each way runs in a child process of its own, so its peak rss is its own, and the file is in the page cache for both
+// reports the time from opening the file to the end of the run, and the peak rss
+// what the mapped way has resident is the file's own pages, clean page cache the kernel can drop at any time, and the other way's is anonymous memory on top of that
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/source_bench.c $(ls c_lox/*.c | grep -v main.c) -o source_bench.out -lpthread -lm
+//   ./source_bench.out [megabytes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "source.h"
+#include "vm.h"
+
+#define SCRIPT_PATH "/tmp/clox_source_bench.lox"
+#define GLOBALS 100
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void writeScript(long megabytes) {
+  FILE *file = fopen(SCRIPT_PATH, "w");
+
+  if (file == NULL) {
+    fprintf(stderr, "can't write %s\n", SCRIPT_PATH);
+    exit(1);
+  }
+
+  long literal = megabytes * 1024 * 1024 / GLOBALS;
+
+  for (int i = 0; i < GLOBALS; i++) {
+    // the index first, so no two are the same (and interned into one)
+    fprintf(file, "var literal%d = \"%d ", i, i);
+
+    for (long j = 0; j < literal; j++) {
+      fputc('a' + (i + j) % 26, file);
+    }
+
+    fprintf(file, "\";\n");
+  }
+
+  fprintf(file, "if (literal0 == literal1) print \"same\";\n");
+
+  fclose(file);
+}
+
+// the way main.c used to: the whole file into a malloc'd buffer, and copyString for every literal
+static void readAndCopy() {
+  FILE *file = fopen(SCRIPT_PATH, "rb");
+
+  fseek(file, 0L, SEEK_END);
+
+  size_t size = ftell(file);
+
+  rewind(file);
+
+  char *buffer = malloc(size + 1);
+
+  if (buffer == NULL) exit(1);
+
+  buffer[fread(buffer, 1, size, file)] = '\0';
+
+  fclose(file);
+
+  VM vm;
+
+  initVM(&vm);
+
+  if (interpret(&vm, buffer) != INTERPRET_OK) exit(1);
+
+  freeVM(&vm);
+  free(buffer);
+}
+
+static void mapAndBorrow() {
+  Source source;
+
+  if (!mapSource(&source, SCRIPT_PATH)) exit(1);
+
+  VM vm;
+
+  initVM(&vm);
+
+  vm.borrowSource = true;
+
+  if (interpret(&vm, source.chars) != INTERPRET_OK) exit(1);
+
+  freeVM(&vm);
+  unmapSource(&source);
+}
+
+static void measure(
+  const char *name,
+  void (*load)()
+) {
+  // or the child prints what's still buffered too
+  fflush(stdout);
+
+  double start = now();
+  pid_t child = fork();
+
+  if (child == 0) {
+    load();
+    exit(0);
+  }
+
+  int status;
+  struct rusage usage;
+
+  wait4(child, &status, 0, &usage);
+
+  double seconds = now() - start;
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s failed\n", name);
+    exit(1);
+  }
+
+  printf("  %-16s %8.1f ms  peak rss %6ld MB\n", name, seconds * 1e3, usage.ru_maxrss / 1024);
+}
+
+int main(
+  int argc,
+  const char *argv[]
+) {
+  long megabytes = argc > 1 ? atol(argv[1]) : 256;
+
+  writeScript(megabytes);
+
+  printf("%ld MB script, %d literals\n", megabytes, GLOBALS);
+
+  // once each to fill the page cache, then the measured runs
+  for (int round = 0; round < 3; round++) {
+    if (round > 0) printf("round %d\n", round);
+
+    measure("read and copy", readAndCopy);
+    measure("map and borrow", mapAndBorrow);
+  }
+
+  unlink(SCRIPT_PATH);
+
+  return 0;
+}
\ No newline at end of file
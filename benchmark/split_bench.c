@@ -0,0 +1,210 @@
+// tokenizing a big csv-like text: every field as a view into the text (see OBJ_VIEW), against copying every field out
+// - c, per field: viewString, takeString on a fresh copy (what a copying substring would do), and copyString (a copy that's hashed and interned as well, which is what slicing with the compiler's string constructor costs)
+// - script: `split` into lines, `split` every line into fields, and a sum over one of the fields' lengths, so the fields are really used
+// reports the time and the heap growth per field, fresh vms for each, so earlier rounds don't count
+//
+// build and run from the repository root:
+//   cc -O2 -D_GNU_SOURCE -Ic_lox benchmark/split_bench.c $(ls c_lox/*.c | grep -v main.c) -o split_bench.out -lpthread -lm
+//   ./split_bench.out [megabytes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "list.h"
+#include "memory.h"
+#include "object.h"
+#include "vm.h"
+
+#define FIELDS_PER_LINE 8
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// lines of eight fields, 2 to 12 bytes each, about a fifth of them repeating (like the ids and status codes of a log)
+static char *makeText(
+  long megabytes,
+  int *length,
+  long *fields
+) {
+  long size = megabytes * 1024 * 1024;
+  char *text = malloc(size + 64);
+
+  if (text == NULL) exit(1);
+
+  long at = 0;
+
+  *fields = 0;
+  srand(7);
+
+  while (at < size) {
+    for (int field = 0; field < FIELDS_PER_LINE; field++) {
+      int width = 2 + rand() % 11;
+      int value = rand() % 5 == 0 ? rand() % 100 : rand();
+
+      at += snprintf(text + at, 64, "%.*d%c", width, value, field == FIELDS_PER_LINE - 1 ? '\n' : ',');
+      (*fields)++;
+    }
+  }
+
+  // no newline at the very end, so splitting on it doesn't make an empty last line
+  *length = (int)at - 1;
+
+  return text;
+}
+
+typedef enum {
+  SLICE_VIEW,
+  SLICE_COPY,
+  SLICE_INTERN,
+} Slice;
+
+static void sliceInC(
+  const char *text,
+  int length,
+  long fields,
+  Slice slice,
+  const char *name
+) {
+  VM vm;
+
+  initVM(&vm);
+
+  char *chars = ALLOCATE(&vm.heap, MEMORY_STRING_CHARS, char, length + 1);
+
+  memcpy(chars, text, length);
+  chars[length] = '\0';
+
+  ObjString *parent = takeString(&vm, chars, length);
+  size_t before = vm.heap.current;
+  double begin = now();
+  long count = 0;
+  int start = 0;
+
+  for (int i = 0; i <= length; i++) {
+    if (
+      i < length &&
+      text[i] != ',' &&
+      text[i] != '\n'
+    ) {
+      continue;
+    }
+
+    ObjString *field;
+
+    switch (slice) {
+      case SLICE_VIEW: field = viewString(&vm, parent, start, i - start); break;
+
+      case SLICE_COPY: {
+        char *copy = ALLOCATE(&vm.heap, MEMORY_STRING_CHARS, char, i - start + 1);
+
+        memcpy(copy, text + start, i - start);
+        copy[i - start] = '\0';
+
+        field = takeString(&vm, copy, i - start);
+
+        break;
+      }
+
+      default: field = copyString(&vm, text + start, i - start); break;
+    }
+
+    count += field->length > 0;
+    start = i + 1;
+  }
+
+  double seconds = now() - begin;
+
+  if (count != fields) printf("%s found %ld fields instead of %ld\n", name, count, fields);
+
+  printf(
+    "  %-24s %8.1f ms  %6.1f ns per field  %6.1f heap bytes per field\n",
+    name,
+    seconds * 1e3,
+    seconds / fields * 1e9,
+    (double)(vm.heap.current - before) / fields
+  );
+
+  freeVM(&vm);
+}
+
+static void splitInScript(
+  const char *text,
+  int length,
+  long fields
+) {
+  VM vm;
+
+  initVM(&vm);
+
+  char *chars = ALLOCATE(&vm.heap, MEMORY_STRING_CHARS, char, length + 1);
+
+  memcpy(chars, text, length);
+  chars[length] = '\0';
+
+  tableSet(&vm.globals, copyString(&vm, "text", 4), OBJ_VAL(takeString(&vm, chars, length)));
+
+  size_t before = vm.heap.current;
+  double begin = now();
+  char source[512];
+
+  snprintf(
+    source,
+    sizeof(source),
+    // lox strings have no escapes, the newline goes into the literal as it is
+    "var lines = split(text, \"\n\");\n"
+    "var count = 0;\n"
+    "var total = 0;\n"
+    "for (var i = 0; i < length(lines); i = i + 1) {\n"
+    "  var fields = split(lines[i], \",\");\n"
+    "  count = count + length(fields);\n"
+    "  total = total + length(fields[3]);\n"
+    "}\n"
+    "if (count != %ld) print \"wrong count\";\n",
+    fields
+  );
+
+  if (interpret(&vm, source) != INTERPRET_OK) exit(1);
+
+  double seconds = now() - begin;
+
+  printf(
+    "  %-24s %8.1f ms  %6.1f ns per field  %6.1f heap bytes per field (lists included)\n",
+    "split, split",
+    seconds * 1e3,
+    seconds / fields * 1e9,
+    (double)(vm.heap.current - before) / fields
+  );
+
+  freeVM(&vm);
+}
+
+int main(
+  int argc,
+  const char *argv[]
+) {
+  long megabytes = argc > 1 ? atol(argv[1]) : 64;
+  int length;
+  long fields;
+  char *text = makeText(megabytes, &length, &fields);
+
+  printf("%ld MB, %ld fields\n", megabytes, fields);
+
+  printf("c\n");
+
+  sliceInC(text, length, fields, SLICE_VIEW, "view");
+  sliceInC(text, length, fields, SLICE_COPY, "copy");
+  sliceInC(text, length, fields, SLICE_INTERN, "copy and intern");
+
+  printf("script\n");
+
+  splitInScript(text, length, fields);
+
+  free(text);
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,353 @@
+// compares the swiss table in c_lox/table.c against the linear probing table it replaced
+//
+// build and run from the repository root:
+//   cc -O2 -Ic_lox benchmark/table_bench.c $(ls c_lox/*.c | grep -v main.c) -o table_bench.out -lpthread -lm
+//   ./table_bench.out
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "memory.h"
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+static VM vm;
+
+// the old table, verbatim apart from the names
+
+typedef struct {
+  ObjString *key;
+  Value value;
+} LinearEntry;
+
+typedef struct {
+  int count;
+  int capacity;
+  LinearEntry *entries;
+} LinearTable;
+
+static void initLinearTable(LinearTable *table) {
+  table->count = 0;
+  table->capacity = 0;
+  table->entries = NULL;
+}
+
+static void freeLinearTable(LinearTable *table) {
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, LinearEntry, table->entries, table->capacity);
+  initLinearTable(table);
+}
+
+static LinearEntry *linearFindEntry(
+  LinearEntry *entries,
+  int capacity,
+  ObjString *key
+) {
+  uint32_t index = key->hash % capacity;
+  LinearEntry *tombstone = NULL;
+
+  for (;;) {
+    LinearEntry *entry = &entries[index];
+
+    if (entry->key == NULL) {
+      if (IS_NIL(entry->value)) {
+        return tombstone != NULL ? tombstone : entry;
+      } else {
+        if (tombstone == NULL) tombstone = entry;
+      }
+    } else if (entry->key == key) {
+      return entry;
+    }
+
+    index = (index + 1) % capacity;
+  }
+}
+
+static bool linearGet(
+  LinearTable *table,
+  ObjString *key,
+  Value *value
+) {
+  if (table->count == 0) return false;
+
+  LinearEntry *entry = linearFindEntry(table->entries, table->capacity, key);
+
+  if (entry->key == NULL) return false;
+
+  *value = entry->value;
+
+  return true;
+}
+
+static void linearAdjustCapacity(
+  LinearTable *table,
+  int capacity
+) {
+  LinearEntry *entries = ALLOCATE(&vm.heap, MEMORY_OTHER, LinearEntry, capacity);
+
+  for (int i = 0; i < capacity; i++) {
+    entries[i].key = NULL;
+    entries[i].value = NIL_VAL;
+  }
+
+  table->count = 0;
+
+  for (int i = 0; i < table->capacity; i++) {
+    LinearEntry *entry = &table->entries[i];
+
+    if (entry->key == NULL) continue;
+
+    LinearEntry *dest = linearFindEntry(entries, capacity, entry->key);
+
+    dest->key = entry->key;
+    dest->value = entry->value;
+
+    table->count++;
+  }
+
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, LinearEntry, table->entries, table->capacity);
+
+  table->entries = entries;
+  table->capacity = capacity;
+}
+
+static bool linearSet(
+  LinearTable *table,
+  ObjString *key,
+  Value value
+) {
+  if (table->count + 1 > table->capacity * 0.75) {
+    linearAdjustCapacity(table, GROW_CAPACITY(table->capacity));
+  }
+
+  LinearEntry *entry = linearFindEntry(table->entries, table->capacity, key);
+
+  bool isNewKey = entry->key == NULL;
+
+  if (isNewKey && IS_NIL(entry->value)) table->count++;
+
+  entry->key = key;
+  entry->value = value;
+
+  return isNewKey;
+}
+
+static bool linearDelete(
+  LinearTable *table,
+  ObjString *key
+) {
+  if (table->count == 0) return false;
+
+  LinearEntry *entry = linearFindEntry(table->entries, table->capacity, key);
+
+  if (entry->key == NULL) return false;
+
+  entry->key = NULL;
+  entry->value = BOOL_VAL(true);
+
+  return true;
+}
+
+static ObjString *linearFindString(
+  LinearTable *table,
+  const char *chars,
+  int length,
+  uint32_t hash
+) {
+  if (table->count == 0) return NULL;
+
+  uint32_t index = hash % table->capacity;
+
+  for (;;) {
+    LinearEntry *entry = &table->entries[index];
+
+    if (entry->key == NULL) {
+      if (IS_NIL(entry->value)) return NULL;
+    } else if (
+      entry->key->length == length &&
+      entry->key->hash == hash &&
+      memcmp(entry->key->chars, chars, length) == 0
+    ) {
+      return entry->key;
+    }
+
+    index = (index + 1) % table->capacity;
+  }
+}
+
+// harness
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void fail(const char *what) {
+  fprintf(stderr, "tables disagree on %s\n", what);
+  exit(1);
+}
+
+static ObjString **makeKeys(
+  const char *prefix,
+  int count
+) {
+  ObjString **keys = ALLOCATE(&vm.heap, MEMORY_OTHER, ObjString *, count);
+  char name[32];
+
+  for (int i = 0; i < count; i++) {
+    int length = snprintf(name, sizeof(name), "%s%d", prefix, i);
+    keys[i] = copyString(&vm, name, length);
+  }
+
+  return keys;
+}
+
+#define TIME(label, count, body) \
+  do { \
+    double start_ = now(); \
+    body; \
+    double elapsed_ = now() - start_; \
+    printf("  %-22s %8.2f ns/op\n", label, elapsed_ * 1e9 / (count)); \
+  } while (false)
+
+static void run(int count, int rounds) {
+  ObjString **keys = makeKeys("key", count);
+  ObjString **missing = makeKeys("missing", count);
+
+  Table swiss;
+  LinearTable linear;
+
+  initTable(&swiss, &vm.heap);
+  initLinearTable(&linear);
+
+  long ops = (long)count * rounds;
+  Value value;
+  int found = 0;
+
+  printf("%d keys\n", count);
+
+  printf(" linear probing\n");
+
+  TIME("insert", ops, {
+    for (int r = 0; r < rounds; r++) {
+      freeLinearTable(&linear);
+      for (int i = 0; i < count; i++) {
+        linearSet(&linear, keys[i], NUMBER_VAL(i));
+      }
+    }
+  });
+
+  TIME("get (hit)", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        found += linearGet(&linear, keys[i], &value);
+      }
+    }
+  });
+
+  TIME("get (miss)", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        found += linearGet(&linear, missing[i], &value);
+      }
+    }
+  });
+
+  TIME("find string", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        found += linearFindString(&linear, keys[i]->chars, keys[i]->length, keys[i]->hash) != NULL;
+      }
+    }
+  });
+
+  TIME("delete + reinsert", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        linearDelete(&linear, keys[i]);
+      }
+      for (int i = 0; i < count; i++) {
+        linearSet(&linear, keys[i], NUMBER_VAL(i));
+      }
+    }
+  });
+
+  int linearFound = found;
+  found = 0;
+
+  printf(" swiss table\n");
+
+  TIME("insert", ops, {
+    for (int r = 0; r < rounds; r++) {
+      freeTable(&swiss);
+      for (int i = 0; i < count; i++) {
+        tableSet(&swiss, keys[i], NUMBER_VAL(i));
+      }
+    }
+  });
+
+  TIME("get (hit)", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        found += tableGet(&swiss, keys[i], &value);
+      }
+    }
+  });
+
+  TIME("get (miss)", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        found += tableGet(&swiss, missing[i], &value);
+      }
+    }
+  });
+
+  TIME("find string", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        found += tableFindString(&swiss, keys[i]->chars, keys[i]->length, keys[i]->hash) != NULL;
+      }
+    }
+  });
+
+  TIME("delete + reinsert", ops, {
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        tableDelete(&swiss, keys[i]);
+      }
+      for (int i = 0; i < count; i++) {
+        tableSet(&swiss, keys[i], NUMBER_VAL(i));
+      }
+    }
+  });
+
+  if (found != linearFound) fail("lookups");
+
+  for (int i = 0; i < count; i++) {
+    Value expected;
+    if (!tableGet(&swiss, keys[i], &value)) fail("presence");
+    if (!linearGet(&linear, keys[i], &expected)) fail("presence");
+    if (!valuesEqual(value, expected)) fail("values");
+  }
+
+  freeTable(&swiss);
+  freeLinearTable(&linear);
+
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, ObjString *, keys, count);
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, ObjString *, missing, count);
+}
+
+int main() {
+  initVM(&vm);
+
+  run(64, 20000);
+  run(4096, 300);
+  run(262144, 4);
+
+  freeVM(&vm);
+
+  return 0;
+}
\ No newline at end of file
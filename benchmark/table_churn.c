@@ -0,0 +1,123 @@
+// delete/insert churn on c_lox/table.c: keeps the number of live keys fixed while constantly replacing them, and reports how probe lengths, tombstones and capacity hold up
+//
+// build and run from the repository root:
+//   cc -O2 -Ic_lox benchmark/table_churn.c $(ls c_lox/*.c | grep -v main.c) -o table_churn.out -lpthread -lm
+//   ./table_churn.out
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "memory.h"
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+static VM vm;
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// xorshift, so runs are reproducible
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+static void report(
+  const char *label,
+  Table *table,
+  double nsPerOp
+) {
+  TableStats stats;
+  tableStats(table, &stats);
+
+  printf(
+    "  %-12s capacity %8d  live %7d  tombstones %7d  probe avg %5.2f max %3d  %7.1f ns/op\n",
+    label,
+    table->capacity,
+    table->count,
+    table->tombstones,
+    stats.averageProbe,
+    stats.maxProbe,
+    nsPerOp
+  );
+}
+
+static void churn(
+  int live,
+  int rounds
+) {
+  // keys [0, live) start out in the table, the rest of the pool waits outside
+  int poolSize = live * 4;
+  ObjString **pool = ALLOCATE(&vm.heap, MEMORY_OTHER, ObjString *, poolSize);
+  char name[32];
+
+  for (int i = 0; i < poolSize; i++) {
+    int length = snprintf(name, sizeof(name), "k%d", i);
+    pool[i] = copyString(&vm, name, length);
+  }
+
+  Table table;
+  initTable(&table, &vm.heap);
+
+  for (int i = 0; i < live; i++) {
+    tableSet(&table, pool[i], NUMBER_VAL(i));
+  }
+
+  printf("%d live keys\n", live);
+  report("filled", &table, 0);
+
+  for (int round = 1; round <= rounds; round++) {
+    double start = now();
+
+    // one round replaces every key once on average
+    for (int i = 0; i < live; i++) {
+      int out = nextRandom() % live;
+      int in = live + nextRandom() % (poolSize - live);
+
+      tableDelete(&table, pool[out]);
+      tableSet(&table, pool[in], NUMBER_VAL(in));
+
+      ObjString *swap = pool[out];
+      pool[out] = pool[in];
+      pool[in] = swap;
+    }
+
+    double elapsed = now() - start;
+
+    char label[16];
+    snprintf(label, sizeof(label), "round %d", round);
+    report(label, &table, elapsed * 1e9 / (2.0 * live));
+  }
+
+  for (int i = 0; i < live; i++) {
+    Value value;
+
+    if (!tableGet(&table, pool[i], &value)) {
+      fprintf(stderr, "lost key %s\n", pool[i]->chars);
+      exit(1);
+    }
+  }
+
+  freeTable(&table);
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, ObjString *, pool, poolSize);
+}
+
+int main() {
+  initVM(&vm);
+
+  churn(1000, 8);
+  churn(100000, 8);
+
+  freeVM(&vm);
+
+  return 0;
+}
\ No newline at end of file
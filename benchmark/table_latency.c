@@ -0,0 +1,119 @@
+// per-operation latency percentiles for insert-heavy workloads on c_lox/table.c
+// resizes are spread over the following operations, so the tail should stay flat as the tables grow
+//
+// build and run from the repository root:
+//   cc -O2 -Ic_lox benchmark/table_latency.c $(ls c_lox/*.c | grep -v main.c) -o table_latency.out -lpthread -lm
+//   ./table_latency.out
+//
+// to compare against resizing in one go, build again with -DTABLE_MIGRATE_STEP=2147483647 (the whole old array gets moved by the first operation after the resize)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "memory.h"
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+static VM vm;
+
+static uint64_t nanoseconds() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000u + time.tv_nsec;
+}
+
+static int compareLatencies(
+  const void *a,
+  const void *b
+) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void report(
+  const char *label,
+  uint64_t *latencies,
+  int count
+) {
+  qsort(latencies, count, sizeof(uint64_t), compareLatencies);
+
+  uint64_t total = 0;
+  for (int i = 0; i < count; i++) {
+    total += latencies[i];
+  }
+
+  printf(
+    "%-28s mean %6.0f ns  p50 %6llu  p99 %6llu  p99.9 %7llu  p99.99 %8llu  max %9llu\n",
+    label,
+    (double)total / count,
+    (unsigned long long)latencies[count / 2],
+    (unsigned long long)latencies[(int)(count * 0.99)],
+    (unsigned long long)latencies[(int)(count * 0.999)],
+    (unsigned long long)latencies[(int)(count * 0.9999)],
+    (unsigned long long)latencies[count - 1]
+  );
+}
+
+// inserting fresh keys into a globals-style table
+static void tableInserts(int count) {
+  ObjString **keys = ALLOCATE(&vm.heap, MEMORY_OTHER, ObjString *, count);
+  uint64_t *latencies = ALLOCATE(&vm.heap, MEMORY_OTHER, uint64_t, count);
+  char name[32];
+
+  for (int i = 0; i < count; i++) {
+    int length = snprintf(name, sizeof(name), "global%d", i);
+    keys[i] = copyString(&vm, name, length);
+  }
+
+  Table table;
+  initTable(&table, &vm.heap);
+
+  for (int i = 0; i < count; i++) {
+    uint64_t start = nanoseconds();
+    tableSet(&table, keys[i], NUMBER_VAL(i));
+    latencies[i] = nanoseconds() - start;
+  }
+
+  snprintf(name, sizeof(name), "tableSet x%d", count);
+  report(name, latencies, count);
+
+  freeTable(&table);
+
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, ObjString *, keys, count);
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, uint64_t, latencies, count);
+}
+
+// interning fresh strings, which is what grows `vm.strings`
+static void internStrings(int count) {
+  uint64_t *latencies = ALLOCATE(&vm.heap, MEMORY_OTHER, uint64_t, count);
+  char name[32];
+
+  for (int i = 0; i < count; i++) {
+    int length = snprintf(name, sizeof(name), "string%d", i);
+
+    uint64_t start = nanoseconds();
+    copyString(&vm, name, length);
+    latencies[i] = nanoseconds() - start;
+  }
+
+  snprintf(name, sizeof(name), "copyString x%d", count);
+  report(name, latencies, count);
+
+  FREE_ARRAY(&vm.heap, MEMORY_OTHER, uint64_t, latencies, count);
+}
+
+int main() {
+  initVM(&vm);
+
+  tableInserts(100000);
+  tableInserts(2000000);
+  internStrings(2000000);
+
+  freeVM(&vm);
+
+  return 0;
+}
\ No newline at end of file
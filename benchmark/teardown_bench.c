@@ -0,0 +1,78 @@
+// how long `freeVM` takes with the default heap (scans the object pages and frees what each object owns) and in region mode (unmaps a handful of regions)
+//
+// build and run from the repository root:
+//   cc -O2 -Ic_lox benchmark/teardown_bench.c $(ls c_lox/*.c | grep -v main.c) -o teardown_bench.out -lpthread -lm
+//   ./teardown_bench.out
+
+#include <stdio.h>
+#include <time.h>
+
+#include "memory.h"
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+static VM vm;
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// a heap that looks like the end of a script run: lots of strings (short and long), a good part of them held by globals
+static void fillHeap(int count) {
+  char chars[128];
+
+  for (int i = 0; i < count; i++) {
+    int length = snprintf(
+      chars,
+      sizeof(chars),
+      i % 8 == 0 ? "a somewhat longer string that doesn't fit a small block, number %d" : "s%d",
+      i
+    );
+
+    ObjString *string = copyString(&vm, chars, length);
+
+    if (i % 4 == 0) tableSet(&vm.globals, string, OBJ_VAL(string));
+  }
+}
+
+static void teardown(
+  int count,
+  bool regions
+) {
+  initVM(&vm);
+
+  vm.heap.regions = regions;
+
+  double start = now();
+  fillHeap(count);
+  double filled = now();
+
+  size_t bytes = vm.heap.current;
+
+  freeVM(&vm);
+
+  double freed = now();
+
+  printf(
+    "  %-8s %8d objects  %6.1f MB  fill %8.2f ms  teardown %8.3f ms\n",
+    regions ? "regions" : "list",
+    count,
+    bytes / 1e6,
+    (filled - start) * 1e3,
+    (freed - filled) * 1e3
+  );
+}
+
+int main() {
+  int counts[] = {10000, 100000, 1000000, 4000000};
+
+  for (int i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++) {
+    teardown(counts[i], false);
+    teardown(counts[i], true);
+  }
+
+  return 0;
+}
\ No newline at end of file
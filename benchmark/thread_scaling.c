@@ -0,0 +1,92 @@
+// runs the same script on 1 to 64 threads, each with its own vm, and reports throughput and how well it scales
+// vms share no state, so up to the number of cores the throughput should grow linearly
+//
+// build and run from the repository root:
+//   cc -O2 -Ic_lox benchmark/thread_scaling.c $(ls c_lox/*.c | grep -v main.c) -o thread_scaling.out -lpthread -lm
+//   ./thread_scaling.out
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "vm.h"
+
+// a bit of everything: globals, locals, arithmetic, string concatenation and interning
+static const char *script =
+  "var total = 0;\n"
+  "var text = \"\";\n"
+  "for (var i = 0; i < 2000; i = i + 1) {\n"
+  "  var square = i * i;\n"
+  "  if (square > 1000) total = total + square; else total = total - i;\n"
+  "  if (i < 200) text = text + \"x\";\n"
+  "}\n"
+  "var name = \"tot\" + \"al\";\n";
+
+#define RUNS_PER_THREAD 200
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void *worker(void *argument) {
+  int *failures = (int *)argument;
+
+  for (int run = 0; run < RUNS_PER_THREAD; run++) {
+    VM vm;
+
+    initVM(&vm);
+
+    if (interpret(&vm, script) != INTERPRET_OK) (*failures)++;
+
+    freeVM(&vm);
+  }
+
+  return NULL;
+}
+
+int main() {
+  static const int threadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+  double baseline = 0;
+
+  printf("%d runs per thread\n", RUNS_PER_THREAD);
+
+  for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+    int threadCount = threadCounts[t];
+    pthread_t threads[64];
+    int failures[64] = {0};
+
+    double start = now();
+
+    for (int i = 0; i < threadCount; i++) {
+      pthread_create(&threads[i], NULL, worker, &failures[i]);
+    }
+    for (int i = 0; i < threadCount; i++) {
+      pthread_join(threads[i], NULL);
+    }
+
+    double elapsed = now() - start;
+    double runsPerSecond = threadCount * RUNS_PER_THREAD / elapsed;
+
+    int failed = 0;
+    for (int i = 0; i < threadCount; i++) {
+      failed += failures[i];
+    }
+
+    if (threadCount == 1) baseline = runsPerSecond;
+
+    printf(
+      "  %2d threads  %9.0f runs/s  speedup %5.2fx  efficiency %5.1f%%%s\n",
+      threadCount,
+      runsPerSecond,
+      runsPerSecond / baseline,
+      100.0 * runsPerSecond / baseline / threadCount,
+      failed > 0 ? "  (some runs failed)" : ""
+    );
+  }
+
+  return 0;
+}
\ No newline at end of file
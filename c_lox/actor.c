@@ -0,0 +1,725 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "actor.h"
+#include "list.h"
+#include "map.h"
+#include "object.h"
+
+// mailboxes
+
+static void initMailbox(Mailbox *mailbox) {
+  for (size_t i = 0; i < MAILBOX_CAPACITY; i++) {
+    atomic_init(&mailbox->slots[i].sequence, i);
+  }
+
+  atomic_init(&mailbox->tail, 0);
+  mailbox->head = 0;
+
+  atomic_init(&mailbox->waiting, false);
+  pthread_mutex_init(&mailbox->lock, NULL);
+  pthread_cond_init(&mailbox->arrived, NULL);
+}
+
+static void freeMailbox(Mailbox *mailbox) {
+  pthread_mutex_destroy(&mailbox->lock);
+  pthread_cond_destroy(&mailbox->arrived);
+}
+
+// a slot's sequence is its index while it's free to write for the current lap, and index + 1 once it's been written
+// a sender claims a slot by moving `tail` past it, so senders only ever race on `tail`, and the receiver only ever waits on the slot's sequence
+static bool enqueue(
+  Mailbox *mailbox,
+  Message message
+) {
+  size_t position = atomic_load_explicit(&mailbox->tail, memory_order_relaxed);
+
+  for (;;) {
+    MailboxSlot *slot = &mailbox->slots[position & (MAILBOX_CAPACITY - 1)];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+        &mailbox->tail,
+        &position,
+        position + 1,
+        memory_order_relaxed,
+        memory_order_relaxed
+      )) {
+        slot->message = message;
+        atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+
+        return true;
+      }
+    } else if (difference < 0) {
+      // the receiver hasn't read this slot from the last lap yet
+      return false;
+    } else {
+      // another sender got this slot first
+      position = atomic_load_explicit(&mailbox->tail, memory_order_relaxed);
+    }
+  }
+}
+
+// receiver only
+static bool dequeue(
+  Mailbox *mailbox,
+  Message *message
+) {
+  MailboxSlot *slot = &mailbox->slots[mailbox->head & (MAILBOX_CAPACITY - 1)];
+  size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+  if (sequence != mailbox->head + 1) return false;
+
+  *message = slot->message;
+
+  // free for the sender one lap ahead
+  atomic_store_explicit(&slot->sequence, mailbox->head + MAILBOX_CAPACITY, memory_order_release);
+  mailbox->head++;
+
+  return true;
+}
+
+// wakes the receiver if it's asleep, and counts it as running again
+// only whoever turns `waiting` off does so, the receiver can't be counted twice
+static void wake(Actor *actor) {
+  bool waiting = true;
+
+  if (!atomic_compare_exchange_strong(&actor->mailbox.waiting, &waiting, false)) return;
+
+  atomic_fetch_add(&actor->system->running, 1);
+
+  pthread_mutex_lock(&actor->mailbox.lock);
+  pthread_cond_signal(&actor->mailbox.arrived);
+  pthread_mutex_unlock(&actor->mailbox.lock);
+}
+
+// nothing is running anymore, so nothing can be sent anymore either: wake everyone waiting in `receive`, they get nil
+static void quiesce(ActorSystem *system) {
+  wake(system->root);
+
+  pthread_mutex_lock(&system->lock);
+
+  for (Actor *actor = system->actors; actor != NULL; actor = actor->next) {
+    wake(actor);
+  }
+
+  pthread_mutex_unlock(&system->lock);
+}
+
+// called when an actor stops running, by waiting or by finishing
+static void stopRunning(ActorSystem *system) {
+  if (atomic_fetch_sub(&system->running, 1) == 1) quiesce(system);
+}
+
+// messages
+
+// how deep lists and maps in a message may be nested, one that contains itself would be copied forever
+#define MESSAGE_MAX_DEPTH 64
+
+static MessageCopy *newMessageCopy(
+  bool map,
+  bool numeric,
+  int capacity
+) {
+  MessageCopy *copy = malloc(sizeof(MessageCopy));
+
+  if (copy == NULL) exit(1);
+
+  copy->map = map;
+  copy->numeric = numeric;
+  copy->count = 0;
+  copy->numbers = NULL;
+  copy->items = NULL;
+
+  if (capacity == 0) return copy;
+
+  if (numeric) {
+    copy->numbers = malloc(sizeof(double) * capacity);
+  } else {
+    copy->items = malloc(sizeof(Message) * capacity);
+  }
+
+  if (
+    copy->numbers == NULL &&
+    copy->items == NULL
+  ) {
+    exit(1);
+  }
+
+  return copy;
+}
+
+static void dropMessage(Message *message) {
+  if (IS_STRING(message->value)) releaseSharedString(AS_STRING(message->value));
+
+  MessageCopy *copy = message->copy;
+
+  if (copy == NULL) return;
+
+  if (!copy->numeric) {
+    for (int i = 0; i < copy->count; i++) {
+      dropMessage(&copy->items[i]);
+    }
+  }
+
+  free(copy->numbers);
+  free(copy->items);
+  free(copy);
+
+  message->copy = NULL;
+}
+
+static bool toMessage(VM *vm, Value value, Message *message, int depth);
+
+static bool copyList(
+  VM *vm,
+  ObjList *list,
+  Message *message,
+  int depth
+) {
+  MessageCopy *copy = newMessageCopy(false, list->numeric, list->count);
+
+  message->copy = copy;
+
+  if (list->numeric) {
+    if (list->count > 0) memcpy(copy->numbers, list->as.numbers, sizeof(double) * list->count);
+
+    copy->count = list->count;
+
+    return true;
+  }
+
+  for (int i = 0; i < list->count; i++) {
+    // counted before it's filled in, so a message that fails halfway still drops whatever it copied so far
+    copy->count++;
+
+    if (!toMessage(vm, list->as.values[i], &copy->items[i], depth + 1)) return false;
+  }
+
+  return true;
+}
+
+static bool copyMap(
+  VM *vm,
+  ObjMap *map,
+  Message *message,
+  int depth
+) {
+  MessageCopy *copy = newMessageCopy(true, false, map->table.count * 2);
+  int cursor = 0;
+  Entry *entry;
+
+  message->copy = copy;
+
+  while (tableNext(&map->table, &cursor, &entry)) {
+    copy->count += 2;
+
+    // a key is never a list or map, so it can't fail, but its value still may after it
+    toMessage(vm, entry->key, &copy->items[copy->count - 2], depth + 1);
+    copy->items[copy->count - 1] = (Message){NIL_VAL, NULL, NULL};
+
+    if (!toMessage(vm, entry->value, &copy->items[copy->count - 1], depth + 1)) return false;
+  }
+
+  return true;
+}
+
+// the message holds a reference of its own to a string, so the string stays in the shared table however long the message takes to be received
+// on an error whatever made it into the message so far still needs `dropMessage`
+static bool toMessage(
+  VM *vm,
+  Value value,
+  Message *message,
+  int depth
+) {
+  message->value = value;
+  message->actor = NULL;
+  message->copy = NULL;
+
+  if (IS_STRING(value)) {
+    ObjString *string = AS_STRING(value);
+
+    if (string->obj.flags & OBJ_SHARED) {
+      retainSharedString(string);
+    } else {
+      // a string made at runtime, the one copy there is: into the shared table
+      message->value = OBJ_VAL(sharedIntern(
+        vm,
+        string->chars,
+        string->length,
+        stringHash(string)
+      ));
+    }
+  } else if (IS_ACTOR(value)) {
+    message->value = NIL_VAL;
+    message->actor = AS_ACTOR(value);
+  } else if (
+    IS_LIST(value) ||
+    IS_MAP(value)
+  ) {
+    message->value = NIL_VAL;
+
+    if (depth == MESSAGE_MAX_DEPTH) {
+      runtimeError(vm, "Can't send lists or maps nested more than %d deep (or that contain themselves).", MESSAGE_MAX_DEPTH);
+      return false;
+    }
+
+    if (IS_MAP(value)) return copyMap(vm, AS_MAP(value), message, depth);
+
+    return copyList(vm, AS_LIST(value), message, depth);
+  } else if (
+    IS_COROUTINE(value) ||
+    IS_HANDLE(value) ||
+    IS_LINES(value)
+  ) {
+    // a coroutine's code and stack live in the sender's vm, and so does a handle's event loop and a mapped file
+    message->value = NIL_VAL;
+    runtimeError(vm, "Can't send coroutines, handles or files to another actor.");
+    return false;
+  }
+
+  return true;
+}
+
+static Value fromMessage(
+  VM *vm,
+  Message *message
+) {
+  if (message->actor != NULL) return OBJ_VAL(newActorHandle(vm, message->actor));
+
+  MessageCopy *copy = message->copy;
+
+  if (copy != NULL) {
+    Value value;
+
+    if (copy->map) {
+      ObjMap *map = newMap(vm);
+
+      tableReserve(&map->table, copy->count / 2);
+
+      for (int i = 0; i < copy->count; i += 2) {
+        Value key = fromMessage(vm, &copy->items[i]);
+
+        mapSet(vm, map, key, fromMessage(vm, &copy->items[i + 1]));
+      }
+
+      value = OBJ_VAL(map);
+    } else {
+      ObjList *list = newList(vm);
+
+      for (int i = 0; i < copy->count; i++) {
+        listAppend(vm, list, copy->numeric ? NUMBER_VAL(copy->numbers[i]) : fromMessage(vm, &copy->items[i]));
+      }
+
+      value = OBJ_VAL(list);
+    }
+
+    // the strings in it are the vm's now, only the copy itself goes
+    free(copy->numbers);
+    free(copy->items);
+    free(copy);
+
+    return value;
+  }
+
+  if (IS_STRING(message->value)) {
+    ObjString *string = AS_STRING(message->value);
+    ObjString *local = internSetFind(
+      &vm->strings,
+      string->chars,
+      string->length,
+      string->hash
+    );
+
+    if (local != NULL) {
+      // the vm has these contents already (maybe this very string), so it doesn't need another reference
+      releaseSharedString(string);
+      return OBJ_VAL(local);
+    }
+
+    // the vm takes the message's reference over, and gives it back when it detaches
+    internSetAdd(&vm->strings, string);
+  }
+
+  return message->value;
+}
+
+// actors
+
+static Actor *newActor(
+  ActorSystem *system,
+  Actor *parent
+) {
+  Actor *actor = malloc(sizeof(Actor));
+
+  if (actor == NULL) exit(1);
+
+  actor->system = system;
+  actor->parent = parent;
+  actor->next = NULL;
+
+  initMailbox(&actor->mailbox);
+  atomic_init(&actor->finished, false);
+
+  actor->vm = NULL;
+  actor->source = NULL;
+
+  return actor;
+}
+
+static void freeActor(Actor *actor) {
+  freeMailbox(&actor->mailbox);
+  free(actor);
+}
+
+// the vm's actor system, made the first time the main script needs one
+static ActorSystem *systemOf(VM *vm) {
+  if (vm->actor != NULL) return vm->actor->system;
+
+  ActorSystem *system = malloc(sizeof(ActorSystem));
+
+  if (system == NULL) exit(1);
+
+  system->actors = NULL;
+  pthread_mutex_init(&system->lock, NULL);
+
+  // the main script, which is running right now
+  atomic_init(&system->running, 1);
+
+  // strings can only cross between vms that share a table
+  if (vm->shared != NULL) {
+    system->strings = vm->shared;
+    system->ownsStrings = false;
+  } else {
+    system->strings = malloc(sizeof(SharedStrings));
+
+    if (system->strings == NULL) exit(1);
+
+    initSharedStrings(system->strings);
+    system->ownsStrings = true;
+
+    attachSharedStrings(vm, system->strings);
+  }
+
+  system->root = newActor(system, NULL);
+  vm->actor = system->root;
+
+  return system;
+}
+
+static void *runActor(void *argument) {
+  Actor *actor = argument;
+  VM *vm = actor->vm;
+
+  interpret(vm, actor->source);
+
+  atomic_store(&actor->finished, true);
+  stopRunning(actor->system);
+
+  freeVM(vm);
+  free(vm);
+
+  free(actor->source);
+  actor->vm = NULL;
+  actor->source = NULL;
+
+  return NULL;
+}
+
+static char *readSource(const char *path) {
+  FILE *file = fopen(path, "rb");
+
+  if (file == NULL) return NULL;
+
+  fseek(file, 0L, SEEK_END);
+
+  size_t fileSize = ftell(file);
+
+  rewind(file);
+
+  char *buffer = malloc(fileSize + 1);
+
+  if (buffer == NULL) exit(1);
+
+  size_t bytesRead = fread(
+    buffer,
+    sizeof(char),
+    fileSize,
+    file
+  );
+
+  buffer[bytesRead] = '\0';
+
+  fclose(file);
+
+  return buffer;
+}
+
+// natives
+
+bool spawnNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (!IS_STRING(args[0])) {
+    runtimeError(vm, "Argument to spawn must be a path.");
+    return false;
+  }
+
+  terminateValue(vm, args[0]);
+
+  char *source = readSource(AS_CSTRING(args[0]));
+
+  if (source == NULL) {
+    runtimeError(vm, "Could not open file '%s'.", AS_CSTRING(args[0]));
+    return false;
+  }
+
+  ActorSystem *system = systemOf(vm);
+  Actor *actor = newActor(system, vm->actor);
+
+  actor->source = source;
+  actor->vm = malloc(sizeof(VM));
+
+  if (actor->vm == NULL) exit(1);
+
+  // the new vm runs like its parent does, into the same streams
+  initVM(actor->vm);
+
+  actor->vm->heap.regions = vm->heap.regions;
+  actor->vm->heap.limit = vm->heap.limit;
+  actor->vm->out = vm->out;
+  actor->vm->err = vm->err;
+  actor->vm->actor = actor;
+
+  attachSharedStrings(actor->vm, system->strings);
+
+  // counted by the spawner, which is running, so `running` can't drop to 0 before the new actor even starts
+  atomic_fetch_add(&system->running, 1);
+
+  pthread_mutex_lock(&system->lock);
+
+  actor->next = system->actors;
+  system->actors = actor;
+
+  pthread_mutex_unlock(&system->lock);
+
+  if (pthread_create(&actor->thread, NULL, runActor, actor) != 0) exit(1);
+
+  args[-1] = OBJ_VAL(newActorHandle(vm, actor));
+
+  return true;
+}
+
+bool sendNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  if (!IS_ACTOR(args[0])) {
+    runtimeError(vm, "First argument to send must be an actor.");
+    return false;
+  }
+
+  Actor *actor = AS_ACTOR(args[0]);
+  Message message;
+
+  // a vm only has handles once it's part of a system, so `vm.shared` is the system's table
+  if (!toMessage(vm, args[1], &message, 0)) {
+    dropMessage(&message);
+    return false;
+  }
+
+  bool sent = false;
+
+  while (!atomic_load(&actor->finished)) {
+    if (enqueue(&actor->mailbox, message)) {
+      sent = true;
+      break;
+    }
+
+    // full, give the receiver a chance to catch up
+    sched_yield();
+  }
+
+  if (sent) {
+    // pairs with the fence in `receive`: either the receiver sees the message before it goes to sleep, or we see it asleep here
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load(&actor->mailbox.waiting)) wake(actor);
+  } else {
+    dropMessage(&message);
+  }
+
+  args[-1] = BOOL_VAL(sent);
+
+  return true;
+}
+
+// how often `receive` looks at an empty mailbox again before it goes to sleep
+#define RECEIVE_SPINS 64
+
+bool receiveNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 0, argCount)) return false;
+
+  ActorSystem *system = systemOf(vm);
+  Actor *actor = vm->actor;
+  Mailbox *mailbox = &actor->mailbox;
+  Message message;
+
+  for (int i = 0; i < RECEIVE_SPINS; i++) {
+    if (dequeue(mailbox, &message)) {
+      args[-1] = fromMessage(vm, &message);
+      return true;
+    }
+
+    sched_yield();
+  }
+
+  pthread_mutex_lock(&mailbox->lock);
+
+  atomic_store(&mailbox->waiting, true);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  MailboxSlot *next = &mailbox->slots[mailbox->head & (MAILBOX_CAPACITY - 1)];
+
+  if (atomic_load(&next->sequence) == mailbox->head + 1) {
+    // a message came in after all
+    bool waiting = true;
+
+    // a sender that saw `waiting` before we could take it back counted us as running again, we still are
+    if (!atomic_compare_exchange_strong(&mailbox->waiting, &waiting, false)) atomic_fetch_sub(&system->running, 1);
+  } else {
+    pthread_mutex_unlock(&mailbox->lock);
+
+    stopRunning(system);
+
+    pthread_mutex_lock(&mailbox->lock);
+
+    // whoever wakes us counts us as running again
+    while (atomic_load(&mailbox->waiting)) {
+      pthread_cond_wait(&mailbox->arrived, &mailbox->lock);
+    }
+  }
+
+  pthread_mutex_unlock(&mailbox->lock);
+
+  // woken up without a message means the system has gone quiet
+  args[-1] = dequeue(mailbox, &message) ? fromMessage(vm, &message) : NIL_VAL;
+
+  return true;
+}
+
+bool selfNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 0, argCount)) return false;
+
+  systemOf(vm);
+
+  args[-1] = OBJ_VAL(newActorHandle(vm, vm->actor));
+
+  return true;
+}
+
+bool parentNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 0, argCount)) return false;
+
+  systemOf(vm);
+
+  Actor *parent = vm->actor->parent;
+
+  args[-1] = parent == NULL ? NIL_VAL : OBJ_VAL(newActorHandle(vm, parent));
+
+  return true;
+}
+
+// shutting down
+
+void stopActors(VM *vm) {
+  ActorSystem *system = vm->actor->system;
+
+  // the others finish on their own
+  if (vm->actor != system->root) return;
+
+  atomic_store(&system->root->finished, true);
+  stopRunning(system);
+
+  // actors may still be spawning others, so go again until there are no new ones
+  Actor *joined = NULL;
+
+  for (;;) {
+    pthread_mutex_lock(&system->lock);
+
+    Actor *newest = system->actors;
+
+    pthread_mutex_unlock(&system->lock);
+
+    if (newest == joined) break;
+
+    // the list only ever grows at the front
+    for (Actor *actor = newest; actor != joined; actor = actor->next) {
+      pthread_join(actor->thread, NULL);
+    }
+
+    joined = newest;
+  }
+
+  // whatever nobody received still holds references
+  Message message;
+
+  while (dequeue(&system->root->mailbox, &message)) dropMessage(&message);
+
+  for (Actor *actor = system->actors; actor != NULL; actor = actor->next) {
+    while (dequeue(&actor->mailbox, &message)) dropMessage(&message);
+  }
+}
+
+void freeActors(VM *vm) {
+  ActorSystem *system = vm->actor->system;
+  bool root = vm->actor == system->root;
+
+  vm->actor = NULL;
+
+  // the root frees everything, and only once every other actor is done
+  if (!root) return;
+
+  Actor *actor = system->actors;
+
+  while (actor != NULL) {
+    Actor *next = actor->next;
+
+    freeActor(actor);
+
+    actor = next;
+  }
+
+  freeActor(system->root);
+
+  if (system->ownsStrings) {
+    freeSharedStrings(system->strings);
+    free(system->strings);
+  }
+
+  pthread_mutex_destroy(&system->lock);
+  free(system);
+}
\ No newline at end of file
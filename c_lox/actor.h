@@ -0,0 +1,104 @@
+#ifndef clox_actor_h
+#define clox_actor_h
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "shared.h"
+#include "vm.h"
+
+// actors: scripts that run in vms of their own, on threads of their own, and talk by sending each other messages
+//
+//   spawn(path)           runs the script at `path` in a new actor and returns a handle on it
+//   send(actor, message)  puts a message into the actor's mailbox, false if the actor has finished already
+//   receive()             the next message in this actor's mailbox, waits for one if it's empty
+//                         once every actor is either waiting or finished nothing can arrive anymore, and from then on it returns nil instead of waiting
+//   self(), parent()      handles on this actor and on the one that spawned it (nil for the main script)
+//
+// the vms share nothing but a `SharedStrings` table, which is what lets strings cross without being copied: a message carries a shared string, and the receiver only has to put it into its `vm.strings`
+// numbers, booleans and nil are copied as they are, and natives are static so they cross as they are too
+// lists and maps are mutable, so they're deep copied into the message, and the receiver makes a list or map of its own out of that (see `MessageCopy`)
+
+// how many messages fit into a mailbox, a sender waits while it's full (a power of two)
+#define MAILBOX_CAPACITY 1024
+
+typedef struct Actor Actor;
+
+typedef struct MessageCopy MessageCopy;
+
+typedef struct {
+  Value value; // with a reference to the string if it's a (shared) string
+  Actor *actor; // or an actor handle, which the receiver makes its own handle for
+  MessageCopy *copy; // or a list's elements or a map's entries
+} Message;
+
+// what a list or map held when it was sent, in memory of its own (neither vm's heap), so the sender can go on changing it
+// every element, key and value is a message of its own, strings in it hold references and lists and maps in it have copies of their own
+// a list or map that's in the message twice arrives as two, and one that contains itself can't be sent
+struct MessageCopy {
+  bool map; // keys and values in turns in `items`
+  bool numeric; // a list of numbers only, in `numbers` instead of `items`
+  int count;
+  double *numbers;
+  Message *items;
+};
+
+typedef struct {
+  atomic_size_t sequence; // the position it can be written (slot index) or read (index + 1) at, see `enqueue`
+  Message message;
+} MailboxSlot;
+
+// bounded lock-free queue, any number of senders and the one receiver (Vyukov's)
+// the mutex and condition variable are only for a receiver that has nothing to do and goes to sleep
+typedef struct {
+  MailboxSlot slots[MAILBOX_CAPACITY];
+  _Alignas(64) atomic_size_t tail; // where the next sender writes
+  _Alignas(64) size_t head; // where the receiver reads next, only the receiver touches it
+
+  atomic_bool waiting; // the receiver is asleep (or about to be)
+  pthread_mutex_t lock;
+  pthread_cond_t arrived;
+} Mailbox;
+
+typedef struct ActorSystem ActorSystem;
+
+struct Actor {
+  ActorSystem *system;
+  Actor *parent;
+  Actor *next; // in `system.actors`
+
+  Mailbox mailbox;
+  atomic_bool finished;
+
+  // NULL for the main script's actor, which runs in the host's vm and on the host's thread
+  VM *vm;
+  char *source;
+  pthread_t thread;
+};
+
+// everything the actors spawned from one main script share, made by the first actor native the main script calls
+struct ActorSystem {
+  Actor *root; // the main script's
+  Actor *actors; // every actor but the root, guarded by `lock`
+  pthread_mutex_t lock;
+
+  // actors that are neither finished nor waiting in `receive`, once that's 0 nothing can be sent anymore
+  atomic_int running;
+  atomic_bool quiet;
+
+  SharedStrings *strings;
+  bool ownsStrings; // the root vm wasn't attached to one already
+};
+
+bool spawnNative(VM *vm, int argCount, Value *args);
+bool sendNative(VM *vm, int argCount, Value *args);
+bool receiveNative(VM *vm, int argCount, Value *args);
+bool selfNative(VM *vm, int argCount, Value *args);
+bool parentNative(VM *vm, int argCount, Value *args);
+
+// both called by `freeVM`: the first waits for every actor the vm spawned (if it's the root), the second frees what's left once the vm has detached from the shared strings
+void stopActors(VM *vm);
+void freeActors(VM *vm);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "arena.h"
+#include "memory.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// keep every allocation aligned for any type
+#define ARENA_ALIGNMENT 16
+#define ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// blocks are chained through a header at their start
+struct ArenaBlock {
+  ArenaBlock *next;
+  size_t size;
+};
+
+#define BLOCK_HEADER_SIZE ALIGN(sizeof(ArenaBlock))
+
+void initArena(
+  Arena *arena,
+  Heap *heap,
+  MemoryCategory category
+) {
+  arena->heap = heap;
+  arena->category = category;
+  arena->blocks = NULL;
+  arena->next = NULL;
+  arena->end = NULL;
+}
+
+void freeArena(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+
+  while (block != NULL) {
+    ArenaBlock *next = block->next;
+
+    reallocate(arena->heap, arena->category, block, block->size, 0);
+
+    block = next;
+  }
+
+  initArena(arena, arena->heap, arena->category);
+}
+
+static void *arenaAllocate(
+  Arena *arena,
+  size_t size
+) {
+  size = ALIGN(size);
+
+  if (
+    arena->next == NULL ||
+    size > (size_t)(arena->end - arena->next)
+  ) {
+    // whatever is left in the current block is wasted, that's the price of never freeing anything individually
+    size_t blockSize = BLOCK_HEADER_SIZE + size;
+
+    if (blockSize < ARENA_BLOCK_SIZE) blockSize = ARENA_BLOCK_SIZE;
+
+    ArenaBlock *block = (ArenaBlock *)reallocate(arena->heap, arena->category, NULL, 0, blockSize);
+
+    block->next = arena->blocks;
+    block->size = blockSize;
+
+    arena->blocks = block;
+    arena->next = (char *)block + BLOCK_HEADER_SIZE;
+    arena->end = (char *)block + blockSize;
+  }
+
+  void *result = arena->next;
+
+  arena->next += size;
+
+  return result;
+}
+
+void *arenaReallocate(
+  Heap *heap,
+  Arena *arena,
+  MemoryCategory category,
+  void *pointer,
+  size_t oldSize,
+  size_t newSize
+) {
+  if (arena == NULL) return reallocate(heap, category, pointer, oldSize, newSize);
+
+  // the most recent allocation can grow or shrink in place
+  if (
+    pointer != NULL &&
+    (char *)pointer + ALIGN(oldSize) == arena->next
+  ) {
+    if (newSize == 0) {
+      arena->next = (char *)pointer;
+      return NULL;
+    }
+
+    if (ALIGN(newSize) <= (size_t)(arena->end - (char *)pointer)) {
+      arena->next = (char *)pointer + ALIGN(newSize);
+      return pointer;
+    }
+  }
+
+  // everything else is released along with the arena
+  if (newSize == 0) return NULL;
+
+  void *result = arenaAllocate(arena, newSize);
+
+  if (pointer != NULL) {
+    memcpy(
+      result,
+      pointer,
+      oldSize < newSize ? oldSize : newSize
+    );
+  }
+
+  return result;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef clox_arena_h
+#define clox_arena_h
+
+#include "common.h"
+#include "memory.h"
+
+typedef struct ArenaBlock ArenaBlock;
+
+// bump allocator for memory that all dies at the same time (e.g. everything the compiler needs while compiling)
+// allocating just moves a pointer, freeing single blocks does nothing, and the whole arena is released in one go
+typedef struct Arena {
+  Heap *heap; // where the blocks come from
+  MemoryCategory category; // what they count as
+  ArenaBlock *blocks; // most recent first
+  char *next; // free space left in the most recent block
+  char *end;
+} Arena;
+
+void initArena(Arena *arena, Heap *heap, MemoryCategory category);
+void freeArena(Arena *arena);
+
+// `reallocate` for memory that may live in an arena
+// without an arena (NULL) it's just `reallocate` on `heap` for `category`, in an arena everything counts as the arena's category
+void *arenaReallocate(Heap *heap, Arena *arena, MemoryCategory category, void *pointer, size_t oldSize, size_t newSize);
+
+// GROW_ARRAY and FREE_ARRAY for arrays that may live in an arena
+#define GROW_ARRAY_IN(heap, arena, category, type, pointer, oldCount, newCount) \
+  (type *)arenaReallocate( \
+    heap, \
+    arena, \
+    category, \
+    pointer, \
+    sizeof(type) * (oldCount), \
+    sizeof(type) * (newCount) \
+  )
+
+#define FREE_ARRAY_IN(heap, arena, category, type, pointer, oldCount) \
+  arenaReallocate(heap, arena, category, pointer, sizeof(type) * (oldCount), 0)
+
+#endif
\ No newline at end of file
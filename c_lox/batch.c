@@ -0,0 +1,675 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "scheduler.h"
+#include "vm.h"
+
+// how one script went
+typedef struct {
+  const char *path;
+  int status; // the exit code `clox <script>` would have had: 0, 65 (compile error), 70 (runtime error) or 74 (couldn't read it)
+  double seconds; // reading, compiling and running it
+
+  // everything it printed, captured with `open_memstream`
+  char *out;
+  size_t outLength;
+  char *err;
+  size_t errLength;
+} ScriptResult;
+
+typedef struct {
+  char **paths;
+  int count;
+  int capacity;
+} Scripts;
+
+typedef struct Worker Worker;
+
+typedef struct {
+  Scripts scripts;
+  ScriptResult *results; // one per script, each written by whichever worker ran it
+  Worker *workers;
+  int workerCount;
+  bool regions;
+  size_t heapLimit;
+  struct SharedStrings *shared;
+} Batch;
+
+// every worker owns a deque of scripts it still has to run
+// the scripts start out split into one contiguous range per worker, so a deque is just a range: the owner takes scripts off the front, and an idle worker steals the back half of someone else's range
+struct Worker {
+  Batch *batch;
+  int id;
+  pthread_t thread;
+
+  pthread_mutex_t lock; // guards `next` and `end`
+  int next;
+  int end; // exclusive
+
+  // reused for every script, but initialized and freed around each one so that nothing leaks from one script into the next
+  VM vm;
+};
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static char *copyPath(const char *path) {
+  char *copy = strdup(path);
+
+  if (copy == NULL) exit(1);
+
+  return copy;
+}
+
+// collecting scripts
+
+static void addScript(
+  Scripts *scripts,
+  char *path
+) {
+  if (scripts->count == scripts->capacity) {
+    scripts->capacity = scripts->capacity < 64 ? 64 : scripts->capacity * 2;
+    scripts->paths = realloc(scripts->paths, sizeof(char *) * scripts->capacity);
+
+    if (scripts->paths == NULL) exit(1);
+  }
+
+  scripts->paths[scripts->count++] = path;
+}
+
+static void freeScripts(Scripts *scripts) {
+  for (int i = 0; i < scripts->count; i++) {
+    free(scripts->paths[i]);
+  }
+  free(scripts->paths);
+}
+
+static bool isScript(const char *path) {
+  size_t length = strlen(path);
+
+  return length > 4 && strcmp(path + length - 4, ".lox") == 0;
+}
+
+static int comparePaths(
+  const void *a,
+  const void *b
+) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool addDirectory(
+  Scripts *scripts,
+  const char *path
+) {
+  DIR *directory = opendir(path);
+
+  if (directory == NULL) {
+    fprintf(stderr, "could not open directory \"%s\"\n", path);
+    return false;
+  }
+
+  // sorted, so that the report lists scripts in the same order every night
+  Scripts entries = {NULL, 0, 0};
+  struct dirent *entry;
+
+  while ((entry = readdir(directory)) != NULL) {
+    // skips `.`, `..` and hidden files
+    if (entry->d_name[0] == '.') continue;
+
+    size_t length = strlen(path) + 1 + strlen(entry->d_name) + 1;
+    char *child = malloc(length);
+
+    if (child == NULL) exit(1);
+
+    snprintf(child, length, "%s/%s", path, entry->d_name);
+    addScript(&entries, child);
+  }
+
+  closedir(directory);
+
+  qsort(entries.paths, entries.count, sizeof(char *), comparePaths);
+
+  bool ok = true;
+
+  for (int i = 0; i < entries.count; i++) {
+    struct stat info;
+
+    if (stat(entries.paths[i], &info) != 0) continue;
+
+    if (S_ISDIR(info.st_mode)) {
+      ok = addDirectory(scripts, entries.paths[i]) && ok;
+    } else if (isScript(entries.paths[i])) {
+      addScript(scripts, copyPath(entries.paths[i]));
+    }
+  }
+
+  freeScripts(&entries);
+
+  return ok;
+}
+
+// a path from a list file, which is relative to the directory the list is in
+static char *listedPath(
+  const char *list,
+  const char *path
+) {
+  const char *slash = strrchr(list, '/');
+
+  if (
+    path[0] == '/' ||
+    slash == NULL
+  ) {
+    return copyPath(path);
+  }
+
+  int directoryLength = (int)(slash - list);
+  size_t length = directoryLength + 1 + strlen(path) + 1;
+  char *joined = malloc(length);
+
+  if (joined == NULL) exit(1);
+
+  snprintf(joined, length, "%.*s/%s", directoryLength, list, path);
+
+  return joined;
+}
+
+// one path per line, blank lines are skipped
+static bool addList(
+  Scripts *scripts,
+  const char *path
+) {
+  FILE *file = fopen(path, "r");
+
+  if (file == NULL) {
+    fprintf(stderr, "could not open file \"%s\"\n", path);
+    return false;
+  }
+
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+
+  while ((length = getline(&line, &capacity, file)) != -1) {
+    while (
+      length > 0 &&
+      (line[length - 1] == '\n' || line[length - 1] == '\r')
+    ) {
+      line[--length] = '\0';
+    }
+
+    if (length > 0) addScript(scripts, listedPath(path, line));
+  }
+
+  free(line);
+  fclose(file);
+
+  return true;
+}
+
+static bool addArgument(
+  Scripts *scripts,
+  const char *path
+) {
+  struct stat info;
+
+  if (
+    stat(path, &info) == 0 &&
+    S_ISDIR(info.st_mode)
+  ) {
+    return addDirectory(scripts, path);
+  }
+
+  // a script that doesn't exist still gets into the report (as unreadable), it's most likely a typo
+  if (isScript(path)) {
+    addScript(scripts, copyPath(path));
+    return true;
+  }
+
+  return addList(scripts, path);
+}
+
+// running scripts
+
+// like `readFile` in main.c, but a script that can't be read is only a failed entry in the report, not a reason to stop
+static char *readScript(const char *path) {
+  FILE *file = fopen(path, "rb");
+
+  if (file == NULL) return NULL;
+
+  fseek(file, 0L, SEEK_END);
+
+  long fileSize = ftell(file);
+
+  rewind(file);
+
+  char *buffer = fileSize < 0 ? NULL : malloc(fileSize + 1);
+
+  if (buffer == NULL) {
+    fclose(file);
+    return NULL;
+  }
+
+  size_t bytesRead = fread(
+    buffer,
+    sizeof(char),
+    fileSize,
+    file
+  );
+
+  buffer[bytesRead] = '\0';
+
+  fclose(file);
+
+  return buffer;
+}
+
+static int exitStatus(InterpretResult result) {
+  return result == INTERPRET_COMPILE_ERROR ? 65 : result == INTERPRET_RUNTIME_ERROR ? 70 : 0;
+}
+
+static void runScript(
+  Worker *worker,
+  int index
+) {
+  ScriptResult *result = &worker->batch->results[index];
+  const char *path = result->path;
+  VM *vm = &worker->vm;
+
+  double start = now();
+
+  FILE *out = open_memstream(&result->out, &result->outLength);
+  FILE *err = open_memstream(&result->err, &result->errLength);
+
+  if (
+    out == NULL ||
+    err == NULL
+  ) {
+    exit(1);
+  }
+
+  char *source = readScript(path);
+
+  if (source == NULL) {
+    fprintf(err, "could not read file \"%s\"\n", path);
+    result->status = 74;
+  } else {
+    initVM(vm);
+
+    vm->heap.regions = worker->batch->regions;
+    vm->heap.limit = worker->batch->heapLimit;
+
+    if (worker->batch->shared != NULL) attachSharedStrings(vm, worker->batch->shared);
+    vm->out = out;
+    vm->err = err;
+
+    InterpretResult interpretResult = interpret(vm, source);
+
+    freeVM(vm);
+    free(source);
+
+    result->status = exitStatus(interpretResult);
+  }
+
+  fclose(out);
+  fclose(err);
+
+  result->seconds = now() - start;
+}
+
+// the front of the worker's own deque, or -1 once it's empty
+static int takeOwn(Worker *worker) {
+  int index = -1;
+
+  pthread_mutex_lock(&worker->lock);
+
+  if (worker->next < worker->end) index = worker->next++;
+
+  pthread_mutex_unlock(&worker->lock);
+
+  return index;
+}
+
+// move the back half of some other worker's deque into this one's (which is empty), trying the others round robin starting with the next one
+// false once every deque is empty
+// scripts that are in the middle of being moved by another thief can be missed, but then that thief runs them, so nothing is lost (a worker may just stop a little early at the very end)
+static bool steal(Worker *worker) {
+  Batch *batch = worker->batch;
+
+  for (int i = 1; i < batch->workerCount; i++) {
+    Worker *victim = &batch->workers[(worker->id + i) % batch->workerCount];
+
+    pthread_mutex_lock(&victim->lock);
+
+    int remaining = victim->end - victim->next;
+    int start = victim->end - (remaining + 1) / 2;
+    int end = victim->end;
+
+    if (remaining > 0) victim->end = start;
+
+    pthread_mutex_unlock(&victim->lock);
+
+    if (remaining == 0) continue;
+
+    pthread_mutex_lock(&worker->lock);
+
+    worker->next = start;
+    worker->end = end;
+
+    pthread_mutex_unlock(&worker->lock);
+
+    return true;
+  }
+
+  return false;
+}
+
+static void *work(void *argument) {
+  Worker *worker = argument;
+
+  for (;;) {
+    int index = takeOwn(worker);
+
+    if (index >= 0) {
+      runScript(worker, index);
+    } else if (!steal(worker)) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+// time sliced: every script is a task, and the workers are the scheduler's threads
+
+typedef struct {
+  Task task;
+  ScriptResult *result;
+  char *source;
+  FILE *out;
+  FILE *err;
+} BatchTask;
+
+static void finishTask(
+  Task *task,
+  InterpretResult interpretResult
+) {
+  BatchTask *batchTask = task->context;
+
+  fclose(batchTask->out);
+  fclose(batchTask->err);
+  free(batchTask->source);
+
+  batchTask->result->status = exitStatus(interpretResult);
+
+  // only its own slices, not the time it spent waiting for its turn
+  batchTask->result->seconds = task->seconds;
+}
+
+static void runSliced(
+  Batch *batch,
+  long slice
+) {
+  Scheduler scheduler;
+  BatchTask *tasks = calloc(batch->scripts.count, sizeof(BatchTask));
+
+  if (tasks == NULL) exit(1);
+
+  initScheduler(&scheduler, slice, finishTask);
+
+  for (int i = 0; i < batch->scripts.count; i++) {
+    BatchTask *batchTask = &tasks[i];
+    ScriptResult *result = &batch->results[i];
+
+    batchTask->result = result;
+    batchTask->out = open_memstream(&result->out, &result->outLength);
+    batchTask->err = open_memstream(&result->err, &result->errLength);
+
+    if (
+      batchTask->out == NULL ||
+      batchTask->err == NULL
+    ) {
+      exit(1);
+    }
+
+    batchTask->source = readScript(result->path);
+
+    if (batchTask->source == NULL) {
+      fprintf(batchTask->err, "could not read file \"%s\"\n", result->path);
+      result->status = 74;
+
+      fclose(batchTask->out);
+      fclose(batchTask->err);
+
+      continue;
+    }
+
+    initTask(&batchTask->task, batchTask->source, batchTask);
+
+    VM *vm = &batchTask->task.vm;
+
+    vm->heap.regions = batch->regions;
+    vm->heap.limit = batch->heapLimit;
+
+    if (batch->shared != NULL) attachSharedStrings(vm, batch->shared);
+    vm->out = batchTask->out;
+    vm->err = batchTask->err;
+
+    scheduleTask(&scheduler, &batchTask->task);
+  }
+
+  runScheduler(&scheduler, batch->workerCount);
+
+  freeScheduler(&scheduler);
+  free(tasks);
+}
+
+// the report
+
+static const char *statusName(int status) {
+  switch (status) {
+    case 0: return "ok";
+    case 65: return "compile error";
+    case 70: return "runtime error";
+    default: return "unreadable";
+  }
+}
+
+// every line of a script's output, prefixed with where it went
+static void printOutput(
+  const char *prefix,
+  const char *chars,
+  size_t length
+) {
+  size_t start = 0;
+
+  while (start < length) {
+    const char *newline = memchr(chars + start, '\n', length - start);
+    size_t end = newline == NULL ? length : (size_t)(newline - chars);
+
+    printf("  %s | %.*s\n", prefix, (int)(end - start), chars + start);
+
+    start = end + 1;
+  }
+}
+
+// slowest first
+static int compareSeconds(
+  const void *a,
+  const void *b
+) {
+  double x = (*(ScriptResult *const *)a)->seconds;
+  double y = (*(ScriptResult *const *)b)->seconds;
+
+  return (x < y) - (x > y);
+}
+
+#define SLOWEST_COUNT 10
+
+static int printReport(
+  Batch *batch,
+  double seconds
+) {
+  int counts[4] = {0, 0, 0, 0}; // ok, compile error, runtime error, unreadable
+  double scriptSeconds = 0;
+  int worst = 0;
+
+  for (int i = 0; i < batch->scripts.count; i++) {
+    ScriptResult *result = &batch->results[i];
+
+    printf(
+      "%-13s %10.3f ms  %s\n",
+      statusName(result->status),
+      result->seconds * 1e3,
+      result->path
+    );
+
+    printOutput("out", result->out, result->outLength);
+    printOutput("err", result->err, result->errLength);
+
+    counts[result->status == 0 ? 0 : result->status == 65 ? 1 : result->status == 70 ? 2 : 3]++;
+    scriptSeconds += result->seconds;
+
+    if (result->status > worst) worst = result->status;
+  }
+
+  printf(
+    "\n%d scripts on %d workers in %.3f s (%.3f s of script time, %.2fx)\n"
+    "%d ok, %d compile errors, %d runtime errors, %d unreadable\n",
+    batch->scripts.count,
+    batch->workerCount,
+    seconds,
+    scriptSeconds,
+    seconds > 0 ? scriptSeconds / seconds : 0,
+    counts[0],
+    counts[1],
+    counts[2],
+    counts[3]
+  );
+
+  ScriptResult **order = malloc(sizeof(ScriptResult *) * batch->scripts.count);
+
+  if (order == NULL) exit(1);
+
+  for (int i = 0; i < batch->scripts.count; i++) {
+    order[i] = &batch->results[i];
+  }
+
+  qsort(order, batch->scripts.count, sizeof(ScriptResult *), compareSeconds);
+
+  printf("slowest:\n");
+
+  for (int i = 0; i < batch->scripts.count && i < SLOWEST_COUNT; i++) {
+    printf(
+      "  %10.3f ms  %s\n",
+      order[i]->seconds * 1e3,
+      order[i]->path
+    );
+  }
+
+  free(order);
+
+  return worst;
+}
+
+int runBatch(
+  int count,
+  const char *arguments[],
+  int workers,
+  long slice,
+  bool regions,
+  size_t heapLimit,
+  SharedStrings *shared
+) {
+  Batch batch;
+
+  batch.scripts = (Scripts){NULL, 0, 0};
+  batch.regions = regions;
+  batch.heapLimit = heapLimit;
+  batch.shared = shared;
+
+  for (int i = 0; i < count; i++) {
+    if (!addArgument(&batch.scripts, arguments[i])) {
+      freeScripts(&batch.scripts);
+      return 74;
+    }
+  }
+
+  if (batch.scripts.count == 0) {
+    fprintf(stderr, "no scripts to run\n");
+    freeScripts(&batch.scripts);
+    return 0;
+  }
+
+  if (workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (workers > batch.scripts.count) workers = batch.scripts.count;
+  if (workers < 1) workers = 1;
+
+  batch.workerCount = workers;
+  batch.results = calloc(batch.scripts.count, sizeof(ScriptResult));
+  batch.workers = calloc(workers, sizeof(Worker));
+
+  if (
+    batch.results == NULL ||
+    batch.workers == NULL
+  ) {
+    exit(1);
+  }
+
+  for (int i = 0; i < batch.scripts.count; i++) {
+    batch.results[i].path = batch.scripts.paths[i];
+  }
+
+  double start = now();
+
+  if (slice > 0) {
+    runSliced(&batch, slice);
+  } else {
+    for (int i = 0; i < workers; i++) {
+      Worker *worker = &batch.workers[i];
+
+      worker->batch = &batch;
+      worker->id = i;
+      worker->next = (int)((long)batch.scripts.count * i / workers);
+      worker->end = (int)((long)batch.scripts.count * (i + 1) / workers);
+
+      pthread_mutex_init(&worker->lock, NULL);
+    }
+
+    // the deques have to be filled before anyone starts stealing
+    for (int i = 0; i < workers; i++) {
+      pthread_create(&batch.workers[i].thread, NULL, work, &batch.workers[i]);
+    }
+
+    for (int i = 0; i < workers; i++) {
+      pthread_join(batch.workers[i].thread, NULL);
+    }
+
+    // only once they're all done, the last ones may still be trying to steal from the others
+    for (int i = 0; i < workers; i++) {
+      pthread_mutex_destroy(&batch.workers[i].lock);
+    }
+  }
+
+  int worst = printReport(&batch, now() - start);
+
+  for (int i = 0; i < batch.scripts.count; i++) {
+    free(batch.results[i].out);
+    free(batch.results[i].err);
+  }
+
+  free(batch.results);
+  free(batch.workers);
+  freeScripts(&batch.scripts);
+
+  return worst;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef clox_batch_h
+#define clox_batch_h
+
+#include "common.h"
+#include "shared.h"
+
+// run many scripts in parallel and print a report of how each one went
+// every argument is a script (`.lox`), a directory (searched recursively for `.lox` files) or a file listing one script path per line
+// `workers` threads each run one script at a time in a vm of its own, 0 means one per core
+// with a `slice` the scripts take turns on the workers instead, `slice` bytes of bytecode at a time (see scheduler.h), so one that never ends can't hold up the rest
+// every script's vm gets `heapLimit` bytes of heap (see `Heap.limit`), 0 for no limit
+// with `shared` (may be NULL) the vms share one intern table (see shared.h)
+// returns the worst exit code any of the scripts would have had on its own (0 when they all ran fine)
+int runBatch(int count, const char *arguments[], int workers, long slice, bool regions, size_t heapLimit, SharedStrings *shared);
+
+#endif
\ No newline at end of file
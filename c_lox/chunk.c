@@ -1,26 +1,154 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "chunk.h"
 #include "memory.h"
 
-void initChunk(Chunk *chunk) {
+void initChunk(
+  Chunk *chunk,
+  Heap *heap
+) {
   chunk->count = 0;
   chunk->capacity = 0;
   chunk->code = NULL;
   chunk->lines = NULL;
+  chunk->heap = heap;
+  chunk->arena = NULL;
+  chunk->block = NULL;
+  chunk->blockSize = 0;
+  chunk->mapped = false;
+
+  initValueArray(&chunk->constants, heap);
+}
+
+// a chunk whose arrays grow in an arena, for the compiler's work in progress
+void initScratchChunk(
+  Chunk *chunk,
+  Heap *heap,
+  Arena *arena
+) {
+  initChunk(chunk, heap);
 
-  initValueArray(&chunk->constants);
+  chunk->arena = arena;
+  chunk->constants.arena = arena;
+}
+
+#define CACHE_LINE 64
+#define ALIGN_TO_CACHE_LINE(size) (((size) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1))
+
+// a chunk smaller than this many pages is packed into a block from the heap instead of a mapping of its own
+// a small script would otherwise pay a whole page and two syscalls for a few hundred bytes of code
+#define FREEZE_MIN_PAGES 4
+
+// copy a finished chunk into a single block with no room to spare
+// code goes first, then the constants on the next cache line, and the lines last since they're only needed for error messages
+// a big chunk's block is a mapping that starts on a page (and so cache line) boundary, and is made read-only
+// nothing writes to the block afterwards either way, so it's safe to share between vms that run the same chunk
+void freezeChunk(
+  Chunk *from,
+  Chunk *to
+) {
+  size_t codeSize = sizeof(uint8_t) * from->count;
+  size_t constantsSize = sizeof(Value) * from->constants.count;
+  size_t linesSize = sizeof(int) * from->count;
+
+  size_t constantsOffset = ALIGN_TO_CACHE_LINE(codeSize);
+  size_t linesOffset = constantsOffset + constantsSize;
+  size_t size = linesOffset + linesSize;
+
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+  initChunk(to, from->heap);
+
+  if (size < pageSize * FREEZE_MIN_PAGES) {
+    // never 0, so a frozen chunk always has a block
+    to->blockSize = size > 0 ? size : 1;
+    to->block = reallocate(to->heap, MEMORY_CHUNK, NULL, 0, to->blockSize);
+  } else {
+    // mprotect works on whole pages, so the block gets its own
+    to->blockSize = (size + pageSize - 1) & ~(pageSize - 1);
+    to->mapped = true;
+
+    to->block = mmap(
+      NULL,
+      to->blockSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0
+    );
+
+    if (to->block == MAP_FAILED) exit(1); // allocation failed
+
+    trackMemory(to->heap, MEMORY_CHUNK, 0, to->blockSize);
+  }
+
+  char *block = (char *)to->block;
+
+  to->code = (uint8_t *)block;
+  to->count = from->count;
+  to->capacity = from->count;
+
+  to->constants.values = (Value *)(block + constantsOffset);
+  to->constants.count = from->constants.count;
+  to->constants.capacity = from->constants.count;
+
+  to->lines = (int *)(block + linesOffset);
+
+  // memcpy from NULL is undefined even for 0 bytes
+  if (codeSize > 0) memcpy(to->code, from->code, codeSize);
+  if (constantsSize > 0) memcpy(to->constants.values, from->constants.values, constantsSize);
+  if (linesSize > 0) memcpy(to->lines, from->lines, linesSize);
+
+  if (
+    to->mapped &&
+    mprotect(
+      to->block,
+      to->blockSize,
+      PROT_READ
+    ) != 0
+  ) {
+    // the block works the same writable, the vm just loses the guarantee that nothing scribbles on it
+    perror("mprotect");
+  }
 }
 
 void freeChunk(Chunk *chunk) {
 
-  FREE_ARRAY(
+  if (chunk->block != NULL) {
+    // frozen, everything lives in the one block
+    if (chunk->mapped) {
+      munmap(
+        chunk->block,
+        chunk->blockSize
+      );
+
+      trackMemory(chunk->heap, MEMORY_CHUNK, chunk->blockSize, 0);
+    } else {
+      reallocate(chunk->heap, MEMORY_CHUNK, chunk->block, chunk->blockSize, 0);
+    }
+
+    initChunk(chunk, chunk->heap);
+
+    return;
+  }
+
+  FREE_ARRAY_IN(
+    chunk->heap,
+    chunk->arena,
+    MEMORY_CHUNK,
     uint8_t,
     chunk->code,
     chunk->capacity
   );
 
-  FREE_ARRAY(
+  FREE_ARRAY_IN(
+    chunk->heap,
+    chunk->arena,
+    MEMORY_CHUNK,
     int,
     chunk->lines,
     chunk->capacity
@@ -29,7 +157,7 @@ void freeChunk(Chunk *chunk) {
   freeValueArray(&chunk->constants);
 
   // zero out the fields and leave the chunk in a well-defined "empty" state
-  initChunk(chunk);
+  initChunk(chunk, chunk->heap);
 }
 
 void writeChunk(
@@ -44,14 +172,20 @@ void writeChunk(
 
     chunk->capacity = GROW_CAPACITY(oldCapacity);
 
-    chunk->code = GROW_ARRAY(
+    chunk->code = GROW_ARRAY_IN(
+      chunk->heap,
+      chunk->arena,
+      MEMORY_CHUNK,
       uint8_t,
       chunk->code,
       oldCapacity,
       chunk->capacity
     );
 
-    chunk->lines = GROW_ARRAY(
+    chunk->lines = GROW_ARRAY_IN(
+      chunk->heap,
+      chunk->arena,
+      MEMORY_CHUNK,
       int,
       chunk->lines,
       oldCapacity,
@@ -2,6 +2,7 @@
 #define clox_chunk_h
 
 #include "common.h"
+#include "arena.h"
 #include "value.h"
 
 typedef enum {
@@ -28,6 +29,13 @@ typedef enum {
   OP_JUMP,
   OP_JUMP_IF_FALSE,
   OP_LOOP,
+  OP_CALL,
+  OP_COROUTINE,
+  OP_FINISH,
+  OP_LIST,
+  OP_MAP,
+  OP_GET_INDEX,
+  OP_SET_INDEX,
   OP_RETURN,
 } OpCode;
 
@@ -47,9 +55,22 @@ typedef struct {
 
   // this chunk's constants table
   ValueArray constants;
+
+  Heap *heap;
+
+  // scratch memory the arrays grow in while compiling, NULL for the heap
+  Arena *arena;
+
+  // a finished chunk has its code, constants and lines packed into this one block (see `freezeChunk`)
+  // nothing writes to it anymore, and a big one is a read-only mapping of its own
+  void *block;
+  size_t blockSize;
+  bool mapped;
 } Chunk;
 
-void initChunk(Chunk *chunk);
+void initChunk(Chunk *chunk, Heap *heap);
+void initScratchChunk(Chunk *chunk, Heap *heap, Arena *arena);
+void freezeChunk(Chunk *from, Chunk *to);
 void freeChunk(Chunk *chunk);
 void writeChunk(Chunk *chunk, uint8_t byte, int line);
 int addConstant(Chunk *chunk, Value value);
@@ -8,6 +8,12 @@
 // #define DEBUG_PRINT_CODE
 // #define DEBUG_TRACE_EXECUTION
 
+// string hash function: word-at-a-time by default, define this to go back to byte-at-a-time fnv-1a
+// #define STRING_HASH_FNV1A
+
+// send every allocation straight to realloc/free instead of serving small ones from the size class pools in memory.c
+// #define SYSTEM_ALLOCATOR
+
 #define UINT8_COUNT (UINT8_MAX + 1)
 
 #endif
\ No newline at end of file
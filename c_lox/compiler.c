@@ -12,13 +12,6 @@
 
 #endif
 
-typedef struct {
-  Token current;
-  Token previous;
-  bool hadError;
-  bool panicMode;
-} Parser;
-
 // low to high
 typedef enum {
   PREC_NONE,
@@ -30,11 +23,13 @@ typedef enum {
   PREC_TERM, // + -
   PREC_FACTOR, // * /
   PREC_UNARY, // ! -
-  PREC_CALL, // . ()
+  PREC_CALL, // . () []
   PREC_PRIMARY
 } Precedence;
 
-typedef void (*ParseFn)(bool canAssign);
+typedef struct Parser Parser;
+
+typedef void (*ParseFn)(Parser *parser, bool canAssign);
 
 typedef struct {
   ParseFn prefix;
@@ -47,7 +42,10 @@ typedef struct {
   int depth;
 } Local;
 
-typedef struct {
+typedef struct Compiler {
+  // the compiler of the code around a coroutine body, NULL for the script itself
+  struct Compiler *enclosing;
+
   // all locals that are in scope (source order)
   Local locals[UINT8_COUNT];
 
@@ -60,202 +58,264 @@ typedef struct {
   // number variables with the level of nesting where they appear => track which block each local belongs to so that we know WHICH LOCALS TO DISCARD WHEN A BLOCK ENDS (exactly my problem)
 } Compiler;
 
-Parser parser;
+// everything one compilation needs, so different threads can compile at the same time
+struct Parser {
+  VM *vm; // strings (identifiers and literals) get interned here
+  Scanner scanner;
+
+  // the current compiler instance
+  Compiler *compiler;
 
-// the current compiler instance
-Compiler *current = NULL;
+  Chunk *chunk;
 
-Chunk *compilingChunk;
+  Token current;
+  Token previous;
+  bool hadError;
+  bool panicMode;
+};
 
-static Chunk *currentChunk() {
-  return compilingChunk;
+static Chunk *currentChunk(Parser *parser) {
+  return parser->chunk;
 }
 
 static void errorAt(
+  Parser *parser,
   Token *token,
   const char *message
 ) {
-  if (parser.panicMode) return;
+  if (parser->panicMode) return;
 
-  parser.panicMode = true;
+  parser->panicMode = true;
 
-  fprintf(stderr, "[line %d] Error", token->line);
+  fprintf(parser->vm->err, "[line %d] Error", token->line);
 
   if (token->type == TOKEN_EOF) {
-    fprintf(stderr, " at end");
+    fprintf(parser->vm->err, " at end");
   } else if (token->type == TOKEN_ERROR) {
     // nothing
   } else {
-    fprintf(stderr, " at '%.*s'", token->length, token->start);
+    fprintf(parser->vm->err, " at '%.*s'", token->length, token->start);
   }
 
-  fprintf(stderr, ": %s\n", message);
+  fprintf(parser->vm->err, ": %s\n", message);
 
-  parser.hadError = true;
+  parser->hadError = true;
 }
 
-static void error(const char *message) {
-  errorAt(&parser.previous, message);
+static void error(
+  Parser *parser,
+  const char *message
+) {
+  errorAt(parser, &parser->previous, message);
 }
 
-static void errorAtCurrent(const char *message) {
-  errorAt(&parser.current, message);
+static void errorAtCurrent(
+  Parser *parser,
+  const char *message
+) {
+  errorAt(parser, &parser->current, message);
 }
 
-static void advance() {
-  parser.previous = parser.current;
+static void advance(Parser *parser) {
+  parser->previous = parser->current;
 
   for (;;) {
-    parser.current = scanToken();
+    parser->current = scanToken(&parser->scanner);
     
-    if (parser.current.type != TOKEN_ERROR) break;
+    if (parser->current.type != TOKEN_ERROR) break;
 
-    errorAtCurrent(parser.current.start);
+    errorAtCurrent(parser, parser->current.start);
   }
 }
 
 static void consume(
+  Parser *parser,
   TokenType type,
   const char *message
 ) {
-  if (parser.current.type == type) {
-    advance();
+  if (parser->current.type == type) {
+    advance(parser);
     return;
   }
 
-  errorAtCurrent(message);
+  errorAtCurrent(parser, message);
 }
 
-static bool check(TokenType type) {
-  return parser.current.type == type;
+static bool check(
+  Parser *parser,
+  TokenType type
+) {
+  return parser->current.type == type;
 }
 
-static bool match(TokenType type) {
-  if (!check(type)) return false;
+static bool match(
+  Parser *parser,
+  TokenType type
+) {
+  if (!check(parser, type)) return false;
 
-  advance();
+  advance(parser);
 
   return true;
 }
 
-static void emitByte(uint8_t byte) {
+static void emitByte(
+  Parser *parser,
+  uint8_t byte
+) {
   writeChunk(
-    currentChunk(),
+    currentChunk(parser),
     byte,
-    parser.previous.line
+    parser->previous.line
   );
 }
 
 static void emitBytes(
+  Parser *parser,
   uint8_t byte1,
   uint8_t byte2
 ) {
-  emitByte(byte1);
-  emitByte(byte2);
+  emitByte(parser, byte1);
+  emitByte(parser, byte2);
 }
 
-static void emitLoop(int loopStart) {
-  emitByte(OP_LOOP);
+static void emitLoop(
+  Parser *parser,
+  int loopStart
+) {
+  emitByte(parser, OP_LOOP);
 
   // +2 is from the loop instruction's operands
-  int offset = currentChunk()->count - loopStart + 2;
+  int offset = currentChunk(parser)->count - loopStart + 2;
   
-  if (offset > UINT16_MAX) error("Loop body too large.");
+  if (offset > UINT16_MAX) error(parser, "Loop body too large.");
 
-  emitByte((offset >> 8) & 0xff);
-  emitByte(offset & 0xff);
+  emitByte(parser, (offset >> 8) & 0xff);
+  emitByte(parser, offset & 0xff);
 }
 
-static int emitJump(uint8_t instruction) {
-  emitByte(instruction);
+static int emitJump(
+  Parser *parser,
+  uint8_t instruction
+) {
+  emitByte(parser, instruction);
 
   // placeholder jump offset
   // 16-bit offset = 2^16 = 65_535 bytes of code = how far we can jump
-  emitByte(0xff);
-  emitByte(0xff);
+  emitByte(parser, 0xff);
+  emitByte(parser, 0xff);
 
-  return currentChunk()->count - 2;
+  return currentChunk(parser)->count - 2;
 }
 
-static void emitReturn() {
-  emitByte(OP_RETURN);
+static void emitReturn(Parser *parser) {
+  emitByte(parser, OP_RETURN);
 }
 
 // adds the value as a constant to the current chunk and returns the index of that new constant in the chunk's constants table
-static uint8_t makeConstant(Value value) {
-  int constant = addConstant(currentChunk(), value);
+static uint8_t makeConstant(
+  Parser *parser,
+  Value value
+) {
+  int constant = addConstant(currentChunk(parser), value);
 
   if (constant > UINT8_MAX) {
-    error("too many constants in one chunk");
+    error(parser, "too many constants in one chunk");
     return 0;
   }
 
   return (uint8_t)constant;
 }
 
-static void emitConstant(Value value) {
-  emitBytes(OP_CONSTANT, makeConstant(value));
+static void emitConstant(
+  Parser *parser,
+  Value value
+) {
+  emitBytes(parser, OP_CONSTANT, makeConstant(parser, value));
 }
 
-static void patchJump(int offset) {
+static void patchJump(
+  Parser *parser,
+  int offset
+) {
   // -2 to adjust for the bytecode for the jump offset itself
-  int jump = currentChunk()->count - offset - 2;
+  int jump = currentChunk(parser)->count - offset - 2;
 
   if (jump > UINT16_MAX) {
-    error("too much code to jump over");
+    error(parser, "too much code to jump over");
   }
 
   // please someone explain the bit arithmetic???
-  currentChunk()->code[offset] = (jump >> 8) & 0xff;
-  currentChunk()->code[offset + 1] = jump & 0xff;
+  currentChunk(parser)->code[offset] = (jump >> 8) & 0xff;
+  currentChunk(parser)->code[offset + 1] = jump & 0xff;
 }
 
-static void initCompiler(Compiler *compiler) {
+static void initCompiler(
+  Parser *parser,
+  Compiler *compiler
+) {
+  compiler->enclosing = NULL;
   compiler->localCount = 0;
   compiler->scopeDepth = 0;
-  current = compiler;
+  parser->compiler = compiler;
 }
 
-static void endCompiler() {
-  emitReturn();
+static void endCompiler(Parser *parser) {
+  emitReturn(parser);
 
 #ifdef DEBUG_PRINT_CODE
 
-  if (!parser.hadError) {
-    disassembleChunk(currentChunk(), "code");
+  if (!parser->hadError) {
+    disassembleChunk(currentChunk(parser), "code");
   }
 
 #endif
 
 }
 
-static void beginScope() {
-  current->scopeDepth++;
+static void beginScope(Parser *parser) {
+  parser->compiler->scopeDepth++;
 }
 
-static void endScope() {
-  current->scopeDepth--;
+static void endScope(Parser *parser) {
+  parser->compiler->scopeDepth--;
 
   // walk backwards and pop each local
   while (
-    current->localCount > 0 &&
-    current->locals[current->localCount - 1].depth > current->scopeDepth
+    parser->compiler->localCount > 0 &&
+    parser->compiler->locals[parser->compiler->localCount - 1].depth > parser->compiler->scopeDepth
   ) {
-    emitByte(OP_POP);
-    current->localCount--; 
+    emitByte(parser, OP_POP);
+    parser->compiler->localCount--; 
   }
 }
 
 // forward declarations
-static void expression();
-static void statement();
-static void declaration();
+static void expression(Parser *parser);
+static void statement(Parser *parser);
+static void declaration(Parser *parser);
+static void block(Parser *parser);
 static ParseRule *getRule(TokenType type);
-static void parsePrecedence(Precedence precedence);
+static void parsePrecedence(Parser *parser, Precedence precedence);
+
+// an identifier or a string literal, straight out of the source if the host lets us (see `VM.borrowSource`)
+static ObjString *sourceString(
+  Parser *parser,
+  const char *start,
+  int length
+) {
+  if (parser->vm->borrowSource) return borrowInterned(parser->vm, start, length);
+
+  return copyString(parser->vm, start, length);
+}
 
 // turn an identifier into a constant and add it to the constants table, returning the index
-static uint8_t identifierConstant(Token *name) {
-  return makeConstant(OBJ_VAL(copyString(
+static uint8_t identifierConstant(
+  Parser *parser,
+  Token *name
+) {
+  return makeConstant(parser, OBJ_VAL(sourceString(
+    parser,
     name->start,
     name->length
   )));
@@ -275,6 +335,7 @@ static bool identifiersEqual(
 }
 
 static int resolveLocal(
+  Parser *parser,
   Compiler *compiler,
   Token *name
 ) {
@@ -291,7 +352,7 @@ static int resolveLocal(
     )) {
 
       if (local->depth == -1) {
-        error("Can't read local variable in its own initializer.");
+        error(parser, "Can't read local variable in its own initializer.");
       }
 
       return i;
@@ -301,160 +362,298 @@ static int resolveLocal(
   return -1;
 }
 
-static void addLocal(Token name) {
+static void addLocal(
+  Parser *parser,
+  Token name
+) {
 
-  if (current->localCount ==  UINT8_COUNT) {
-    error("too many local variables in function");
+  if (parser->compiler->localCount ==  UINT8_COUNT) {
+    error(parser, "too many local variables in function");
     return;
   }
 
-  Local *local = &current->locals[current->localCount++];
+  Local *local = &parser->compiler->locals[parser->compiler->localCount++];
 
   local->name = name;
   local->depth = -1;
 }
 
-static void declareVariable() {
-  if (current->scopeDepth == 0) return;
+static void declareVariable(Parser *parser) {
+  if (parser->compiler->scopeDepth == 0) return;
 
-  Token *name = &parser.previous;
+  Token *name = &parser->previous;
 
   for (
-    int i = current->localCount - 1;
+    int i = parser->compiler->localCount - 1;
     i >= 0;
     i--
   ) {
-    Local *local = &current->locals[i];
+    Local *local = &parser->compiler->locals[i];
     
     if (
       local->depth != -1 &&
-      local->depth < current->scopeDepth
+      local->depth < parser->compiler->scopeDepth
     ) {
       break;
     }
 
     if (identifiersEqual(name, &local->name)) {
-      error("Already a variable with this name in this scope.");
+      error(parser, "Already a variable with this name in this scope.");
     }
   }
 
-  addLocal(*name);
+  addLocal(parser, *name);
 }
 
-static uint8_t parseVariable(const char *errorMessage) {
-  consume(TOKEN_IDENTIFIER, errorMessage);
+static uint8_t parseVariable(
+  Parser *parser,
+  const char *errorMessage
+) {
+  consume(parser, TOKEN_IDENTIFIER, errorMessage);
 
-  declareVariable();
-  if (current->scopeDepth > 0) return 0;
+  declareVariable(parser);
+  if (parser->compiler->scopeDepth > 0) return 0;
 
-  return identifierConstant(&parser.previous);
+  return identifierConstant(parser, &parser->previous);
 }
 
-static void markInitialized() {
-  current->locals[current->localCount - 1].depth = current->scopeDepth;
+static void markInitialized(Parser *parser) {
+  parser->compiler->locals[parser->compiler->localCount - 1].depth = parser->compiler->scopeDepth;
 }
 
-static void defineVariable(uint8_t global) {
-  if (current->scopeDepth > 0) {
-    markInitialized();
+static void defineVariable(
+  Parser *parser,
+  uint8_t global
+) {
+  if (parser->compiler->scopeDepth > 0) {
+    markInitialized(parser);
     return;
   }
 
-  emitBytes(OP_DEFINE_GLOBAL, global);
+  emitBytes(parser, OP_DEFINE_GLOBAL, global);
 }
 
-static void and_(bool canAssign) {
-  int endJump = emitJump(OP_JUMP_IF_FALSE);
+static void and_(
+  Parser *parser,
+  bool canAssign
+) {
+  int endJump = emitJump(parser, OP_JUMP_IF_FALSE);
 
-  emitByte(OP_POP);
-  parsePrecedence(PREC_AND);
+  emitByte(parser, OP_POP);
+  parsePrecedence(parser, PREC_AND);
 
-  patchJump(endJump);
+  patchJump(parser, endJump);
 }
 
-static void binary(bool canAssign) {
-  TokenType operatorType = parser.previous.type;
+static void binary(
+  Parser *parser,
+  bool canAssign
+) {
+  TokenType operatorType = parser->previous.type;
 
   ParseRule *rule = getRule(operatorType);
 
   // +1 for left-associative, +0 for right-associative
-  parsePrecedence((Precedence)(rule->precedence + 1));
+  parsePrecedence(parser, (Precedence)(rule->precedence + 1));
 
   switch (operatorType) {
-    case TOKEN_BANG_EQUAL: emitBytes(OP_EQUAL, OP_NOT); break;
-    case TOKEN_EQUAL_EQUAL: emitByte(OP_EQUAL); break;
-    case TOKEN_GREATER: emitByte(OP_GREATER); break;
-    case TOKEN_GREATER_EQUAL: emitBytes(OP_LESS, OP_NOT); break;
-    case TOKEN_LESS: emitByte(OP_LESS); break;
-    case TOKEN_LESS_EQUAL: emitBytes(OP_GREATER, OP_NOT); break;
-    case TOKEN_PLUS: emitByte(OP_ADD); break;
-    case TOKEN_MINUS: emitByte(OP_SUBTRACT); break;
-    case TOKEN_STAR: emitByte(OP_MULTIPLY); break;
-    case TOKEN_SLASH: emitByte(OP_DIVIDE); break;
+    case TOKEN_BANG_EQUAL: emitBytes(parser, OP_EQUAL, OP_NOT); break;
+    case TOKEN_EQUAL_EQUAL: emitByte(parser, OP_EQUAL); break;
+    case TOKEN_GREATER: emitByte(parser, OP_GREATER); break;
+    case TOKEN_GREATER_EQUAL: emitBytes(parser, OP_LESS, OP_NOT); break;
+    case TOKEN_LESS: emitByte(parser, OP_LESS); break;
+    case TOKEN_LESS_EQUAL: emitBytes(parser, OP_GREATER, OP_NOT); break;
+    case TOKEN_PLUS: emitByte(parser, OP_ADD); break;
+    case TOKEN_MINUS: emitByte(parser, OP_SUBTRACT); break;
+    case TOKEN_STAR: emitByte(parser, OP_MULTIPLY); break;
+    case TOKEN_SLASH: emitByte(parser, OP_DIVIDE); break;
     default: return; // unreachable
   }
 }
 
-static void literal(bool canAssign) {
-  switch (parser.previous.type) {
-    case TOKEN_FALSE: emitByte(OP_FALSE); break;
-    case TOKEN_NIL: emitByte(OP_NIL); break;
-    case TOKEN_TRUE: emitByte(OP_TRUE); break;
+static void literal(
+  Parser *parser,
+  bool canAssign
+) {
+  switch (parser->previous.type) {
+    case TOKEN_FALSE: emitByte(parser, OP_FALSE); break;
+    case TOKEN_NIL: emitByte(parser, OP_NIL); break;
+    case TOKEN_TRUE: emitByte(parser, OP_TRUE); break;
     default: return; // unreachable
   }
 }
 
-static void grouping(bool canAssign) {
-  expression();
-  consume(TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+static uint8_t argumentList(Parser *parser) {
+  uint8_t argCount = 0;
+
+  if (!check(parser, TOKEN_RIGHT_PAREN)) {
+    do {
+      expression(parser);
+
+      if (argCount == 255) error(parser, "Can't have more than 255 arguments.");
+
+      argCount++;
+    } while (match(parser, TOKEN_COMMA));
+  }
+
+  consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+
+  return argCount;
 }
 
-static void number(bool canAssign) {
-  double value = strtod(parser.previous.start, NULL);
-  emitConstant(NUMBER_VAL(value));
+// the callee is on the stack already, then come the arguments
+static void call(
+  Parser *parser,
+  bool canAssign
+) {
+  uint8_t argCount = argumentList(parser);
+
+  emitBytes(parser, OP_CALL, argCount);
 }
 
-static void or_(bool canAssign) {
+// [a, b, c]: the elements go on the stack, and OP_LIST makes them a list
+static void list(
+  Parser *parser,
+  bool canAssign
+) {
+  int count = 0;
+
+  if (!check(parser, TOKEN_RIGHT_BRACKET)) {
+    do {
+      expression(parser);
+
+      if (count == 255) error(parser, "Can't have more than 255 elements in a list literal.");
+
+      count++;
+    } while (match(parser, TOKEN_COMMA));
+  }
+
+  consume(parser, TOKEN_RIGHT_BRACKET, "Expect ']' after list elements.");
+
+  emitBytes(parser, OP_LIST, (uint8_t)count);
+}
+
+// `{key: value, ...}`, only where an expression is expected (a statement starting with `{` is a block)
+static void map(
+  Parser *parser,
+  bool canAssign
+) {
+  int count = 0;
+
+  if (!check(parser, TOKEN_RIGHT_BRACE)) {
+    do {
+      expression(parser);
+      consume(parser, TOKEN_COLON, "Expect ':' after map key.");
+      expression(parser);
+
+      if (count == 255) error(parser, "Can't have more than 255 entries in a map literal.");
+
+      count++;
+    } while (match(parser, TOKEN_COMMA));
+  }
+
+  consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after map entries.");
+
+  emitBytes(parser, OP_MAP, (uint8_t)count);
+}
+
+// list[index] or map[key], with `= value` to set it, the list or map is on the stack already
+static void subscript(
+  Parser *parser,
+  bool canAssign
+) {
+  expression(parser);
+
+  consume(parser, TOKEN_RIGHT_BRACKET, "Expect ']' after index.");
+
+  if (
+    canAssign &&
+    match(parser, TOKEN_EQUAL)
+  ) {
+    expression(parser);
+    emitByte(parser, OP_SET_INDEX);
+  } else {
+    emitByte(parser, OP_GET_INDEX);
+  }
+}
+
+static void grouping(
+  Parser *parser,
+  bool canAssign
+) {
+  expression(parser);
+  consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+}
+
+static void number(
+  Parser *parser,
+  bool canAssign
+) {
+  double value = strtod(parser->previous.start, NULL);
+  emitConstant(parser, NUMBER_VAL(value));
+}
+
+static void or_(
+  Parser *parser,
+  bool canAssign
+) {
 
   // we are simulating "jump if true" here
 
   // if false, we skip the unconditional jump below
-  int elseJump = emitJump(OP_JUMP_IF_FALSE);
+  int elseJump = emitJump(parser, OP_JUMP_IF_FALSE);
 
   // if true, we skip right to the end
-  int endJump = emitJump(OP_JUMP);
+  int endJump = emitJump(parser, OP_JUMP);
 
   // unconditional jump skipped
-  patchJump(elseJump);
+  patchJump(parser, elseJump);
 
-  emitByte(OP_POP);
+  emitByte(parser, OP_POP);
 
-  parsePrecedence(PREC_OR);
+  parsePrecedence(parser, PREC_OR);
 
   // the end
-  patchJump(endJump);
+  patchJump(parser, endJump);
 }
 
-static void string(bool canAssign) {
-  emitConstant(OBJ_VAL(copyString(
-    parser.previous.start + 1,
-    parser.previous.length - 2
+static void string(
+  Parser *parser,
+  bool canAssign
+) {
+  emitConstant(parser, OBJ_VAL(sourceString(
+    parser,
+    parser->previous.start + 1,
+    parser->previous.length - 2
   )));
 }
 
 static void namedVariable(
+  Parser *parser,
   Token name,
   bool canAssign
 ) {
   uint8_t getOp, setOp;
 
-  int arg = resolveLocal(current, &name);
+  int arg = resolveLocal(parser, parser->compiler, &name);
+
+  // a coroutine's stack has nothing but its own locals on it, it can't see the ones around it (there are no closures)
+  for (
+    Compiler *enclosing = parser->compiler->enclosing;
+    arg == -1 && enclosing != NULL;
+    enclosing = enclosing->enclosing
+  ) {
+    if (resolveLocal(parser, enclosing, &name) != -1) {
+      error(parser, "Can't use a local variable from outside the coroutine.");
+      break;
+    }
+  }
 
   if (arg != -1) {
     getOp = OP_GET_LOCAL;
     setOp = OP_SET_LOCAL;
   } else {
-    arg = identifierConstant(&name);
+    arg = identifierConstant(parser, &name);
 
     getOp = OP_GET_GLOBAL;
     setOp = OP_SET_GLOBAL;
@@ -462,40 +661,77 @@ static void namedVariable(
 
   if (
     canAssign &&
-    match(TOKEN_EQUAL)
+    match(parser, TOKEN_EQUAL)
   ) {
-    expression();
-    emitBytes(setOp, (uint8_t)arg);
+    expression(parser);
+    emitBytes(parser, setOp, (uint8_t)arg);
   } else {
-    emitBytes(getOp, (uint8_t)arg);
+    emitBytes(parser, getOp, (uint8_t)arg);
   }
 }
 
-static void variable(bool canAssign) {
-  namedVariable(parser.previous, canAssign);
+static void variable(
+  Parser *parser,
+  bool canAssign
+) {
+  namedVariable(parser, parser->previous, canAssign);
 }
 
-static void unary(bool canAssign) {
-  TokenType operatorType = parser.previous.type;
+// `coroutine { ... }` makes a coroutine that runs the block once it's resumed
+// the body is compiled right here and jumped over, so every coroutine made by the same expression shares its code
+static void coroutine(
+  Parser *parser,
+  bool canAssign
+) {
+  int bodyJump = emitJump(parser, OP_COROUTINE);
+
+  Compiler compiler;
+  Compiler *enclosing = parser->compiler;
+
+  initCompiler(parser, &compiler);
+
+  // the body's variables are locals on the coroutine's own stack
+  compiler.enclosing = enclosing;
+  compiler.scopeDepth = 1;
+
+  consume(parser, TOKEN_LEFT_BRACE, "Expect '{' before coroutine body.");
+  block(parser);
+
+  // the locals go away with the stack
+  emitByte(parser, OP_FINISH);
+
+  parser->compiler = enclosing;
+
+  patchJump(parser, bodyJump);
+}
+
+static void unary(
+  Parser *parser,
+  bool canAssign
+) {
+  TokenType operatorType = parser->previous.type;
 
   // compile the operand
-  parsePrecedence(PREC_UNARY);
+  parsePrecedence(parser, PREC_UNARY);
 
   // emit the operator instruction
   switch (operatorType) {
-    case TOKEN_BANG: emitByte(OP_NOT); break;
-    case TOKEN_MINUS: emitByte(OP_NEGATE); break;
+    case TOKEN_BANG: emitByte(parser, OP_NOT); break;
+    case TOKEN_MINUS: emitByte(parser, OP_NEGATE); break;
     default: return; // unreachable
   }
 }
 
 // makes it very easy to see which tokens are in use by the grammar and which are available
 ParseRule rules[] = {
-  [TOKEN_LEFT_PAREN] = {grouping, NULL, PREC_NONE},
+  [TOKEN_LEFT_PAREN] = {grouping, call, PREC_CALL},
   [TOKEN_RIGHT_PAREN] = {NULL, NULL, PREC_NONE},
-  [TOKEN_LEFT_BRACE] = {NULL, NULL, PREC_NONE},
+  [TOKEN_LEFT_BRACE] = {map, NULL, PREC_NONE},
   [TOKEN_RIGHT_BRACE] = {NULL, NULL, PREC_NONE},
+  [TOKEN_LEFT_BRACKET] = {list, subscript, PREC_CALL},
+  [TOKEN_RIGHT_BRACKET] = {NULL, NULL, PREC_NONE},
   [TOKEN_COMMA] = {NULL, NULL, PREC_NONE},
+  [TOKEN_COLON] = {NULL, NULL, PREC_NONE},
   [TOKEN_DOT] = {NULL, NULL, PREC_NONE},
   [TOKEN_MINUS] = {unary, binary, PREC_TERM},
   [TOKEN_PLUS] = {NULL, binary, PREC_TERM},
@@ -515,6 +751,7 @@ ParseRule rules[] = {
   [TOKEN_NUMBER] = {number, NULL, PREC_NONE},
   [TOKEN_AND] = {NULL, and_, PREC_AND},
   [TOKEN_CLASS] = {NULL, NULL, PREC_NONE},
+  [TOKEN_COROUTINE] = {coroutine, NULL, PREC_NONE},
   [TOKEN_ELSE] = {NULL, NULL, PREC_NONE},
   [TOKEN_FALSE] = {literal, NULL, PREC_NONE},
   [TOKEN_FOR] = {NULL, NULL, PREC_NONE},
@@ -533,33 +770,36 @@ ParseRule rules[] = {
   [TOKEN_EOF] = {NULL, NULL, PREC_NONE},
 };
 
-static void parsePrecedence(Precedence precedence) {
-  advance();
+static void parsePrecedence(
+  Parser *parser,
+  Precedence precedence
+) {
+  advance(parser);
 
-  ParseFn prefixRule = getRule(parser.previous.type)->prefix;
+  ParseFn prefixRule = getRule(parser->previous.type)->prefix;
 
   if (prefixRule == NULL) {
-    error("Expect expression.");
+    error(parser, "Expect expression.");
     return;
   }
 
   bool canAssign = precedence <= PREC_ASSIGNMENT;
 
-  prefixRule(canAssign);
+  prefixRule(parser, canAssign);
 
-  while (precedence <= getRule(parser.current.type)->precedence) {
-    advance();
+  while (precedence <= getRule(parser->current.type)->precedence) {
+    advance(parser);
 
-    ParseFn infixRule = getRule(parser.previous.type)->infix;
+    ParseFn infixRule = getRule(parser->previous.type)->infix;
 
-    infixRule(canAssign);
+    infixRule(parser, canAssign);
   }
 
   if (
     canAssign &&
-    match(TOKEN_EQUAL)
+    match(parser, TOKEN_EQUAL)
   ) {
-    error("Invalid assignment target.");
+    error(parser, "Invalid assignment target.");
   }
 }
 
@@ -567,175 +807,175 @@ static ParseRule *getRule(TokenType type) {
   return &rules[type];
 }
 
-static void expression() {
+static void expression(Parser *parser) {
   // parse lowest precedence level
-  parsePrecedence(PREC_ASSIGNMENT);
+  parsePrecedence(parser, PREC_ASSIGNMENT);
 }
 
-static void block() {
+static void block(Parser *parser) {
   while (
-    !check(TOKEN_RIGHT_BRACE) &&
-    !check(TOKEN_EOF)
+    !check(parser, TOKEN_RIGHT_BRACE) &&
+    !check(parser, TOKEN_EOF)
   ) {
-    declaration();
+    declaration(parser);
   }
 
-  consume(TOKEN_RIGHT_BRACE, "Expect '}' after block.");
+  consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after block.");
 }
 
-static void varDeclaration() {
-  uint8_t global = parseVariable("Expect variable name.");
+static void varDeclaration(Parser *parser) {
+  uint8_t global = parseVariable(parser, "Expect variable name.");
 
-  if (match(TOKEN_EQUAL)) {
-    expression();
+  if (match(parser, TOKEN_EQUAL)) {
+    expression(parser);
   } else {
-    emitByte(OP_NIL);
+    emitByte(parser, OP_NIL);
   }
 
-  consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
+  consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
 
-  defineVariable(global);
+  defineVariable(parser, global);
 }
 
-static void expressionStatement() {
-  expression();
-  consume(TOKEN_SEMICOLON, "Expect ';' after expression.");
-  emitByte(OP_POP);
+static void expressionStatement(Parser *parser) {
+  expression(parser);
+  consume(parser, TOKEN_SEMICOLON, "Expect ';' after expression.");
+  emitByte(parser, OP_POP);
 }
 
-static void forStatement() {
-  beginScope();
+static void forStatement(Parser *parser) {
+  beginScope(parser);
 
-  consume(TOKEN_LEFT_PAREN, "Expect '(' after 'for'.");
+  consume(parser, TOKEN_LEFT_PAREN, "Expect '(' after 'for'.");
   
   // initializer
-  if (match(TOKEN_SEMICOLON)) {
+  if (match(parser, TOKEN_SEMICOLON)) {
     // no initializer
-  } else if (match(TOKEN_VAR)) {
-    varDeclaration();
+  } else if (match(parser, TOKEN_VAR)) {
+    varDeclaration(parser);
   } else {
-    expressionStatement();
+    expressionStatement(parser);
   }
 
-  int loopStart = currentChunk()->count;
+  int loopStart = currentChunk(parser)->count;
 
   int exitJump = -1;
 
   // condition
-  if (!match(TOKEN_SEMICOLON)) {
-    expression();
+  if (!match(parser, TOKEN_SEMICOLON)) {
+    expression(parser);
 
-    consume(TOKEN_SEMICOLON, "Expect ';' after loop condition.");
+    consume(parser, TOKEN_SEMICOLON, "Expect ';' after loop condition.");
 
     // jump out of the loop if the condition is false
-    exitJump = emitJump(OP_JUMP_IF_FALSE);
+    exitJump = emitJump(parser, OP_JUMP_IF_FALSE);
 
     // pop the condition
-    emitByte(OP_POP);
+    emitByte(parser, OP_POP);
   }
 
   // increment clause
-  if (!match(TOKEN_RIGHT_PAREN)) {
-    int bodyJump = emitJump(OP_JUMP);
-    int incrementStart = currentChunk()->count;
+  if (!match(parser, TOKEN_RIGHT_PAREN)) {
+    int bodyJump = emitJump(parser, OP_JUMP);
+    int incrementStart = currentChunk(parser)->count;
 
-    expression();
+    expression(parser);
 
-    emitByte(OP_POP);
+    emitByte(parser, OP_POP);
 
-    consume(TOKEN_RIGHT_PAREN, "Expect ')' after for clauses.");
+    consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after for clauses.");
 
-    emitLoop(loopStart);
+    emitLoop(parser, loopStart);
 
     loopStart = incrementStart;
 
-    patchJump(bodyJump);
+    patchJump(parser, bodyJump);
   }
 
-  statement();
+  statement(parser);
 
-  emitLoop(loopStart);
+  emitLoop(parser, loopStart);
 
   if (exitJump != -1) {
-    patchJump(exitJump);
+    patchJump(parser, exitJump);
 
     // pop the condition
-    emitByte(OP_POP);
+    emitByte(parser, OP_POP);
   }
 
-  endScope();
+  endScope(parser);
 }
 
-static void ifStatement() {
-  consume(TOKEN_LEFT_PAREN, "Expect '(' after 'if'.");
+static void ifStatement(Parser *parser) {
+  consume(parser, TOKEN_LEFT_PAREN, "Expect '(' after 'if'.");
 
-  expression();
+  expression(parser);
 
-  consume(TOKEN_RIGHT_PAREN, "Expect ')' after condition.");
+  consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after condition.");
 
   // backpatching (because we go back and patch the jump)
 
   // emit jump instruction with placeholder offset operand
-  int thenJump = emitJump(OP_JUMP_IF_FALSE);
+  int thenJump = emitJump(parser, OP_JUMP_IF_FALSE);
 
   // beginning of then branch: pop the condition
-  emitByte(OP_POP);
+  emitByte(parser, OP_POP);
   
   // actually compile the then body
-  statement();
+  statement(parser);
 
   // a jump to the end of the else branch
-  int elseJump = emitJump(OP_JUMP);
+  int elseJump = emitJump(parser, OP_JUMP);
 
   // now replace the placeholder offset with the real offset
-  patchJump(thenJump);
+  patchJump(parser, thenJump);
 
   // beginning of else branch: pop condition
-  emitByte(OP_POP);
+  emitByte(parser, OP_POP);
 
-  if (match(TOKEN_ELSE)) statement();
+  if (match(parser, TOKEN_ELSE)) statement(parser);
 
-  patchJump(elseJump);
+  patchJump(parser, elseJump);
 }
 
-static void printStatement() {
-  expression();
-  consume(TOKEN_SEMICOLON, "Expect ';' after value.");
-  emitByte(OP_PRINT);
+static void printStatement(Parser *parser) {
+  expression(parser);
+  consume(parser, TOKEN_SEMICOLON, "Expect ';' after value.");
+  emitByte(parser, OP_PRINT);
 }
 
-static void whileStatement() {
+static void whileStatement(Parser *parser) {
 
-  int loopStart = currentChunk()->count;
+  int loopStart = currentChunk(parser)->count;
 
-  consume(TOKEN_LEFT_PAREN, "Expect '(' after 'while'.");
+  consume(parser, TOKEN_LEFT_PAREN, "Expect '(' after 'while'.");
   
-  expression();
+  expression(parser);
   
-  consume(TOKEN_RIGHT_PAREN, "Expect ')' after condition.");
+  consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after condition.");
 
-  int exitJump = emitJump(OP_JUMP_IF_FALSE);
+  int exitJump = emitJump(parser, OP_JUMP_IF_FALSE);
 
-  emitByte(OP_POP);
+  emitByte(parser, OP_POP);
 
-  statement();
+  statement(parser);
 
-  emitLoop(loopStart);
+  emitLoop(parser, loopStart);
 
-  patchJump(exitJump);
+  patchJump(parser, exitJump);
 
-  emitByte(OP_POP);
+  emitByte(parser, OP_POP);
 }
 
-static void synchronize() {
-  parser.panicMode = false;
+static void synchronize(Parser *parser) {
+  parser->panicMode = false;
 
-  while (parser.current.type != TOKEN_EOF) {
+  while (parser->current.type != TOKEN_EOF) {
 
     // i guess this is for something like, say, `var;`, where more was expected, but we still assume the semicolon is meaningful and is intended to end the statement
-    if (parser.previous.type == TOKEN_SEMICOLON) return;
+    if (parser->previous.type == TOKEN_SEMICOLON) return;
 
-    switch (parser.current.type) {
+    switch (parser->current.type) {
       // these are all valid starting points for a new declarations or statements
       case TOKEN_CLASS:
       case TOKEN_FUN:
@@ -751,60 +991,76 @@ static void synchronize() {
         ; // do nothing
     }
 
-    advance();
+    advance(parser);
   }
 }
 
-static void declaration() {
-  if (match(TOKEN_VAR)) {
-    varDeclaration();
+static void declaration(Parser *parser) {
+  if (match(parser, TOKEN_VAR)) {
+    varDeclaration(parser);
   } else {
-    statement();
+    statement(parser);
   }
 
-  if (parser.panicMode) synchronize();
+  if (parser->panicMode) synchronize(parser);
 }
 
-static void statement() {
-  if (match(TOKEN_PRINT)) {
-    printStatement();
-  } else if (match(TOKEN_FOR)) {
-    forStatement();
-  } else if (match(TOKEN_IF)) {
-    ifStatement();
-  } else if (match(TOKEN_WHILE)) {
-    whileStatement();
-  } else if (match(TOKEN_LEFT_BRACE)) {
-    beginScope();
-    block();
-    endScope();
+static void statement(Parser *parser) {
+  if (match(parser, TOKEN_PRINT)) {
+    printStatement(parser);
+  } else if (match(parser, TOKEN_FOR)) {
+    forStatement(parser);
+  } else if (match(parser, TOKEN_IF)) {
+    ifStatement(parser);
+  } else if (match(parser, TOKEN_WHILE)) {
+    whileStatement(parser);
+  } else if (match(parser, TOKEN_LEFT_BRACE)) {
+    beginScope(parser);
+    block(parser);
+    endScope(parser);
   } else {
-    expressionStatement();
+    expressionStatement(parser);
   }
 }
 
 // returns whether or not compilation succeeded
+// the bytecode is built up in an arena that's thrown away in one go at the end, and only the finished chunk is copied into `chunk`
 bool compile(
+  VM *vm,
   const char *source,
   Chunk *chunk
 ) {
-  initScanner(source);
+  Parser parser;
+
+  parser.vm = vm;
+
+  initScanner(&parser.scanner, source);
 
   Compiler compiler;
-  initCompiler(&compiler);
+  initCompiler(&parser, &compiler);
+
+  Arena arena;
+  initArena(&arena, &vm->heap, MEMORY_COMPILER);
 
-  compilingChunk = chunk;
+  Chunk scratch;
+  initScratchChunk(&scratch, &vm->heap, &arena);
+
+  parser.chunk = &scratch;
 
   parser.hadError = false;
   parser.panicMode = false;
 
-  advance();
+  advance(&parser);
   
-  while (!match(TOKEN_EOF)) {
-    declaration();
+  while (!match(&parser, TOKEN_EOF)) {
+    declaration(&parser);
   }
 
-  endCompiler();
+  endCompiler(&parser);
+
+  if (!parser.hadError) freezeChunk(&scratch, chunk);
+
+  freeArena(&arena);
 
   return !parser.hadError;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "vm.h"
 
 bool compile(
+  VM *vm,
   const char *source,
   Chunk *chunk
 );
@@ -27,7 +27,7 @@ static int constantInstruction(
   uint8_t constant = chunk->code[offset + 1];
 
   printf("%-16s %4d '", name, constant);
-  printValue(chunk->constants.values[constant]);
+  printValue(stdout, chunk->constants.values[constant]);
   printf("'\n");
 
   return offset + 2;
@@ -116,6 +116,13 @@ int disassembleInstruction(
     case OP_JUMP: return jumpInstruction("OP_JUMP", 1, chunk, offset);
     case OP_JUMP_IF_FALSE: return jumpInstruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
     case OP_LOOP: return jumpInstruction("OP_LOOP", -1, chunk, offset);
+    case OP_CALL: return byteInstruction("OP_CALL", chunk, offset);
+    case OP_COROUTINE: return jumpInstruction("OP_COROUTINE", 1, chunk, offset);
+    case OP_FINISH: return simpleInstruction("OP_FINISH", offset);
+    case OP_LIST: return byteInstruction("OP_LIST", chunk, offset);
+    case OP_MAP: return byteInstruction("OP_MAP", chunk, offset);
+    case OP_GET_INDEX: return simpleInstruction("OP_GET_INDEX", offset);
+    case OP_SET_INDEX: return simpleInstruction("OP_SET_INDEX", offset);
     case OP_RETURN: return simpleInstruction("OP_RETURN", offset);
 
     default:
@@ -0,0 +1,364 @@
+#include <string.h>
+
+#include "intern.h"
+#include "memory.h"
+#include "object.h"
+
+// maximum load factor of 3/4
+#define INTERN_MAX_LOAD(capacity) ((capacity) - (capacity) / 4)
+
+// how many buckets of the old array each lookup or insert copies over while a resize is in progress
+#ifndef INTERN_MIGRATE_STEP
+#define INTERN_MIGRATE_STEP 32
+#endif
+
+void initInternSet(
+  InternSet *set,
+  Heap *heap
+) {
+  set->heap = heap;
+  set->count = 0;
+  set->capacity = 0;
+  set->entries = NULL;
+
+  set->oldCapacity = 0;
+  set->oldEntries = NULL;
+  set->migrated = 0;
+}
+
+void freeInternSet(InternSet *set) {
+  FREE_ARRAY(
+    set->heap,
+    MEMORY_STRINGS,
+    InternEntry,
+    set->entries,
+    set->capacity
+  );
+
+  FREE_ARRAY(
+    set->heap,
+    MEMORY_STRINGS,
+    InternEntry,
+    set->oldEntries,
+    set->oldCapacity
+  );
+
+  initInternSet(set, set->heap);
+}
+
+static ObjString *findString(
+  InternEntry *entries,
+  int capacity,
+  const char *chars,
+  int length,
+  uint32_t hash
+) {
+  if (capacity == 0) return NULL;
+
+  uint32_t mask = capacity - 1;
+
+  for (
+    uint32_t index = hash & mask;
+    ;
+    index = (index + 1) & mask
+  ) {
+    InternEntry *entry = &entries[index];
+
+    // an empty bucket ends the cluster, so the string isn't here
+    if (entry->string == NULL) return NULL;
+
+    // only touch the string itself when the inline tags already match
+    if (
+      entry->hash == hash &&
+      entry->length == length &&
+      memcmp(
+        entry->string->chars,
+        chars,
+        length
+      ) == 0
+    ) {
+      return entry->string;
+    }
+  }
+}
+
+static void insertEntry(
+  InternEntry *entries,
+  int capacity,
+  InternEntry entry
+) {
+  uint32_t mask = capacity - 1;
+  uint32_t index = entry.hash & mask;
+
+  while (entries[index].string != NULL) index = (index + 1) & mask;
+
+  entries[index] = entry;
+}
+
+// copy up to `buckets` buckets of the old array over to the current one, and release the old array once they're all done
+// the old array is never modified, so until then it's still a valid set to probe, and strings that have been copied already are simply found in the current array first
+static void migrate(
+  InternSet *set,
+  int buckets
+) {
+  while (
+    buckets > 0 &&
+    set->migrated < set->oldCapacity
+  ) {
+    InternEntry *entry = &set->oldEntries[set->migrated++];
+
+    buckets--;
+
+    if (entry->string != NULL) insertEntry(set->entries, set->capacity, *entry);
+  }
+
+  if (
+    set->oldEntries != NULL &&
+    set->migrated == set->oldCapacity
+  ) {
+    FREE_ARRAY(
+      set->heap,
+      MEMORY_STRINGS,
+      InternEntry,
+      set->oldEntries,
+      set->oldCapacity
+    );
+
+    set->oldCapacity = 0;
+    set->oldEntries = NULL;
+    set->migrated = 0;
+  }
+}
+
+static void finishMigration(InternSet *set) {
+  migrate(set, set->oldCapacity);
+}
+
+static void adjustCapacity(
+  InternSet *set,
+  int capacity
+) {
+  // only one resize at a time
+  finishMigration(set);
+
+  if (set->count > 0) {
+    set->oldCapacity = set->capacity;
+    set->oldEntries = set->entries;
+    set->migrated = 0;
+  } else {
+    FREE_ARRAY(
+      set->heap,
+      MEMORY_STRINGS,
+      InternEntry,
+      set->entries,
+      set->capacity
+    );
+  }
+
+  set->capacity = capacity;
+
+  // all buckets start out empty (NULL)
+  set->entries = ALLOCATE_ZEROED(set->heap, MEMORY_STRINGS, InternEntry, capacity);
+}
+
+ObjString *internSetFind(
+  InternSet *set,
+  const char *chars,
+  int length,
+  uint32_t hash
+) {
+  if (set->count == 0) return NULL;
+
+  if (set->oldEntries != NULL) migrate(set, INTERN_MIGRATE_STEP);
+
+  ObjString *string = findString(
+    set->entries,
+    set->capacity,
+    chars,
+    length,
+    hash
+  );
+
+  if (string != NULL) return string;
+
+  return findString(
+    set->oldEntries,
+    set->oldCapacity,
+    chars,
+    length,
+    hash
+  );
+}
+
+// the string must be hashed and must not be in the set yet (callers look it up with `internSetFind` first)
+void internSetAdd(
+  InternSet *set,
+  ObjString *string
+) {
+  if (set->oldEntries != NULL) migrate(set, INTERN_MIGRATE_STEP);
+
+  // strings still waiting in the old array are counted too, so this errs on the side of growing early
+  if (set->count + 1 > INTERN_MAX_LOAD(set->capacity)) {
+    adjustCapacity(set, GROW_CAPACITY(set->capacity));
+  }
+
+  InternEntry entry;
+
+  entry.string = string;
+  entry.hash = string->hash;
+  entry.length = string->length;
+
+  insertEntry(set->entries, set->capacity, entry);
+
+  set->count++;
+}
+
+// backward shift deletion: instead of leaving a tombstone, pull later entries of the cluster back into the hole as long as that doesn't move them in front of their home bucket
+static void removeAt(
+  InternSet *set,
+  uint32_t index
+) {
+  InternEntry *entries = set->entries;
+  uint32_t mask = set->capacity - 1;
+  uint32_t hole = index;
+
+  for (
+    uint32_t next = (hole + 1) & mask;
+    entries[next].string != NULL;
+    next = (next + 1) & mask
+  ) {
+    uint32_t home = entries[next].hash & mask;
+
+    // the entry can fill the hole if its home bucket isn't somewhere between the hole and where it sits now
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      entries[hole] = entries[next];
+      hole = next;
+    }
+  }
+
+  entries[hole].string = NULL;
+
+  set->count--;
+}
+
+bool internSetRemove(
+  InternSet *set,
+  ObjString *string
+) {
+  if (set->count == 0) return false;
+
+  // removal only happens when a collector frees strings, so it's fine to get the resize out of the way first
+  finishMigration(set);
+
+  uint32_t mask = set->capacity - 1;
+
+  for (
+    uint32_t index = string->hash & mask;
+    set->entries[index].string != NULL;
+    index = (index + 1) & mask
+  ) {
+    if (set->entries[index].string == string) {
+      removeAt(set, index);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void internSetRemoveIf(
+  InternSet *set,
+  bool (*shouldRemove)(ObjString *string)
+) {
+  if (set->count == 0) return;
+
+  finishMigration(set);
+
+  uint32_t mask = set->capacity - 1;
+
+  // start right after an empty bucket (the load factor guarantees there is one)
+  // clusters never extend across an empty bucket, so shifting entries back never moves one into a bucket we've already looked at
+  uint32_t index = 0;
+
+  while (set->entries[index].string != NULL) index++;
+
+  index = (index + 1) & mask;
+
+  for (
+    int visited = 0;
+    visited < set->capacity;
+  ) {
+    InternEntry *entry = &set->entries[index];
+
+    if (
+      entry->string != NULL &&
+      shouldRemove(entry->string)
+    ) {
+      // look at this bucket again, a later entry may have been shifted into it
+      removeAt(set, index);
+      continue;
+    }
+
+    index = (index + 1) & mask;
+    visited++;
+  }
+}
+
+void internSetForEach(
+  InternSet *set,
+  void (*visit)(ObjString *string, void *context),
+  void *context
+) {
+  // strings that have already been moved over are still in the old array too
+  finishMigration(set);
+
+  for (
+    int i = 0;
+    i < set->capacity;
+    i++
+  ) {
+    if (set->entries[i].string != NULL) visit(set->entries[i].string, context);
+  }
+}
+
+static void bucketStats(
+  InternEntry *entries,
+  int capacity,
+  long *totalProbe,
+  InternStats *stats
+) {
+  uint32_t mask = capacity - 1;
+
+  for (
+    int i = 0;
+    i < capacity;
+    i++
+  ) {
+    if (entries[i].string == NULL) continue;
+
+    int probe = (int)((i - (entries[i].hash & mask)) & mask) + 1;
+
+    *totalProbe += probe;
+
+    if (probe > 1) stats->displaced++;
+    if (probe > stats->maxProbe) stats->maxProbe = probe;
+  }
+}
+
+void internSetStats(
+  InternSet *set,
+  InternStats *stats
+) {
+  long totalProbe = 0;
+
+  stats->averageProbe = 0;
+  stats->maxProbe = 0;
+  stats->displaced = 0;
+
+  // copies of strings that have already been moved over would be counted twice, so finish the move first
+  finishMigration(set);
+
+  bucketStats(set->entries, set->capacity, &totalProbe, stats);
+
+  if (set->count > 0) stats->averageProbe = (double)totalProbe / set->count;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef clox_intern_h
+#define clox_intern_h
+
+#include "common.h"
+#include "value.h"
+
+// a bucket of the intern set
+// the hash and length are copied out of the string so that a probe can reject a candidate without dereferencing it
+typedef struct {
+  ObjString *string; // NULL for an empty bucket
+  uint32_t hash;
+  int length;
+} InternEntry;
+
+// hash set of every interned string (`vm.strings`)
+// unlike a `Table` there's no value next to each key, so a bucket is 16 bytes instead of 24 (plus a control byte)
+// linear probing with backward shift deletion, so there are no tombstones
+typedef struct {
+  Heap *heap; // where the buckets come from
+  int count; // number of strings, including those still in the old array during a resize
+  int capacity; // always a power of two
+  InternEntry *entries;
+
+  // while a resize is in progress, the previous array, left untouched and copied over a few buckets at a time (see `migrate`)
+  int oldCapacity;
+  InternEntry *oldEntries;
+  int migrated; // buckets of the old array before this index have been copied over already
+} InternSet;
+
+void initInternSet(InternSet *set, Heap *heap);
+void freeInternSet(InternSet *set);
+ObjString *internSetFind(InternSet *set, const char *chars, int length, uint32_t hash);
+void internSetAdd(InternSet *set, ObjString *string);
+
+// weak removal hooks for a collector: the set doesn't keep its strings alive, so anything about to be freed has to be dropped from it first
+bool internSetRemove(InternSet *set, ObjString *string);
+void internSetRemoveIf(InternSet *set, bool (*shouldRemove)(ObjString *string));
+
+// calls `visit` on every string in the set
+void internSetForEach(InternSet *set, void (*visit)(ObjString *string, void *context), void *context);
+
+// probe statistics, for benchmarks and debugging
+typedef struct {
+  double averageProbe; // average number of buckets a lookup of a present string has to look at
+  int maxProbe;
+  int displaced; // strings that don't sit in their home bucket
+} InternStats;
+
+void internSetStats(InternSet *set, InternStats *stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,913 @@
+// for accept4, which glibc only declares with it
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "lines.h"
+#include "memory.h"
+
+typedef enum {
+  IO_READ,
+  IO_ACCEPT,
+  IO_WRITE,
+  IO_CONNECT,
+} IoOperation;
+
+// a fiber that can run, and what the native it's parked in returns
+typedef struct {
+  ObjCoroutine *coroutine; // NULL for the main script
+  Value value;
+} Ready;
+
+typedef struct {
+  double deadline;
+  ObjCoroutine *coroutine;
+} Timer;
+
+#define EVENT_BATCH 64
+
+// one per vm, made by the first i/o native it calls
+typedef struct EventLoop {
+  int epoll;
+  ObjHandle *handles;
+
+  // first in first out, a ring
+  Ready *ready;
+  int readyHead;
+  int readyCount;
+  int readyCapacity;
+
+  // a binary min-heap on the deadline
+  Timer *timers;
+  int timerCount;
+  int timerCapacity;
+
+  int parked; // fibers waiting for a handle
+  int async; // async coroutines that haven't finished
+  bool mainWaiting; // in `loop()`
+
+  char *buffer; // what `read` reads into, IO_READ_SIZE bytes
+} EventLoop;
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static EventLoop *loopOf(VM *vm) {
+  if (vm->loop != NULL) return vm->loop;
+
+  EventLoop *loop = malloc(sizeof(EventLoop));
+
+  if (loop == NULL) exit(1);
+
+  loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+
+  if (loop->epoll < 0) exit(1);
+
+  loop->handles = NULL;
+  loop->ready = NULL;
+  loop->readyHead = 0;
+  loop->readyCount = 0;
+  loop->readyCapacity = 0;
+  loop->timers = NULL;
+  loop->timerCount = 0;
+  loop->timerCapacity = 0;
+  loop->parked = 0;
+  loop->async = 0;
+  loop->mainWaiting = false;
+  loop->buffer = malloc(IO_READ_SIZE);
+
+  if (loop->buffer == NULL) exit(1);
+
+  vm->loop = loop;
+
+  return loop;
+}
+
+// the run queue
+
+static void makeReady(
+  EventLoop *loop,
+  ObjCoroutine *coroutine,
+  Value value
+) {
+  if (loop->readyCount == loop->readyCapacity) {
+    int capacity = GROW_CAPACITY(loop->readyCapacity);
+    Ready *ready = malloc(sizeof(Ready) * capacity);
+
+    if (ready == NULL) exit(1);
+
+    // unwrap the ring while copying
+    for (int i = 0; i < loop->readyCount; i++) {
+      ready[i] = loop->ready[(loop->readyHead + i) % loop->readyCapacity];
+    }
+
+    free(loop->ready);
+
+    loop->ready = ready;
+    loop->readyHead = 0;
+    loop->readyCapacity = capacity;
+  }
+
+  loop->ready[(loop->readyHead + loop->readyCount) % loop->readyCapacity] = (Ready){coroutine, value};
+  loop->readyCount++;
+}
+
+static Ready takeReady(EventLoop *loop) {
+  Ready ready = loop->ready[loop->readyHead];
+
+  loop->readyHead = (loop->readyHead + 1) % loop->readyCapacity;
+  loop->readyCount--;
+
+  return ready;
+}
+
+// timers
+
+static void addTimer(
+  EventLoop *loop,
+  double deadline,
+  ObjCoroutine *coroutine
+) {
+  if (loop->timerCount == loop->timerCapacity) {
+    loop->timerCapacity = GROW_CAPACITY(loop->timerCapacity);
+    loop->timers = realloc(loop->timers, sizeof(Timer) * loop->timerCapacity);
+
+    if (loop->timers == NULL) exit(1);
+  }
+
+  // sift up
+  int index = loop->timerCount++;
+
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+
+    if (loop->timers[parent].deadline <= deadline) break;
+
+    loop->timers[index] = loop->timers[parent];
+    index = parent;
+  }
+
+  loop->timers[index] = (Timer){deadline, coroutine};
+}
+
+static Timer removeFirstTimer(EventLoop *loop) {
+  Timer first = loop->timers[0];
+  Timer last = loop->timers[--loop->timerCount];
+  int index = 0;
+
+  // sift the last one down from the top
+  for (;;) {
+    int child = index * 2 + 1;
+
+    if (child >= loop->timerCount) break;
+
+    if (
+      child + 1 < loop->timerCount &&
+      loop->timers[child + 1].deadline < loop->timers[child].deadline
+    ) {
+      child++;
+    }
+
+    if (last.deadline <= loop->timers[child].deadline) break;
+
+    loop->timers[index] = loop->timers[child];
+    index = child;
+  }
+
+  if (loop->timerCount > 0) loop->timers[index] = last;
+
+  return first;
+}
+
+// operations
+// each one either completes, with its result in `result`, or returns false because it would have to block
+
+static bool attemptRead(
+  VM *vm,
+  ObjHandle *handle,
+  Value *result
+) {
+  ssize_t count = read(handle->fd, vm->loop->buffer, IO_READ_SIZE);
+
+  if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+  if (count < 0 && errno == EINTR) return false;
+
+  // the end, or the other end is gone
+  if (count <= 0) {
+    *result = NIL_VAL;
+    return true;
+  }
+
+  char *chars = ALLOCATE(&vm->heap, MEMORY_STRING_CHARS, char, count + 1);
+
+  memcpy(chars, vm->loop->buffer, count);
+  chars[count] = '\0';
+
+  *result = OBJ_VAL(takeString(vm, chars, (int)count));
+
+  return true;
+}
+
+static void track(
+  VM *vm,
+  ObjHandle *handle
+);
+
+static bool attemptAccept(
+  VM *vm,
+  ObjHandle *handle,
+  Value *result
+) {
+  int fd = accept4(handle->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+  if (fd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return false;
+
+  if (fd < 0) {
+    *result = NIL_VAL;
+    return true;
+  }
+
+  ObjHandle *connection = newHandle(vm, fd, true);
+
+  track(vm, connection);
+
+  *result = OBJ_VAL(connection);
+
+  return true;
+}
+
+static bool attemptWrite(
+  ObjHandle *handle,
+  IoWaiter *waiter,
+  Value *result
+) {
+  ObjString *data = waiter->data;
+
+  while (waiter->done < (size_t)data->length) {
+    ssize_t count = send(
+      handle->fd,
+      data->chars + waiter->done,
+      data->length - waiter->done,
+      MSG_NOSIGNAL
+    );
+
+    // not a socket
+    if (count < 0 && errno == ENOTSOCK) {
+      count = write(handle->fd, data->chars + waiter->done, data->length - waiter->done);
+    }
+
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return false;
+
+    if (count < 0) {
+      *result = BOOL_VAL(false);
+      return true;
+    }
+
+    waiter->done += count;
+  }
+
+  *result = BOOL_VAL(true);
+
+  return true;
+}
+
+static bool attemptConnect(
+  ObjHandle *handle,
+  Value *result
+) {
+  int error = 0;
+  socklen_t length = sizeof(error);
+
+  getsockopt(handle->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+  if (error == EINPROGRESS || error == EAGAIN) return false;
+
+  *result = error == 0 ? OBJ_VAL(handle) : NIL_VAL;
+
+  return true;
+}
+
+static bool attempt(
+  VM *vm,
+  ObjHandle *handle,
+  IoWaiter *waiter,
+  Value *result
+) {
+  switch (waiter->operation) {
+    case IO_READ: return attemptRead(vm, handle, result);
+    case IO_ACCEPT: return attemptAccept(vm, handle, result);
+    case IO_WRITE: return attemptWrite(handle, waiter, result);
+    case IO_CONNECT: return attemptConnect(handle, result);
+  }
+
+  return true; // unreachable
+}
+
+// switching
+
+static void switchTo(
+  VM *vm,
+  Ready ready
+) {
+  ObjCoroutine *coroutine = ready.coroutine;
+
+  vm->coroutine = coroutine;
+  loadFiber(vm, coroutine == NULL ? &vm->main : &coroutine->fiber);
+
+  if (coroutine != NULL) {
+    // a new async coroutine isn't in a native, there's nothing to return
+    if (coroutine->state == COROUTINE_NEW) {
+      coroutine->state = COROUTINE_RUNNING;
+      return;
+    }
+
+    coroutine->state = COROUTINE_RUNNING;
+  }
+
+  vm->stackTop[-1] = ready.value;
+}
+
+// handles every event that's there, waiting up to `timeout` milliseconds (-1 for as long as it takes) for the first
+static void waitForEvents(
+  VM *vm,
+  int timeout
+) {
+  EventLoop *loop = vm->loop;
+  struct epoll_event events[EVENT_BATCH];
+
+  int count = epoll_wait(loop->epoll, events, EVENT_BATCH, timeout);
+
+  for (int i = 0; i < count; i++) {
+    ObjHandle *handle = events[i].data.ptr;
+    uint32_t flags = events[i].events;
+    bool failed = flags & (EPOLLHUP | EPOLLERR);
+    Value result;
+
+    // edge triggered, so an event only says something changed, and the operation might still have to wait for the next one
+    if (
+      handle->reader.waiting &&
+      (failed || flags & EPOLLIN) &&
+      attempt(vm, handle, &handle->reader, &result)
+    ) {
+      handle->reader.waiting = false;
+      loop->parked--;
+      makeReady(loop, handle->reader.coroutine, result);
+    }
+
+    if (
+      handle->writer.waiting &&
+      (failed || flags & EPOLLOUT) &&
+      attempt(vm, handle, &handle->writer, &result)
+    ) {
+      handle->writer.waiting = false;
+      loop->parked--;
+      makeReady(loop, handle->writer.coroutine, result);
+    }
+  }
+
+  double time = now();
+
+  while (
+    loop->timerCount > 0 &&
+    loop->timers[0].deadline <= time
+  ) {
+    makeReady(loop, removeFirstTimer(loop).coroutine, NIL_VAL);
+  }
+}
+
+// the fiber that was running has been saved (parked, yielded or finished), run the next one, waiting for events until there is one
+static void runNext(VM *vm) {
+  EventLoop *loop = vm->loop;
+
+  while (loop->readyCount == 0) {
+    // nothing can wake anyone anymore, which only happens once the main script is the one waiting, in `loop()`, and every async coroutine has finished
+    if (
+      loop->parked == 0 &&
+      loop->timerCount == 0
+    ) {
+      loop->mainWaiting = false;
+      makeReady(loop, NULL, NIL_VAL);
+      break;
+    }
+
+    int timeout = -1;
+
+    if (loop->timerCount > 0) {
+      double wait = loop->timers[0].deadline - now();
+
+      timeout = wait <= 0 ? 0 : (int)ceil(wait * 1e3);
+    }
+
+    waitForEvents(vm, timeout);
+  }
+
+  switchTo(vm, takeReady(loop));
+}
+
+// saves the running fiber, which waits in a native until the loop makes it ready again
+static void park(VM *vm) {
+  ObjCoroutine *coroutine = vm->coroutine;
+
+  if (coroutine == NULL) {
+    saveFiber(vm, &vm->main);
+  } else {
+    saveFiber(vm, &coroutine->fiber);
+    coroutine->state = COROUTINE_WAITING;
+  }
+}
+
+void asyncSuspended(
+  VM *vm,
+  ObjCoroutine *coroutine
+) {
+  EventLoop *loop = vm->loop;
+
+  if (coroutine->state == COROUTINE_DONE) {
+    loop->async--;
+
+    if (
+      loop->async == 0 &&
+      loop->mainWaiting
+    ) {
+      loop->mainWaiting = false;
+      makeReady(loop, NULL, NIL_VAL);
+    }
+  } else {
+    // yielded: to the back of the line
+    coroutine->state = COROUTINE_WAITING;
+    makeReady(loop, coroutine, NIL_VAL);
+  }
+
+  runNext(vm);
+}
+
+// starts an operation on a handle, and parks the caller if it can't complete right away
+static void perform(
+  VM *vm,
+  ObjHandle *handle,
+  IoWaiter *waiter,
+  Value *args
+) {
+  Value result;
+
+  if (attempt(vm, handle, waiter, &result)) {
+    args[-1] = result;
+    return;
+  }
+
+  // the string has to stay the same while others run
+  if (waiter->operation == IO_WRITE) ownValue(vm, OBJ_VAL(waiter->data));
+
+  waiter->waiting = true;
+  waiter->coroutine = vm->coroutine;
+  vm->loop->parked++;
+
+  args[-1] = NIL_VAL;
+
+  park(vm);
+  runNext(vm);
+}
+
+// handles
+
+// every handle goes into the loop's list, and a socket into epoll, for good (edge triggered, so there's no need to change what it's waiting for)
+static void track(
+  VM *vm,
+  ObjHandle *handle
+) {
+  EventLoop *loop = loopOf(vm);
+
+  handle->next = loop->handles;
+  loop->handles = handle;
+
+  if (!handle->pollable) return;
+
+  struct epoll_event event;
+
+  event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  event.data.ptr = handle;
+
+  epoll_ctl(loop->epoll, EPOLL_CTL_ADD, handle->fd, &event);
+}
+
+static ObjHandle *openHandle(
+  VM *vm,
+  Value value
+) {
+  if (!IS_HANDLE(value)) {
+    runtimeError(vm, "Expected a handle.");
+    return NULL;
+  }
+
+  ObjHandle *handle = AS_HANDLE(value);
+
+  if (handle->fd < 0) {
+    runtimeError(vm, "Handle is closed.");
+    return NULL;
+  }
+
+  return handle;
+}
+
+static bool unixAddress(
+  VM *vm,
+  Value path,
+  struct sockaddr_un *address
+) {
+  if (!IS_STRING(path)) {
+    runtimeError(vm, "Expected a socket path.");
+    return false;
+  }
+
+  terminateValue(vm, path);
+
+  if (AS_STRING(path)->length >= (int)sizeof(address->sun_path)) {
+    runtimeError(vm, "Socket path too long.");
+    return false;
+  }
+
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  memcpy(address->sun_path, AS_CSTRING(path), AS_STRING(path)->length + 1);
+
+  return true;
+}
+
+// natives
+
+bool asyncNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (
+    !IS_COROUTINE(args[0]) ||
+    AS_COROUTINE(args[0])->state != COROUTINE_NEW
+  ) {
+    runtimeError(vm, "Can only hand a new coroutine to the event loop.");
+    return false;
+  }
+
+  EventLoop *loop = loopOf(vm);
+  ObjCoroutine *coroutine = AS_COROUTINE(args[0]);
+
+  // it stays new until it first runs (see `switchTo`), `resume` checks `async` anyway
+  coroutine->async = true;
+  loop->async++;
+
+  makeReady(loop, coroutine, NIL_VAL);
+
+  args[-1] = args[0];
+
+  return true;
+}
+
+bool loopNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 0, argCount)) return false;
+
+  if (vm->coroutine != NULL) {
+    runtimeError(vm, "Can only wait for the event loop in the main script.");
+    return false;
+  }
+
+  EventLoop *loop = loopOf(vm);
+
+  args[-1] = NIL_VAL;
+
+  if (loop->async == 0) return true;
+
+  loop->mainWaiting = true;
+
+  park(vm);
+  runNext(vm);
+
+  return true;
+}
+
+bool sleepNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (!IS_NUMBER(args[0])) {
+    runtimeError(vm, "Argument to sleep must be a number of milliseconds.");
+    return false;
+  }
+
+  EventLoop *loop = loopOf(vm);
+
+  args[-1] = NIL_VAL;
+
+  addTimer(loop, now() + AS_NUMBER(args[0]) / 1e3, vm->coroutine);
+
+  park(vm);
+  runNext(vm);
+
+  return true;
+}
+
+bool openNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  if (
+    !IS_STRING(args[0]) ||
+    !IS_STRING(args[1])
+  ) {
+    runtimeError(vm, "Arguments to open must be a path and a mode.");
+    return false;
+  }
+
+  // they're used as c strings
+  terminateValue(vm, args[0]);
+  terminateValue(vm, args[1]);
+
+  const char *mode = AS_CSTRING(args[1]);
+  int flags;
+
+  if (strcmp(mode, "r") == 0) {
+    flags = O_RDONLY;
+  } else if (strcmp(mode, "w") == 0) {
+    flags = O_WRONLY | O_CREAT | O_TRUNC;
+  } else if (strcmp(mode, "a") == 0) {
+    flags = O_WRONLY | O_CREAT | O_APPEND;
+  } else {
+    runtimeError(vm, "Mode must be \"r\", \"w\" or \"a\".");
+    return false;
+  }
+
+  int fd = open(AS_CSTRING(args[0]), flags | O_NONBLOCK | O_CLOEXEC, 0666);
+
+  if (fd < 0) {
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  // pipes and fifos can wait, regular files and the like are always ready
+  struct stat info;
+  bool pollable = fstat(fd, &info) == 0 && (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode) || S_ISCHR(info.st_mode));
+
+  ObjHandle *handle = newHandle(vm, fd, pollable);
+
+  track(vm, handle);
+
+  args[-1] = OBJ_VAL(handle);
+
+  return true;
+}
+
+bool listenNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  struct sockaddr_un address;
+
+  if (!unixAddress(vm, args[0], &address)) return false;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (
+    fd < 0 ||
+    bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+    listen(fd, SOMAXCONN) != 0
+  ) {
+    if (fd >= 0) close(fd);
+
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  ObjHandle *handle = newHandle(vm, fd, true);
+
+  track(vm, handle);
+
+  args[-1] = OBJ_VAL(handle);
+
+  return true;
+}
+
+bool connectNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  struct sockaddr_un address;
+
+  if (!unixAddress(vm, args[0], &address)) return false;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (fd < 0) {
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  // a unix socket connects right away, or fails with EAGAIN when the listener's backlog is full
+  if (
+    connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0 &&
+    errno != EAGAIN &&
+    errno != EINPROGRESS
+  ) {
+    close(fd);
+
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  ObjHandle *handle = newHandle(vm, fd, true);
+
+  track(vm, handle);
+
+  handle->writer.operation = IO_CONNECT;
+
+  perform(vm, handle, &handle->writer, args);
+
+  return true;
+}
+
+bool acceptNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  ObjHandle *handle = openHandle(vm, args[0]);
+
+  if (handle == NULL) return false;
+
+  if (handle->reader.waiting) {
+    runtimeError(vm, "Handle is being read already.");
+    return false;
+  }
+
+  handle->reader.operation = IO_ACCEPT;
+
+  perform(vm, handle, &handle->reader, args);
+
+  return true;
+}
+
+bool readNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  ObjHandle *handle = openHandle(vm, args[0]);
+
+  if (handle == NULL) return false;
+
+  if (handle->reader.waiting) {
+    runtimeError(vm, "Handle is being read already.");
+    return false;
+  }
+
+  loopOf(vm);
+
+  handle->reader.operation = IO_READ;
+
+  perform(vm, handle, &handle->reader, args);
+
+  return true;
+}
+
+bool writeNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  ObjHandle *handle = openHandle(vm, args[0]);
+
+  if (handle == NULL) return false;
+
+  if (!IS_STRING(args[1])) {
+    runtimeError(vm, "Can only write strings.");
+    return false;
+  }
+
+  if (handle->writer.waiting) {
+    runtimeError(vm, "Handle is being written already.");
+    return false;
+  }
+
+  handle->writer.operation = IO_WRITE;
+  handle->writer.data = AS_STRING(args[1]);
+  handle->writer.done = 0;
+
+  perform(vm, handle, &handle->writer, args);
+
+  return true;
+}
+
+bool closeNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (IS_LINES(args[0])) {
+    closeLines(vm, AS_LINES(args[0]));
+
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  ObjHandle *handle = openHandle(vm, args[0]);
+
+  if (handle == NULL) return false;
+
+  EventLoop *loop = vm->loop;
+
+  // whoever was waiting on it gets what they'd get at the end of the stream
+  if (handle->reader.waiting) {
+    handle->reader.waiting = false;
+    loop->parked--;
+    makeReady(loop, handle->reader.coroutine, NIL_VAL);
+  }
+
+  if (handle->writer.waiting) {
+    handle->writer.waiting = false;
+    loop->parked--;
+    makeReady(loop, handle->writer.coroutine, handle->writer.operation == IO_WRITE ? BOOL_VAL(false) : NIL_VAL);
+  }
+
+  // closing the fd takes it out of epoll too
+  close(handle->fd);
+  handle->fd = -1;
+
+  args[-1] = NIL_VAL;
+
+  return true;
+}
+
+// resetting and freeing
+
+void resetEventLoop(VM *vm) {
+  EventLoop *loop = vm->loop;
+
+  for (ObjHandle *handle = loop->handles; handle != NULL; handle = handle->next) {
+    handle->reader.waiting = false;
+    handle->writer.waiting = false;
+  }
+
+  loop->readyHead = 0;
+  loop->readyCount = 0;
+  loop->timerCount = 0;
+  loop->parked = 0;
+  loop->async = 0;
+  loop->mainWaiting = false;
+}
+
+void freeEventLoop(VM *vm) {
+  EventLoop *loop = vm->loop;
+
+  for (ObjHandle *handle = loop->handles; handle != NULL; handle = handle->next) {
+    if (handle->fd >= 0) close(handle->fd);
+  }
+
+  close(loop->epoll);
+
+  free(loop->ready);
+  free(loop->timers);
+  free(loop->buffer);
+  free(loop);
+
+  vm->loop = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef clox_io_h
+#define clox_io_h
+
+#include "common.h"
+#include "object.h"
+#include "vm.h"
+
+// non-blocking i/o for scripts: an epoll event loop that switches between coroutines, so one vm can have thousands of reads, writes and timers in flight
+//
+//   async(coroutine)      hands a new coroutine to the event loop, which runs it alongside the others
+//   loop()                the main script waits until every async coroutine has finished
+//   sleep(ms)             waits for a while
+//   open(path, mode)      a file handle ("r", "w" or "a"), nil if it can't be opened
+//   listen(path)          a unix domain socket listening at `path`, nil if it can't bind
+//   connect(path)         a unix domain socket connected to `path`, nil if nobody's listening
+//   accept(listener)      the next connection to a listening socket
+//   read(handle)          whatever is there (up to IO_READ_SIZE bytes), nil at the end of the file or stream
+//   write(handle, text)   writes all of it, false if the other end has gone away
+//   close(handle)         (also unmaps a file from `lines`, see lines.h)
+//
+// an operation that can't complete right away parks whatever called it (an async coroutine, any other coroutine or the main script) and the loop runs something else until it can
+// so inside a coroutine it reads like blocking code, and outside of one it simply blocks, while the async coroutines get on with their work
+// `yield()` in an async coroutine lets the others run first
+// regular files are always ready as far as epoll is concerned (it refuses them), so file operations complete right away
+
+#define IO_READ_SIZE 65536
+
+bool asyncNative(VM *vm, int argCount, Value *args);
+bool loopNative(VM *vm, int argCount, Value *args);
+bool sleepNative(VM *vm, int argCount, Value *args);
+bool openNative(VM *vm, int argCount, Value *args);
+bool listenNative(VM *vm, int argCount, Value *args);
+bool connectNative(VM *vm, int argCount, Value *args);
+bool acceptNative(VM *vm, int argCount, Value *args);
+bool readNative(VM *vm, int argCount, Value *args);
+bool writeNative(VM *vm, int argCount, Value *args);
+bool closeNative(VM *vm, int argCount, Value *args);
+
+// called by the vm when an async coroutine yields or finishes, once its fiber has been saved: runs whatever is next
+void asyncSuspended(VM *vm, ObjCoroutine *coroutine);
+
+// forgets every coroutine the loop was going to run (they belong to the run that made them), the handles stay open
+void resetEventLoop(VM *vm);
+
+// closes every handle that's still open
+void freeEventLoop(VM *vm);
+
+#endif
\ No newline at end of file
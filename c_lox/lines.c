@@ -0,0 +1,269 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lines.h"
+
+static bool stackHolds(
+  Value *from,
+  Value *to,
+  ObjString *line
+) {
+  for (Value *slot = from; slot < to; slot++) {
+    if (
+      IS_OBJ(*slot) &&
+      AS_OBJ(*slot) == (Obj *)line
+    ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// can the script still get at a line it was given?
+// the only places a borrowed string can be without having been copied (see `ownValue`) are the globals and the stacks
+// not just the stack of whoever got it: a line read from a global goes onto the stack of whoever reads it, even if the global is set to something else later
+static bool held(
+  VM *vm,
+  ObjString *line
+) {
+  // whatever runs right now, and the main script's saved stack if that's a coroutine
+  if (stackHolds(vm->stack, vm->stackTop, line)) return true;
+
+  if (
+    vm->coroutine != NULL &&
+    stackHolds(vm->main.stack, vm->main.stackTop, line)
+  ) {
+    return true;
+  }
+
+  ObjCoroutine **link = &vm->coroutines;
+
+  while (*link != NULL) {
+    ObjCoroutine *coroutine = *link;
+
+    // a finished coroutine has no stack anymore, and one from an earlier script never runs again
+    if (
+      coroutine->state == COROUTINE_DONE ||
+      coroutine->run != vm->runs
+    ) {
+      *link = coroutine->next;
+      continue;
+    }
+
+    // the running one's stack is the vm's, its fiber is out of date
+    if (
+      coroutine != vm->coroutine &&
+      stackHolds(coroutine->fiber.stack, coroutine->fiber.stackTop, line)
+    ) {
+      return true;
+    }
+
+    link = &coroutine->next;
+  }
+
+  return tableHoldsObject(&vm->globals, (Obj *)line);
+}
+
+// drops the pages before the last two lines from memory, they're never read again (every earlier line that's still around has its own copy)
+// the mapping is read-only and backed by the file, so there's nothing to write back, it's only about resident memory
+static void release(ObjLines *lines) {
+  // the last line is always borrowed, the one before it only if nobody's kept it
+  ObjString *oldest = lines->line;
+
+  if (
+    lines->previous != NULL &&
+    lines->previous->obj.flags & OBJ_BORROWED
+  ) {
+    oldest = lines->previous;
+  }
+
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t until = (size_t)(oldest->chars - lines->start) / page * page;
+
+  if (until < lines->released + LINES_RELEASE_BYTES) return;
+
+  madvise((char *)lines->start + lines->released, until - lines->released, MADV_DONTNEED);
+
+  lines->released = until;
+}
+
+bool linesNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (!IS_STRING(args[0])) {
+    runtimeError(vm, "Argument to lines must be a path.");
+    return false;
+  }
+
+  terminateValue(vm, args[0]);
+
+  int fd = open(AS_CSTRING(args[0]), O_RDONLY | O_CLOEXEC);
+  struct stat info;
+
+  if (fd < 0) {
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  if (
+    fstat(fd, &info) != 0 ||
+    !S_ISREG(info.st_mode)
+  ) {
+    close(fd);
+
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  const char *start = NULL;
+  size_t size = (size_t)info.st_size;
+
+  // there's nothing to map in an empty file
+  if (size > 0) {
+    start = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (start == MAP_FAILED) {
+      close(fd);
+
+      args[-1] = NIL_VAL;
+      return true;
+    }
+
+    madvise((char *)start, size, MADV_SEQUENTIAL);
+  }
+
+  // the mapping keeps the file
+  close(fd);
+
+  ObjLines *lines = newLines(vm, start, size);
+
+  lines->next = vm->files;
+  vm->files = lines;
+
+  args[-1] = OBJ_VAL(lines);
+
+  return true;
+}
+
+bool nextLineNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (!IS_LINES(args[0])) {
+    runtimeError(vm, "Argument to nextLine must be a mapped file.");
+    return false;
+  }
+
+  ObjLines *lines = AS_LINES(args[0]);
+
+  if (
+    lines->start == NULL &&
+    lines->size > 0
+  ) {
+    runtimeError(vm, "File is closed.");
+    return false;
+  }
+
+  if (lines->offset >= lines->size) {
+    args[-1] = NIL_VAL;
+    return true;
+  }
+
+  const char *start = lines->start + lines->offset;
+  size_t rest = lines->size - lines->offset;
+  const char *newline = memchr(start, '\n', rest);
+  size_t length = newline == NULL ? rest : (size_t)(newline - start);
+
+  if (length > INT_MAX) {
+    runtimeError(vm, "Line too long.");
+    return false;
+  }
+
+  lines->offset += newline == NULL ? rest : length + 1;
+
+  if (
+    length > 0 &&
+    start[length - 1] == '\r'
+  ) {
+    length--;
+  }
+
+  // the line before the last one: while the script works on the last one, that's the line its variable doesn't hold anymore
+  ObjString *line = lines->previous;
+
+  if (
+    line != NULL &&
+    line->obj.flags & OBJ_BORROWED &&
+    !held(vm, line)
+  ) {
+    // nobody has it anymore, the same object can be the next line
+    line->chars = (char *)start;
+    line->length = (int)length;
+    line->obj.flags &= ~OBJ_HASHED;
+  } else {
+    // the script kept it, so it keeps its contents, in a copy of its own
+    if (
+      line != NULL &&
+      line->obj.flags & OBJ_BORROWED
+    ) {
+      ownString(vm, line);
+    }
+
+    line = borrowString(vm, start, (int)length);
+  }
+
+  lines->previous = lines->line;
+  lines->line = line;
+
+  release(lines);
+
+  args[-1] = OBJ_VAL(line);
+
+  return true;
+}
+
+void closeLines(
+  VM *vm,
+  ObjLines *lines
+) {
+  if (lines->start == NULL) return;
+
+  // the only lines that can still be borrowed
+  if (
+    lines->line != NULL &&
+    lines->line->obj.flags & OBJ_BORROWED
+  ) {
+    ownString(vm, lines->line);
+  }
+
+  if (
+    lines->previous != NULL &&
+    lines->previous->obj.flags & OBJ_BORROWED
+  ) {
+    ownString(vm, lines->previous);
+  }
+
+  munmap((char *)lines->start, lines->size);
+
+  lines->start = NULL;
+}
+
+void freeLines(VM *vm) {
+  for (ObjLines *lines = vm->files; lines != NULL; lines = lines->next) {
+    if (lines->start != NULL) munmap((char *)lines->start, lines->size);
+  }
+
+  vm->files = NULL;
+}
\ No newline at end of file
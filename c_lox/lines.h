@@ -0,0 +1,31 @@
+#ifndef clox_lines_h
+#define clox_lines_h
+
+#include "common.h"
+#include "object.h"
+#include "vm.h"
+
+// reading big files a line at a time, straight out of a read-only mapping
+//
+//   lines(path)        the file, mapped, nil if it can't be opened
+//   nextLine(lines)    the next line without its "\n" (or "\r\n"), nil after the last one
+//   close(lines)       unmaps it before the vm is freed
+//
+// a line is a borrowed string (see OBJ_BORROWED): it points into the mapping, nothing is copied
+// the lines take turns between two string objects: when a line is two behind and the script doesn't have it anymore (in the usual `line = nextLine(f)` loop, its variable has moved on), its object becomes the next line, so a file of any size takes no memory beyond the mapping
+// a line the script has kept (on the stack or in a global) gets its own copy at that point, and one handed to another coroutine or actor gets it right away
+// the pages behind the current line are handed back to the kernel as it goes, so a multi-gigabyte file doesn't stay resident either
+
+// how far behind the current line the pages have to be before they're released
+#define LINES_RELEASE_BYTES (32 * 1024 * 1024)
+
+bool linesNative(VM *vm, int argCount, Value *args);
+bool nextLineNative(VM *vm, int argCount, Value *args);
+
+// `close` for a mapped file
+void closeLines(VM *vm, ObjLines *lines);
+
+// unmaps every file that's still mapped
+void freeLines(VM *vm);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,739 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "list.h"
+#include "memory.h"
+
+// the widest vectors the build targets, and a fallback that's plain c
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+#define LANES 4
+
+typedef __m256d Vector;
+
+#define VECTOR_ZERO() _mm256_setzero_pd()
+#define VECTOR_SET(x) _mm256_set1_pd(x)
+#define VECTOR_LOAD(p) _mm256_loadu_pd(p)
+#define VECTOR_STORE(p, v) _mm256_storeu_pd(p, v)
+#define VECTOR_ADD(a, b) _mm256_add_pd(a, b)
+#define VECTOR_SUB(a, b) _mm256_sub_pd(a, b)
+#define VECTOR_MUL(a, b) _mm256_mul_pd(a, b)
+#define VECTOR_DIV(a, b) _mm256_div_pd(a, b)
+#define VECTOR_SQRT(a) _mm256_sqrt_pd(a)
+#define VECTOR_ANDNOT(a, b) _mm256_andnot_pd(a, b)
+#define VECTOR_XOR(a, b) _mm256_xor_pd(a, b)
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define LANES 2
+
+typedef __m128d Vector;
+
+#define VECTOR_ZERO() _mm_setzero_pd()
+#define VECTOR_SET(x) _mm_set1_pd(x)
+#define VECTOR_LOAD(p) _mm_loadu_pd(p)
+#define VECTOR_STORE(p, v) _mm_storeu_pd(p, v)
+#define VECTOR_ADD(a, b) _mm_add_pd(a, b)
+#define VECTOR_SUB(a, b) _mm_sub_pd(a, b)
+#define VECTOR_MUL(a, b) _mm_mul_pd(a, b)
+#define VECTOR_DIV(a, b) _mm_div_pd(a, b)
+#define VECTOR_SQRT(a) _mm_sqrt_pd(a)
+#define VECTOR_ANDNOT(a, b) _mm_andnot_pd(a, b)
+#define VECTOR_XOR(a, b) _mm_xor_pd(a, b)
+
+#endif
+
+// sorts this short are done by insertion
+#define SORT_INSERTION_MAX 64
+
+// radix sort: 64 bit keys, 11 bits at a time
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES ((64 + RADIX_BITS - 1) / RADIX_BITS)
+
+// storage
+
+static void growList(
+  VM *vm,
+  ObjList *list,
+  int capacity
+) {
+  if (list->numeric) {
+    list->as.numbers = GROW_ARRAY(
+      &vm->heap,
+      MEMORY_LIST,
+      double,
+      list->as.numbers,
+      list->capacity,
+      capacity
+    );
+  } else {
+    list->as.values = GROW_ARRAY(
+      &vm->heap,
+      MEMORY_LIST,
+      Value,
+      list->as.values,
+      list->capacity,
+      capacity
+    );
+  }
+
+  list->capacity = capacity;
+}
+
+// an element that isn't a number is on its way in
+static void box(
+  VM *vm,
+  ObjList *list
+) {
+  Value *values = NULL;
+
+  if (list->capacity > 0) {
+    values = ALLOCATE(&vm->heap, MEMORY_LIST, Value, list->capacity);
+
+    for (int i = 0; i < list->count; i++) {
+      values[i] = NUMBER_VAL(list->as.numbers[i]);
+    }
+
+    FREE_ARRAY(&vm->heap, MEMORY_LIST, double, list->as.numbers, list->capacity);
+  }
+
+  list->as.values = values;
+  list->numeric = false;
+}
+
+// back to doubles, if every element is a number again
+static bool unbox(
+  VM *vm,
+  ObjList *list
+) {
+  if (list->numeric) return true;
+
+  for (int i = 0; i < list->count; i++) {
+    if (!IS_NUMBER(list->as.values[i])) return false;
+  }
+
+  double *numbers = NULL;
+
+  if (list->capacity > 0) {
+    numbers = ALLOCATE(&vm->heap, MEMORY_LIST, double, list->capacity);
+
+    for (int i = 0; i < list->count; i++) {
+      numbers[i] = AS_NUMBER(list->as.values[i]);
+    }
+
+    FREE_ARRAY(&vm->heap, MEMORY_LIST, Value, list->as.values, list->capacity);
+  }
+
+  list->as.numbers = numbers;
+  list->numeric = true;
+
+  return true;
+}
+
+static void store(
+  VM *vm,
+  ObjList *list,
+  int index,
+  Value element
+) {
+  if (list->numeric) {
+    if (IS_NUMBER(element)) {
+      list->as.numbers[index] = AS_NUMBER(element);
+      return;
+    }
+
+    box(vm, list);
+  }
+
+  // the list keeps it, so it can't stay borrowed (see lines.h)
+  ownValue(vm, element);
+
+  list->as.values[index] = element;
+}
+
+void listAppend(
+  VM *vm,
+  ObjList *list,
+  Value element
+) {
+  if (list->count == list->capacity) growList(vm, list, GROW_CAPACITY(list->capacity));
+
+  store(vm, list, list->count++, element);
+}
+
+static ObjList *checkList(
+  VM *vm,
+  Value value,
+  const char *message
+) {
+  if (IS_LIST(value)) return AS_LIST(value);
+
+  runtimeError(vm, message);
+
+  return NULL;
+}
+
+static bool checkIndex(
+  VM *vm,
+  ObjList *list,
+  Value index,
+  int *slot
+) {
+  if (!IS_NUMBER(index)) {
+    runtimeError(vm, "List index must be a number.");
+    return false;
+  }
+
+  double number = AS_NUMBER(index);
+
+  if (
+    !(number >= 0 && number < list->count) ||
+    number != (int)number
+  ) {
+    runtimeError(vm, "List index out of range.");
+    return false;
+  }
+
+  *slot = (int)number;
+
+  return true;
+}
+
+bool listGet(
+  VM *vm,
+  Value value,
+  Value index,
+  Value *element
+) {
+  ObjList *list = checkList(vm, value, "Can only index lists.");
+  int slot;
+
+  if (
+    list == NULL ||
+    !checkIndex(vm, list, index, &slot)
+  ) {
+    return false;
+  }
+
+  *element = list->numeric ? NUMBER_VAL(list->as.numbers[slot]) : list->as.values[slot];
+
+  return true;
+}
+
+bool listSet(
+  VM *vm,
+  Value value,
+  Value index,
+  Value element
+) {
+  ObjList *list = checkList(vm, value, "Can only index lists.");
+  int slot;
+
+  if (
+    list == NULL ||
+    !checkIndex(vm, list, index, &slot)
+  ) {
+    return false;
+  }
+
+  store(vm, list, slot, element);
+
+  return true;
+}
+
+// kernels
+
+static double sumNumbers(
+  const double *x,
+  int count
+) {
+  int i = 0;
+  double total = 0;
+
+#ifdef LANES
+  // four independent sums, so one addition doesn't wait for the one before it
+  Vector a = VECTOR_ZERO();
+  Vector b = VECTOR_ZERO();
+  Vector c = VECTOR_ZERO();
+  Vector d = VECTOR_ZERO();
+
+  for (; i + 4 * LANES <= count; i += 4 * LANES) {
+    a = VECTOR_ADD(a, VECTOR_LOAD(x + i));
+    b = VECTOR_ADD(b, VECTOR_LOAD(x + i + LANES));
+    c = VECTOR_ADD(c, VECTOR_LOAD(x + i + 2 * LANES));
+    d = VECTOR_ADD(d, VECTOR_LOAD(x + i + 3 * LANES));
+  }
+
+  double lanes[LANES];
+
+  VECTOR_STORE(lanes, VECTOR_ADD(VECTOR_ADD(a, b), VECTOR_ADD(c, d)));
+
+  for (int lane = 0; lane < LANES; lane++) {
+    total += lanes[lane];
+  }
+#endif
+
+  for (; i < count; i++) {
+    total += x[i];
+  }
+
+  return total;
+}
+
+static double dotNumbers(
+  const double *x,
+  const double *y,
+  int count
+) {
+  int i = 0;
+  double total = 0;
+
+#ifdef LANES
+  Vector a = VECTOR_ZERO();
+  Vector b = VECTOR_ZERO();
+  Vector c = VECTOR_ZERO();
+  Vector d = VECTOR_ZERO();
+
+  for (; i + 4 * LANES <= count; i += 4 * LANES) {
+    a = VECTOR_ADD(a, VECTOR_MUL(VECTOR_LOAD(x + i), VECTOR_LOAD(y + i)));
+    b = VECTOR_ADD(b, VECTOR_MUL(VECTOR_LOAD(x + i + LANES), VECTOR_LOAD(y + i + LANES)));
+    c = VECTOR_ADD(c, VECTOR_MUL(VECTOR_LOAD(x + i + 2 * LANES), VECTOR_LOAD(y + i + 2 * LANES)));
+    d = VECTOR_ADD(d, VECTOR_MUL(VECTOR_LOAD(x + i + 3 * LANES), VECTOR_LOAD(y + i + 3 * LANES)));
+  }
+
+  double lanes[LANES];
+
+  VECTOR_STORE(lanes, VECTOR_ADD(VECTOR_ADD(a, b), VECTOR_ADD(c, d)));
+
+  for (int lane = 0; lane < LANES; lane++) {
+    total += lanes[lane];
+  }
+#endif
+
+  for (; i < count; i++) {
+    total += x[i] * y[i];
+  }
+
+  return total;
+}
+
+typedef enum {
+  MAP_ADD,
+  MAP_SUBTRACT,
+  MAP_MULTIPLY,
+  MAP_DIVIDE,
+  MAP_SQRT,
+  MAP_ABS,
+  MAP_NEGATE,
+} MapOp;
+
+static double mapOne(
+  MapOp op,
+  double x,
+  double operand
+) {
+  switch (op) {
+    case MAP_ADD: return x + operand;
+    case MAP_SUBTRACT: return x - operand;
+    case MAP_MULTIPLY: return x * operand;
+    case MAP_DIVIDE: return x / operand;
+    case MAP_SQRT: return sqrt(x);
+    case MAP_ABS: return fabs(x);
+    case MAP_NEGATE: return -x;
+  }
+
+  return x; // unreachable
+}
+
+static void mapNumbers(
+  MapOp op,
+  const double *x,
+  double *result,
+  int count,
+  double operand
+) {
+  int i = 0;
+
+#ifdef LANES
+  Vector right = VECTOR_SET(operand);
+  Vector sign = VECTOR_SET(-0.0);
+
+  for (; i + LANES <= count; i += LANES) {
+    Vector left = VECTOR_LOAD(x + i);
+    Vector value;
+
+    switch (op) {
+      case MAP_ADD: value = VECTOR_ADD(left, right); break;
+      case MAP_SUBTRACT: value = VECTOR_SUB(left, right); break;
+      case MAP_MULTIPLY: value = VECTOR_MUL(left, right); break;
+      case MAP_DIVIDE: value = VECTOR_DIV(left, right); break;
+      case MAP_SQRT: value = VECTOR_SQRT(left); break;
+      case MAP_ABS: value = VECTOR_ANDNOT(sign, left); break;
+      case MAP_NEGATE: value = VECTOR_XOR(left, sign); break;
+      default: value = left; break;
+    }
+
+    VECTOR_STORE(result + i, value);
+  }
+#endif
+
+  for (; i < count; i++) {
+    result[i] = mapOne(op, x[i], operand);
+  }
+}
+
+// doubles as unsigned keys in the same order: negative ones have every bit flipped (so bigger magnitudes come first), positive ones just the sign bit
+static inline uint64_t sortKey(double x) {
+  uint64_t bits;
+
+  memcpy(&bits, &x, sizeof(bits));
+
+  return bits & 0x8000000000000000ull ? ~bits : bits | 0x8000000000000000ull;
+}
+
+static inline double fromSortKey(uint64_t key) {
+  uint64_t bits = key & 0x8000000000000000ull ? key & ~0x8000000000000000ull : ~key;
+  double x;
+
+  memcpy(&x, &bits, sizeof(x));
+
+  return x;
+}
+
+static void insertionSort(
+  double *x,
+  int count
+) {
+  for (int i = 1; i < count; i++) {
+    double value = x[i];
+    uint64_t key = sortKey(value);
+    int j = i;
+
+    for (; j > 0 && sortKey(x[j - 1]) > key; j--) {
+      x[j] = x[j - 1];
+    }
+
+    x[j] = value;
+  }
+}
+
+// least significant digit first, every histogram counted in one pass up front, and a pass skipped when all keys have the same digit there (like the top bits of numbers of a similar size)
+// no comparisons at all, so there's nothing to mispredict, and the work is linear in the length
+static void radixSort(
+  VM *vm,
+  double *x,
+  int count
+) {
+  uint64_t *keys = ALLOCATE(&vm->heap, MEMORY_LIST, uint64_t, count);
+  uint64_t *other = ALLOCATE(&vm->heap, MEMORY_LIST, uint64_t, count);
+  uint32_t (*counts)[RADIX_BUCKETS] = calloc(RADIX_PASSES, sizeof(*counts));
+
+  if (counts == NULL) exit(1);
+
+  for (int i = 0; i < count; i++) {
+    uint64_t key = sortKey(x[i]);
+
+    keys[i] = key;
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+      counts[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  for (int pass = 0; pass < RADIX_PASSES; pass++) {
+    int shift = pass * RADIX_BITS;
+    uint32_t *buckets = counts[pass];
+
+    if (buckets[(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == (uint32_t)count) continue;
+
+    // counts into where each bucket starts
+    uint32_t offset = 0;
+
+    for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+      uint32_t size = buckets[bucket];
+
+      buckets[bucket] = offset;
+      offset += size;
+    }
+
+    for (int i = 0; i < count; i++) {
+      other[buckets[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++] = keys[i];
+    }
+
+    uint64_t *swap = keys;
+
+    keys = other;
+    other = swap;
+  }
+
+  for (int i = 0; i < count; i++) {
+    x[i] = fromSortKey(keys[i]);
+  }
+
+  free(counts);
+
+  FREE_ARRAY(&vm->heap, MEMORY_LIST, uint64_t, keys, count);
+  FREE_ARRAY(&vm->heap, MEMORY_LIST, uint64_t, other, count);
+}
+
+static int compareStrings(
+  const void *a,
+  const void *b
+) {
+  ObjString *x = AS_STRING(*(const Value *)a);
+  ObjString *y = AS_STRING(*(const Value *)b);
+  int length = x->length < y->length ? x->length : y->length;
+  int order = memcmp(x->chars, y->chars, length);
+
+  if (order != 0) return order;
+
+  return (x->length > y->length) - (x->length < y->length);
+}
+
+// natives
+
+// the list's doubles, for a native that only takes numbers
+static bool numbersOf(
+  VM *vm,
+  Value value,
+  const char *message,
+  double **numbers
+) {
+  if (
+    !IS_LIST(value) ||
+    !unbox(vm, AS_LIST(value))
+  ) {
+    runtimeError(vm, message);
+    return false;
+  }
+
+  *numbers = AS_LIST(value)->as.numbers;
+
+  return true;
+}
+
+bool appendNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  ObjList *list = checkList(vm, args[0], "Can only append to a list.");
+
+  if (list == NULL) return false;
+
+  listAppend(vm, list, args[1]);
+
+  args[-1] = args[0];
+
+  return true;
+}
+
+bool lengthNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (IS_MAP(args[0])) {
+    args[-1] = NUMBER_VAL(AS_MAP(args[0])->table.count);
+    return true;
+  }
+
+  if (IS_STRING(args[0])) {
+    args[-1] = NUMBER_VAL(AS_STRING(args[0])->length);
+    return true;
+  }
+
+  ObjList *list = checkList(vm, args[0], "Argument to length must be a list, a map or a string.");
+
+  if (list == NULL) return false;
+
+  args[-1] = NUMBER_VAL(list->count);
+
+  return true;
+}
+
+bool sumNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  double *numbers;
+
+  if (!numbersOf(
+    vm,
+    args[0],
+    "Can only sum a list of numbers.",
+    &numbers
+  )) {
+    return false;
+  }
+
+  args[-1] = NUMBER_VAL(sumNumbers(numbers, AS_LIST(args[0])->count));
+
+  return true;
+}
+
+bool dotNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  const char *message = "Arguments to dot must be lists of numbers.";
+  double *x;
+  double *y;
+
+  if (
+    !numbersOf(vm, args[0], message, &x) ||
+    !numbersOf(vm, args[1], message, &y)
+  ) {
+    return false;
+  }
+
+  int count = AS_LIST(args[0])->count;
+
+  if (AS_LIST(args[1])->count != count) {
+    runtimeError(vm, "Lists must have the same length.");
+    return false;
+  }
+
+  args[-1] = NUMBER_VAL(dotNumbers(x, y, count));
+
+  return true;
+}
+
+bool mapNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (
+    argCount < 2 ||
+    argCount > 3
+  ) {
+    runtimeError(vm, "Expected 2 or 3 arguments but got %d.", argCount);
+    return false;
+  }
+
+  double *numbers;
+
+  if (!numbersOf(
+    vm,
+    args[0],
+    "Can only map a list of numbers.",
+    &numbers
+  )) {
+    return false;
+  }
+
+  if (!IS_STRING(args[1])) {
+    runtimeError(vm, "Operation must be a string.");
+    return false;
+  }
+
+  static const struct {
+    const char *name;
+    MapOp op;
+    bool operand;
+  } ops[] = {
+    {"+", MAP_ADD, true},
+    {"-", MAP_SUBTRACT, true},
+    {"*", MAP_MULTIPLY, true},
+    {"/", MAP_DIVIDE, true},
+    {"sqrt", MAP_SQRT, false},
+    {"abs", MAP_ABS, false},
+    {"negate", MAP_NEGATE, false},
+  };
+
+  ObjString *name = AS_STRING(args[1]);
+  int found = -1;
+
+  for (int i = 0; i < (int)(sizeof(ops) / sizeof(ops[0])); i++) {
+    if (
+      strlen(ops[i].name) == (size_t)name->length &&
+      memcmp(ops[i].name, name->chars, name->length) == 0
+    ) {
+      found = i;
+      break;
+    }
+  }
+
+  if (found < 0) {
+    runtimeError(vm, "Unknown operation for map.");
+    return false;
+  }
+
+  if (ops[found].operand != (argCount == 3)) {
+    runtimeError(vm, ops[found].operand ? "Operation needs an operand." : "Operation takes no operand.");
+    return false;
+  }
+
+  if (
+    argCount == 3 &&
+    !IS_NUMBER(args[2])
+  ) {
+    runtimeError(vm, "Operand must be a number.");
+    return false;
+  }
+
+  int count = AS_LIST(args[0])->count;
+  ObjList *result = newList(vm);
+
+  if (count > 0) growList(vm, result, count);
+
+  result->count = count;
+
+  mapNumbers(ops[found].op, numbers, result->as.numbers, count, argCount == 3 ? AS_NUMBER(args[2]) : 0);
+
+  args[-1] = OBJ_VAL(result);
+
+  return true;
+}
+
+bool sortNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  ObjList *list = checkList(vm, args[0], "Can only sort a list.");
+
+  if (list == NULL) return false;
+
+  args[-1] = args[0];
+
+  if (unbox(vm, list)) {
+    if (list->count <= SORT_INSERTION_MAX) {
+      insertionSort(list->as.numbers, list->count);
+    } else {
+      radixSort(vm, list->as.numbers, list->count);
+    }
+
+    return true;
+  }
+
+  for (int i = 0; i < list->count; i++) {
+    if (!IS_STRING(list->as.values[i])) {
+      runtimeError(vm, "Can only sort a list of numbers or of strings.");
+      return false;
+    }
+  }
+
+  qsort(list->as.values, list->count, sizeof(Value), compareStrings);
+
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef clox_list_h
+#define clox_list_h
+
+#include "common.h"
+#include "object.h"
+#include "vm.h"
+
+// lists: `[a, b, c]`, `list[i]` and `list[i] = value` in the language, and natives for the rest
+//
+//   append(list, value)      adds to the end (amortized O(1)), returns the list
+//   length(list)             how many elements it has (or how many entries a map has, see map.h, or how many bytes a string has)
+//   sum(list)                the sum of a list of numbers
+//   dot(a, b)                the dot product of two lists of numbers of the same length
+//   map(list, op)            a new list, `op` applied to every number: "sqrt", "abs" or "negate"
+//   map(list, op, operand)   the same with an operand: "+", "-", "*" or "/" (the element on the left)
+//   sort(list)               sorts a list of numbers, or one of strings, in place, returns the list
+//
+// the numeric natives work on the unboxed doubles (see `ObjList`) with simd, several accumulators at a time, so a sum can round differently than adding the elements up one by one would
+// a list that was boxed but holds only numbers again is unboxed by the first numeric native that looks at it
+
+bool listGet(VM *vm, Value list, Value index, Value *element);
+bool listSet(VM *vm, Value list, Value index, Value element);
+void listAppend(VM *vm, ObjList *list, Value element);
+
+bool appendNative(VM *vm, int argCount, Value *args);
+bool lengthNative(VM *vm, int argCount, Value *args);
+bool sumNative(VM *vm, int argCount, Value *args);
+bool dotNative(VM *vm, int argCount, Value *args);
+bool mapNative(VM *vm, int argCount, Value *args);
+bool sortNative(VM *vm, int argCount, Value *args);
+
+#endif
\ No newline at end of file
@@ -3,11 +3,15 @@
 #include <string.h>
 
 #include "common.h"
+#include "batch.h"
 #include "chunk.h"
 #include "debug.h"
+#include "server.h"
+#include "shared.h"
+#include "source.h"
 #include "vm.h"
 
-static void repl() {
+static void repl(VM *vm) {
   char line[1024];
 
   for (;;) {
@@ -18,77 +22,143 @@ static void repl() {
       break;
     }
 
-    interpret(line);
+    interpret(vm, line);
   }
 }
 
-static char *readFile(const char *path) {
-  FILE *file = fopen(path, "rb");
+// the script's strings borrow from the mapping, so it's the caller's to unmap, once the vm is gone
+static Source runFile(
+  VM *vm,
+  const char *path
+) {
+  Source source;
 
-  if (file == NULL) {
+  if (!mapSource(&source, path)) {
     fprintf(stderr, "could not open file \"%s\"\n", path);
     exit(74);
   }
 
-  fseek(file, 0L, SEEK_END);
-
-  size_t fileSize = ftell(file);
+  vm->borrowSource = true;
 
-  rewind(file);
+  InterpretResult result = interpret(vm, source.chars);
 
-  char *buffer = (char *)malloc(fileSize + 1);
+  if (result == INTERPRET_COMPILE_ERROR) exit(65);
+  if (result == INTERPRET_RUNTIME_ERROR) exit(70);
 
-  if (buffer == NULL) {
-    fprintf(stderr, "not enough memory to read \"%s\"\n", path);
-    exit(74);
-  }
+  return source;
+}
 
-  size_t bytesRead = fread(
-    buffer,
-    sizeof(char),
-    fileSize,
-    file
-  );
+int main(
+  int argc,
+  const char *argv[]
+) {
+  bool regions = false;
+  bool sharedStrings = false;
+  bool batch = false;
+  const char *socketPath = NULL;
+  int jobs = 0;
+  long slice = 0;
+  size_t heapLimit = 0;
+
+  // --regions: allocate from big regions that are dropped all at once at exit (for one-off script runs)
+  // --batch: run every script given (directly, in a directory or in a list file) in parallel and print a report instead of their output (see batch.h)
+  // --shared-strings: the vms of a batch or server share one intern table for identifiers and literals (see shared.h)
+  // --serve socket: keep a pool of warm vms and run the scripts clients send over a unix domain socket (see server.h)
+  // --jobs n: how many scripts a batch or server runs at once, one per core by default
+  // --slice n: the scripts of a batch take turns on the workers, n bytes of bytecode at a time, instead of each one running to the end (see scheduler.h)
+  // --heap-limit mb: a script that needs more heap than that stops with a runtime error (every vm of a batch or server has a limit of its own)
+  while (
+    argc > 1 &&
+    strncmp(argv[1], "--", 2) == 0
+  ) {
+    if (strcmp(argv[1], "--regions") == 0) {
+      regions = true;
+    } else if (strcmp(argv[1], "--shared-strings") == 0) {
+      sharedStrings = true;
+    } else if (strcmp(argv[1], "--batch") == 0) {
+      batch = true;
+    } else if (
+      strcmp(argv[1], "--serve") == 0 &&
+      argc > 2
+    ) {
+      socketPath = argv[2];
+
+      argc--;
+      argv++;
+    } else if (
+      strcmp(argv[1], "--jobs") == 0 &&
+      argc > 2
+    ) {
+      jobs = atoi(argv[2]);
+
+      argc--;
+      argv++;
+    } else if (
+      strcmp(argv[1], "--slice") == 0 &&
+      argc > 2
+    ) {
+      slice = atol(argv[2]);
+
+      argc--;
+      argv++;
+    } else if (
+      strcmp(argv[1], "--heap-limit") == 0 &&
+      argc > 2
+    ) {
+      heapLimit = (size_t)atol(argv[2]) * 1024 * 1024;
+
+      argc--;
+      argv++;
+    } else {
+      break;
+    }
 
-  if (buffer == NULL) {
-    fprintf(stderr, "could not read file \"%s\"\n", path);
-    exit(74);
+    argc--;
+    argv++;
   }
 
-  buffer[bytesRead] = '\0';
+  SharedStrings shared;
 
-  fclose(file);
+  if (sharedStrings) initSharedStrings(&shared);
 
-  return buffer;
-}
+  if (socketPath != NULL) return runServer(socketPath, jobs, regions, heapLimit, sharedStrings ? &shared : NULL);
 
-static void runFile(const char *path) {
-  char *source = readFile(path);
+  if (batch) {
+    if (argc == 1) {
+      fprintf(stderr, "usage: clox [--regions] [--shared-strings] [--jobs n] [--slice n] [--heap-limit mb] --batch path...\n");
+      return 64;
+    }
 
-  InterpretResult result = interpret(source);
+    int status = runBatch(argc - 1, argv + 1, jobs, slice, regions, heapLimit, sharedStrings ? &shared : NULL);
 
-  free(source);
+    if (sharedStrings) freeSharedStrings(&shared);
 
-  if (result == INTERPRET_COMPILE_ERROR) exit(65);
-  if (result == INTERPRET_RUNTIME_ERROR) exit(70);
-}
+    return status;
+  }
 
-int main(
-  int argc,
-  const char *argv[]
-) {
+  VM vm;
 
-  initVM();
+  initVM(&vm);
+
+  vm.heap.regions = regions;
+  vm.heap.limit = heapLimit;
 
   if (argc == 1) {
-    repl();
+    repl(&vm);
   } else if (argc == 2) {
-    runFile(argv[1]);
+    Source source = runFile(&vm, argv[1]);
+
+    freeVM(&vm);
+    unmapSource(&source);
+
+    return 0;
   } else {
-    fprintf(stderr, "usage: clox [path]\n");
+    fprintf(stderr, "usage: clox [--regions] [--heap-limit mb] [path]\n");
+    fprintf(stderr, "       clox [--regions] [--shared-strings] [--jobs n] [--slice n] [--heap-limit mb] --batch path...\n");
+    fprintf(stderr, "       clox [--regions] [--shared-strings] [--jobs n] [--heap-limit mb] --serve socket\n");
   }
 
-  freeVM();
+  freeVM(&vm);
 
   return 0;
 }
\ No newline at end of file
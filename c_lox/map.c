@@ -0,0 +1,222 @@
+#include <math.h>
+
+#include "intern.h"
+#include "list.h"
+#include "map.h"
+
+// what `reserve` takes at most, a table that big is already gigabytes
+#define MAP_RESERVE_MAX 100000000
+
+static bool checkKey(
+  VM *vm,
+  Value key
+) {
+  if (
+    IS_STRING(key) ||
+    IS_BOOL(key) ||
+    IS_NIL(key) ||
+    (IS_NUMBER(key) && !isnan(AS_NUMBER(key)))
+  ) {
+    return true;
+  }
+
+  runtimeError(vm, IS_NUMBER(key) ? "Map key can't be NaN." : "Map key must be a string, number, boolean or nil.");
+
+  return false;
+}
+
+// the key as the table knows it, for looking it up
+// a string that was never interned can't be in any table, so this doesn't intern it (a lookup of a missing key shouldn't grow the intern set), `found` is false then
+static Value lookupKey(
+  VM *vm,
+  Value key,
+  bool *found
+) {
+  *found = true;
+
+  if (!IS_STRING(key)) return key;
+
+  ObjString *string = AS_STRING(key);
+
+  if (string->obj.flags & OBJ_INTERNED) return key;
+
+  string = internSetFind(&vm->strings, string->chars, string->length, stringHash(string));
+
+  *found = string != NULL;
+
+  return OBJ_VAL(string);
+}
+
+bool mapGet(
+  VM *vm,
+  ObjMap *map,
+  Value key,
+  Value *value
+) {
+  if (!checkKey(vm, key)) return false;
+
+  bool found;
+
+  key = lookupKey(vm, key, &found);
+
+  if (
+    !found ||
+    !tableGetValue(&map->table, key, value)
+  ) {
+    *value = NIL_VAL;
+  }
+
+  return true;
+}
+
+bool mapSet(
+  VM *vm,
+  ObjMap *map,
+  Value key,
+  Value value
+) {
+  if (!checkKey(vm, key)) return false;
+
+  // the map keeps both, so neither can stay borrowed (see lines.h)
+  if (IS_STRING(key)) key = OBJ_VAL(internString(vm, AS_STRING(key)));
+
+  ownValue(vm, value);
+
+  tableSetValue(&map->table, key, value);
+
+  return true;
+}
+
+static ObjMap *checkMap(
+  VM *vm,
+  Value value,
+  const char *name
+) {
+  if (IS_MAP(value)) return AS_MAP(value);
+
+  runtimeError(vm, "First argument to %s must be a map.", name);
+
+  return NULL;
+}
+
+bool hasNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  ObjMap *map = checkMap(vm, args[0], "has");
+
+  if (
+    map == NULL ||
+    !checkKey(vm, args[1])
+  ) {
+    return false;
+  }
+
+  bool found;
+  Value key = lookupKey(vm, args[1], &found);
+  Value value;
+
+  args[-1] = BOOL_VAL(found && tableGetValue(&map->table, key, &value));
+
+  return true;
+}
+
+bool removeNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  ObjMap *map = checkMap(vm, args[0], "remove");
+
+  if (
+    map == NULL ||
+    !checkKey(vm, args[1])
+  ) {
+    return false;
+  }
+
+  bool found;
+  Value key = lookupKey(vm, args[1], &found);
+
+  args[-1] = BOOL_VAL(found && tableDeleteValue(&map->table, key));
+
+  return true;
+}
+
+// every key, or every value, into a new list
+static bool entries(
+  VM *vm,
+  int argCount,
+  Value *args,
+  const char *name,
+  bool keys
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  ObjMap *map = checkMap(vm, args[0], name);
+
+  if (map == NULL) return false;
+
+  ObjList *list = newList(vm);
+  int cursor = 0;
+  Entry *entry;
+
+  while (tableNext(&map->table, &cursor, &entry)) {
+    listAppend(vm, list, keys ? entry->key : entry->value);
+  }
+
+  args[-1] = OBJ_VAL(list);
+
+  return true;
+}
+
+bool keysNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  return entries(vm, argCount, args, "keys", true);
+}
+
+bool valuesNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  return entries(vm, argCount, args, "values", false);
+}
+
+bool reserveNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  ObjMap *map = checkMap(vm, args[0], "reserve");
+
+  if (map == NULL) return false;
+
+  if (
+    !IS_NUMBER(args[1]) ||
+    !(AS_NUMBER(args[1]) >= 0 && AS_NUMBER(args[1]) <= MAP_RESERVE_MAX)
+  ) {
+    runtimeError(vm, "Count to reserve must be a number between 0 and %d.", MAP_RESERVE_MAX);
+    return false;
+  }
+
+  // refused before anything's allocated, a big count would otherwise take the heap past its limit by gigabytes
+  if (!tableReserve(&map->table, (int)AS_NUMBER(args[1]))) {
+    runtimeError(vm, "Out of memory.");
+    return false;
+  }
+
+  args[-1] = args[0];
+
+  return true;
+}
\ No newline at end of file
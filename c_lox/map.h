@@ -0,0 +1,29 @@
+#ifndef clox_map_h
+#define clox_map_h
+
+#include "common.h"
+#include "object.h"
+#include "vm.h"
+
+// maps: `{key: value}`, `map[key]` and `map[key] = value` in the language, and natives for the rest
+// keys are strings, numbers (not NaN, and -0 is the same key as 0), booleans or nil, a key that isn't there reads as nil
+//
+//   has(map, key)            whether the key is there
+//   remove(map, key)         takes the key out, returns whether it was there
+//   keys(map)                a list of the keys, in no particular order
+//   values(map)              a list of the values, in the same order as `keys` (as long as the map doesn't change in between)
+//   reserve(map, count)      makes room for `count` entries in all, so a bulk load doesn't grow the table again and again, returns the map
+//   length(map)              how many entries it has (see list.h)
+//
+// iterating is `keys` and a loop over the list, which is a copy, so the loop can change the map
+
+bool mapGet(VM *vm, ObjMap *map, Value key, Value *value);
+bool mapSet(VM *vm, ObjMap *map, Value key, Value value);
+
+bool hasNative(VM *vm, int argCount, Value *args);
+bool removeNative(VM *vm, int argCount, Value *args);
+bool keysNative(VM *vm, int argCount, Value *args);
+bool valuesNative(VM *vm, int argCount, Value *args);
+bool reserveNative(VM *vm, int argCount, Value *args);
+
+#endif
\ No newline at end of file
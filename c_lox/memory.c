@@ -1,9 +1,184 @@
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "memory.h"
-#include "vm.h"
 
-void *reallocate(
+#ifndef SYSTEM_ALLOCATOR
+
+// small blocks (object headers, short strings, small arrays) come from segregated free lists, one per size class, instead of from malloc
+// freeing pushes a block onto the free list of its class, allocating pops one off, and when a list runs dry the class carves fresh blocks out of a big slab
+// this only works because every caller tells `reallocate` the old size of the block (the macros above all do), which is how we know the class of a block without storing a header
+
+#define POOL_SLAB_SIZE (64 * 1024)
+
+#define SIZE_CLASS(size) (((size) + POOL_GRANULARITY - 1) / POOL_GRANULARITY - 1)
+#define CLASS_SIZE(sizeClass) (((sizeClass) + 1) * POOL_GRANULARITY)
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+// heap->slabs are chained through a header at their start, so they can all be released at once
+// the header is padded to the granularity to keep the blocks after it aligned
+union Slab {
+  Slab *next;
+  char padding[POOL_GRANULARITY];
+};
+
+static void *poolAllocate(
+  Heap *heap,
+  size_t size
+) {
+  int sizeClass = SIZE_CLASS(size);
+  SizeClass *pool = &heap->sizeClasses[sizeClass];
+
+  FreeBlock *block = pool->freeList;
+
+  if (block != NULL) {
+    pool->freeList = block->next;
+    return block;
+  }
+
+  size_t blockSize = CLASS_SIZE(sizeClass);
+
+  if (pool->slabNext + blockSize > pool->slabEnd) {
+    Slab *slab = (Slab *)malloc(POOL_SLAB_SIZE);
+
+    if (slab == NULL) exit(1); // allocation failed
+
+    slab->next = heap->slabs;
+    heap->slabs = slab;
+
+    pool->slabNext = (char *)(slab + 1);
+    pool->slabEnd = (char *)slab + POOL_SLAB_SIZE;
+  }
+
+  void *result = pool->slabNext;
+
+  pool->slabNext += blockSize;
+
+  return result;
+}
+
+static void poolFree(
+  Heap *heap,
+  void *pointer,
+  size_t size
+) {
+  SizeClass *pool = &heap->sizeClasses[SIZE_CLASS(size)];
+  FreeBlock *block = (FreeBlock *)pointer;
+
+  block->next = pool->freeList;
+  pool->freeList = block;
+}
+
+static void *heapReallocate(
+  Heap *heap,
+  void *pointer,
+  size_t oldSize,
+  size_t newSize
+) {
+  bool oldSmall = pointer != NULL && oldSize <= POOL_MAX_SIZE;
+  bool newSmall = newSize <= POOL_MAX_SIZE;
+
+  if (newSize == 0) {
+    if (oldSmall) {
+      poolFree(heap, pointer, oldSize);
+    } else {
+      free(pointer);
+    }
+
+    return NULL;
+  }
+
+  // big to big is a plain realloc
+  if (
+    !newSmall &&
+    (pointer == NULL || !oldSmall)
+  ) {
+    void *result = realloc(pointer, newSize);
+
+    if (result == NULL) exit(1); // allocation failed
+
+    return result;
+  }
+
+  // growing or shrinking within the same size class doesn't need to move
+  if (
+    oldSmall &&
+    newSmall &&
+    SIZE_CLASS(oldSize) == SIZE_CLASS(newSize)
+  ) {
+    return pointer;
+  }
+
+  // moving between the pools and malloc, or between size classes
+  void *result = newSmall ? poolAllocate(heap, newSize) : malloc(newSize);
+
+  if (result == NULL) exit(1); // allocation failed
+
+  if (pointer != NULL) {
+    memcpy(
+      result,
+      pointer,
+      oldSize < newSize ? oldSize : newSize
+    );
+
+    heapReallocate(heap, pointer, oldSize, 0);
+  }
+
+  return result;
+}
+
+static void *heapAllocateZeroed(
+  Heap *heap,
+  size_t size
+) {
+  // small blocks have to come from the pools too, otherwise freeing them later would put a malloc'd block on a free list
+  if (size <= POOL_MAX_SIZE) {
+    void *result = poolAllocate(heap, size);
+
+    memset(result, 0, size);
+
+    return result;
+  }
+
+  void *result = calloc(1, size);
+
+  if (result == NULL) exit(1); // allocation failed
+
+  return result;
+}
+
+// hand every slab back to the system
+// anything still allocated from the pools is gone after this, so it's the very last thing the vm does
+void freePools(Heap *heap) {
+  while (heap->slabs != NULL) {
+    Slab *next = heap->slabs->next;
+
+    free(heap->slabs);
+
+    heap->slabs = next;
+  }
+
+  for (
+    int i = 0;
+    i < POOL_CLASS_COUNT;
+    i++
+  ) {
+    heap->sizeClasses[i].freeList = NULL;
+    heap->sizeClasses[i].slabNext = NULL;
+    heap->sizeClasses[i].slabEnd = NULL;
+  }
+}
+
+#else
+
+// every allocation goes straight to the system, for comparison
+
+static void *heapReallocate(
+  Heap *heap,
   void *pointer,
   size_t oldSize,
   size_t newSize
@@ -20,32 +195,424 @@ void *reallocate(
   return result;
 }
 
-static void freeObject(Obj *object) {
+static void *heapAllocateZeroed(
+  Heap *heap,
+  size_t size
+) {
+  void *result = calloc(1, size);
+
+  if (result == NULL) exit(1); // allocation failed
+
+  return result;
+}
+
+void freePools(Heap *heap) {
+  // nothing to do
+}
+
+#endif
+
+// regions
+
+#define REGION_SIZE (4 * 1024 * 1024)
+
+// anything bigger than this gets a mapping of its own, so a region doesn't end up mostly wasted
+#define REGION_MAX_BLOCK (REGION_SIZE / 4)
+
+#define REGION_ALIGNMENT 16
+#define REGION_ALIGN(size) (((size) + REGION_ALIGNMENT - 1) & ~(size_t)(REGION_ALIGNMENT - 1))
+
+// regions are chained through a header at their start, padded to keep the blocks after it aligned
+union Region {
+  struct {
+    Region *next;
+    size_t size;
+  } header;
+
+  char padding[2 * REGION_ALIGNMENT];
+};
+
+static Region *mapRegion(
+  Heap *heap,
+  size_t size
+) {
+  Region *region = (Region *)mmap(
+    NULL,
+    size,
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS,
+    -1,
+    0
+  );
+
+  if (region == MAP_FAILED) exit(1); // allocation failed
+
+  region->header.next = heap->regionList;
+  region->header.size = size;
+
+  heap->regionList = region;
+
+  return region;
+}
+
+// fresh mappings are zero-filled, so big blocks (which always get one) come back zeroed
+static void *regionAllocate(
+  Heap *heap,
+  size_t size
+) {
+  size = REGION_ALIGN(size);
+
+  if (size > REGION_MAX_BLOCK) return mapRegion(heap, sizeof(Region) + size) + 1;
+
+  if (
+    heap->regionNext == NULL ||
+    size > (size_t)(heap->regionEnd - heap->regionNext)
+  ) {
+    Region *region = mapRegion(heap, REGION_SIZE);
+
+    heap->regionNext = (char *)(region + 1);
+    heap->regionEnd = (char *)region + REGION_SIZE;
+  }
+
+  void *result = heap->regionNext;
+
+  heap->regionNext += size;
+
+  return result;
+}
+
+static void *regionReallocate(
+  Heap *heap,
+  void *pointer,
+  size_t oldSize,
+  size_t newSize
+) {
+  // the most recent block can grow or shrink in place
+  if (
+    pointer != NULL &&
+    (char *)pointer + REGION_ALIGN(oldSize) == heap->regionNext
+  ) {
+    if (newSize == 0) {
+      heap->regionNext = (char *)pointer;
+      return NULL;
+    }
+
+    if (REGION_ALIGN(newSize) <= (size_t)(heap->regionEnd - (char *)pointer)) {
+      heap->regionNext = (char *)pointer + REGION_ALIGN(newSize);
+      return pointer;
+    }
+  }
+
+  // everything else stays where it is until the regions go
+  if (pointer != NULL) heap->regionWaste += oldSize;
+
+  if (newSize == 0) return NULL;
+
+  void *result = regionAllocate(heap, newSize);
+
+  if (pointer != NULL) {
+    memcpy(
+      result,
+      pointer,
+      oldSize < newSize ? oldSize : newSize
+    );
+  }
+
+  return result;
+}
+
+// unmap every region, and with them everything the vm has allocated
+void freeRegions(Heap *heap) {
+  while (heap->regionList != NULL) {
+    Region *next = heap->regionList->header.next;
+
+    munmap(heap->regionList, heap->regionList->header.size);
+
+    heap->regionList = next;
+  }
+
+  heap->regionNext = NULL;
+  heap->regionEnd = NULL;
+
+  // the object pages were in there too
+  for (
+    int i = 0;
+    i < OBJECT_CLASS_COUNT;
+    i++
+  ) {
+    heap->objectPages[i] = NULL;
+  }
+
+  for (
+    int i = 0;
+    i < MEMORY_CATEGORY_COUNT;
+    i++
+  ) {
+    heap->bytes[i] = 0;
+  }
+
+  heap->current = 0;
+  heap->regionWaste = 0;
+}
+
+// empty, with no limit and regions off
+void initHeap(Heap *heap) {
+  memset(heap, 0, sizeof(Heap));
+}
+
+// memory the vm needs for itself (pages of objects), that isn't counted in any category
+static void *untrackedReallocate(
+  Heap *heap,
+  void *pointer,
+  size_t oldSize,
+  size_t newSize
+) {
+  if (heap->regions) return regionReallocate(heap, pointer, oldSize, newSize);
+
+  return heapReallocate(heap, pointer, oldSize, newSize);
+}
+
+// every allocation of the vm goes through here, so this is where its heap gets counted
+void trackMemory(
+  Heap *heap,
+  MemoryCategory category,
+  size_t oldSize,
+  size_t newSize
+) {
+  heap->bytes[category] += newSize - oldSize;
+  heap->current += newSize - oldSize;
+
+  if (heap->current > heap->peak) heap->peak = heap->current;
+
+  if (
+    heap->limit != 0 &&
+    heap->current + heap->regionWaste > heap->limit
+  ) {
+    heap->exhausted = true;
+  }
+}
+
+// whether `size` more bytes fit under the limit, checked before an allocation instead of after it
+// if they don't the heap is exhausted all the same, without having allocated anything
+bool heapHasRoom(
+  Heap *heap,
+  size_t size
+) {
+  if (heap->limit == 0) return true;
+
+  size_t used = heap->current + heap->regionWaste;
+
+  // the heap may be over already (by the allocation that hasn't been turned into an error yet)
+  if (
+    used <= heap->limit &&
+    size <= heap->limit - used
+  ) {
+    return true;
+  }
+
+  heap->exhausted = true;
+
+  return false;
+}
+
+void *reallocate(
+  Heap *heap,
+  MemoryCategory category,
+  void *pointer,
+  size_t oldSize,
+  size_t newSize
+) {
+  void *result = untrackedReallocate(heap, pointer, oldSize, newSize);
+
+  // after the fact, so a block this left behind in a region already counts when the limit is checked
+  trackMemory(heap, category, oldSize, newSize);
+
+  return result;
+}
+
+void *allocateZeroed(
+  Heap *heap,
+  MemoryCategory category,
+  size_t size
+) {
+  trackMemory(heap, category, 0, size);
+
+  if (heap->regions) {
+    void *result = regionAllocate(heap, size);
+
+    // small blocks may reuse space that was given back by shrinking, big ones are fresh pages
+    if (size <= REGION_MAX_BLOCK) memset(result, 0, size);
+
+    return result;
+  }
+
+  return heapAllocateZeroed(heap, size);
+}
+
+// object pages
+
+#define OBJECT_PAGE_SIZE (64 * 1024)
+
+#define OBJECT_CLASS(size) (((size) + OBJECT_GRANULARITY - 1) / OBJECT_GRANULARITY - 1)
+#define OBJECT_CLASS_SIZE(objectClass) (((objectClass) + 1) * OBJECT_GRANULARITY)
+
+// padded to the granularity to keep the slots after it aligned
+struct ObjectPage {
+  union {
+    struct {
+      ObjectPage *next;
+      int slotSize;
+      int carved; // slots before this index are in use, the rest of the page is still free
+    } header;
+
+    char padding[OBJECT_GRANULARITY];
+  } as;
+};
+
+// every object type has to fit in a size class (natives are static, they're never allocated)
+_Static_assert(sizeof(ObjString) <= OBJECT_MAX_SIZE, "ObjString doesn't fit in an object slot");
+_Static_assert(sizeof(ObjActor) <= OBJECT_MAX_SIZE, "ObjActor doesn't fit in an object slot");
+_Static_assert(sizeof(ObjCoroutine) <= OBJECT_MAX_SIZE, "ObjCoroutine doesn't fit in an object slot");
+_Static_assert(sizeof(ObjHandle) <= OBJECT_MAX_SIZE, "ObjHandle doesn't fit in an object slot");
+_Static_assert(sizeof(ObjLines) <= OBJECT_MAX_SIZE, "ObjLines doesn't fit in an object slot");
+_Static_assert(sizeof(ObjList) <= OBJECT_MAX_SIZE, "ObjList doesn't fit in an object slot");
+_Static_assert(sizeof(ObjMap) <= OBJECT_MAX_SIZE, "ObjMap doesn't fit in an object slot");
+
+#define PAGE_SLOT(page, index) ((Obj *)((char *)((page) + 1) + (size_t)(index) * (page)->as.header.slotSize))
+#define PAGE_SLOT_COUNT(slotSize) ((int)((OBJECT_PAGE_SIZE - sizeof(ObjectPage)) / (slotSize)))
+
+// objects are never freed one at a time yet (there's no collector), so slots are only ever carved off the end of a page
+Obj *allocateObjectSlot(
+  Heap *heap,
+  size_t size
+) {
+  int objectClass = OBJECT_CLASS(size);
+  int slotSize = OBJECT_CLASS_SIZE(objectClass);
+
+  ObjectPage *page = heap->objectPages[objectClass];
+
+  if (
+    page == NULL ||
+    page->as.header.carved == PAGE_SLOT_COUNT(slotSize)
+  ) {
+    page = (ObjectPage *)untrackedReallocate(heap, NULL, 0, OBJECT_PAGE_SIZE);
+
+    page->as.header.next = heap->objectPages[objectClass];
+    page->as.header.slotSize = slotSize;
+    page->as.header.carved = 0;
+
+    heap->objectPages[objectClass] = page;
+  }
+
+  return PAGE_SLOT(page, page->as.header.carved++);
+}
+
+// release whatever an object owns, the slot itself goes along with its page
+static void freeObject(
+  Heap *heap,
+  Obj *object
+) {
   switch (object->type) {
     case OBJ_STRING: {
       ObjString *string = (ObjString *)object;
 
+      if (!(string->obj.flags & (OBJ_BORROWED | OBJ_VIEW))) {
+        FREE_ARRAY(
+          heap,
+          MEMORY_STRING_CHARS,
+          char,
+          string->chars,
+          string->length + 1
+        );
+      }
+
+      trackMemory(heap, OBJECT_MEMORY(OBJ_STRING), sizeof(ObjString), 0);
+      
+      break;
+    }
+
+    // natives are never on a page
+
+    case OBJ_ACTOR:
+      // the actor itself isn't the handle's to free
+      trackMemory(heap, OBJECT_MEMORY(OBJ_ACTOR), sizeof(ObjActor), 0);
+      break;
+
+    case OBJ_COROUTINE: {
+      Fiber *fiber = &((ObjCoroutine *)object)->fiber;
+
       FREE_ARRAY(
-        char,
-        string->chars,
-        string->length + 1
+        heap,
+        MEMORY_STACK,
+        Value,
+        fiber->stack,
+        fiber->stackEnd - fiber->stack
       );
 
-      FREE(ObjString, object);
-      
+      trackMemory(heap, OBJECT_MEMORY(OBJ_COROUTINE), sizeof(ObjCoroutine), 0);
+
+      break;
+    }
+
+    case OBJ_HANDLE:
+      // its fd is closed by the event loop, which keeps track of every handle (see `freeEventLoop`)
+      trackMemory(heap, OBJECT_MEMORY(OBJ_HANDLE), sizeof(ObjHandle), 0);
+      break;
+
+    case OBJ_LINES:
+      // unmapped by `freeLines`, like handles
+      trackMemory(heap, OBJECT_MEMORY(OBJ_LINES), sizeof(ObjLines), 0);
+      break;
+
+    case OBJ_LIST: {
+      ObjList *list = (ObjList *)object;
+
+      if (list->numeric) {
+        FREE_ARRAY(heap, MEMORY_LIST, double, list->as.numbers, list->capacity);
+      } else {
+        FREE_ARRAY(heap, MEMORY_LIST, Value, list->as.values, list->capacity);
+      }
+
+      trackMemory(heap, OBJECT_MEMORY(OBJ_LIST), sizeof(ObjList), 0);
+
+      break;
+    }
+
+    case OBJ_MAP: {
+      freeTable(&((ObjMap *)object)->table);
+
+      trackMemory(heap, OBJECT_MEMORY(OBJ_MAP), sizeof(ObjMap), 0);
+
       break;
     }
   }
 }
 
-void freeObjects() {
-  Obj *object = vm.objects;
+// walk every page in order, then drop the pages
+void freeObjects(Heap *heap) {
+  for (
+    int i = 0;
+    i < OBJECT_CLASS_COUNT;
+    i++
+  ) {
+    ObjectPage *page = heap->objectPages[i];
 
-  while (object != NULL) {
-    Obj *next = object->next;
+    while (page != NULL) {
+      ObjectPage *next = page->as.header.next;
 
-    freeObject(object);
+      for (
+        int slot = 0;
+        slot < page->as.header.carved;
+        slot++
+      ) {
+        freeObject(heap, PAGE_SLOT(page, slot));
+      }
+
+      untrackedReallocate(heap, page, OBJECT_PAGE_SIZE, 0);
+
+      page = next;
+    }
 
-    object = next;
+    heap->objectPages[i] = NULL;
   }
 }
\ No newline at end of file
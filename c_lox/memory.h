@@ -4,26 +4,129 @@
 #include "common.h"
 #include "object.h"
 
-#define ALLOCATE(type, count) \
-  (type *)reallocate(NULL, 0, sizeof(type) * (count))
+// what an allocation is for, so the vm can report where its memory goes
+typedef enum {
+  // the objects themselves, one category per `ObjType` (in the same order, see `OBJECT_MEMORY`)
+  MEMORY_OBJ_STRING,
+  MEMORY_OBJ_NATIVE, // always 0, natives are static
+  MEMORY_OBJ_ACTOR,
+  MEMORY_OBJ_COROUTINE,
+  MEMORY_OBJ_HANDLE,
+  MEMORY_OBJ_LINES,
+  MEMORY_OBJ_LIST,
+  MEMORY_OBJ_MAP,
 
-#define FREE(type, pointer) reallocate(pointer, sizeof(type), 0)
+  MEMORY_STRING_CHARS, // the characters of string objects
+  MEMORY_CHUNK, // bytecode, line info and constants
+  MEMORY_STACK, // value stacks, the main script's and the coroutines'
+  MEMORY_LIST, // the elements of lists
+  MEMORY_COMPILER, // the compiler's scratch arena
+  MEMORY_TABLE, // hash tables (globals, maps)
+  MEMORY_STRINGS, // the intern set
+  MEMORY_OTHER, // anything else (e.g. the host's own arrays)
+
+  MEMORY_CATEGORY_COUNT
+} MemoryCategory;
+
+#define OBJECT_MEMORY(type) ((MemoryCategory)(MEMORY_OBJ_STRING + (type)))
+
+// small blocks (object headers, short strings, small arrays) come from segregated free lists, one per size class, instead of from malloc (see memory.c)
+#define POOL_GRANULARITY 16
+#define POOL_MAX_SIZE 256
+#define POOL_CLASS_COUNT (POOL_MAX_SIZE / POOL_GRANULARITY)
+
+typedef struct FreeBlock FreeBlock;
+typedef union Slab Slab;
+typedef union Region Region;
+
+typedef struct {
+  FreeBlock *freeList;
+
+  // the part of the class's current slab that hasn't been handed out yet
+  char *slabNext;
+  char *slabEnd;
+} SizeClass;
+
+// objects are segregated by size: each size class has its own pages, and a page holds nothing but slots of that size
+// that keeps headers free of list pointers, and going over every object (teardown, or a collector's sweep) is a linear scan of a few pages instead of a pointer chase across the heap
+#define OBJECT_GRANULARITY 8
+#define OBJECT_MAX_SIZE 128
+#define OBJECT_CLASS_COUNT (OBJECT_MAX_SIZE / OBJECT_GRANULARITY)
+
+typedef struct ObjectPage ObjectPage;
+
+// everything a vm allocates comes from its own heap, so vms on different threads never share allocator state (and need no locks)
+struct Heap {
+  // byte counts, as asked for by the callers of `reallocate` (not including what the pools or malloc round up to)
+  size_t bytes[MEMORY_CATEGORY_COUNT];
+  size_t current; // sum of the above
+  size_t peak;
+
+  // 0 for no limit
+  // going over it doesn't fail the allocation that did so, it sets `exhausted`, and the vm turns that into a runtime error at the next safe point
+  // that lets the heap overshoot by one allocation, so whatever makes a big one the script asked for asks `heapHasRoom` first instead (see `tableReserve`)
+  size_t limit;
+  bool exhausted;
+
+  // region mode: everything comes out of a few big mappings, freeing single blocks does nothing, and `freeVM` just unmaps the regions instead of freeing every object
+  // meant for running one script and exiting, has to be switched on right after `initVM` (before anything is allocated)
+  bool regions;
+
+  // region mode: every region, and the free space left in the current one
+  Region *regionList;
+  char *regionNext;
+  char *regionEnd;
+
+  // region mode: bytes that have been freed (or left behind by a block that moved) but stay mapped until the regions go
+  // they're out of `current`, but still count against the limit
+  size_t regionWaste;
+
+  // the pools
+  SizeClass sizeClasses[POOL_CLASS_COUNT];
+  Slab *slabs;
+
+  // every object, one list of pages per size class, most recent first
+  // new slots are carved off the most recent page
+  ObjectPage *objectPages[OBJECT_CLASS_COUNT];
+};
+
+#define ALLOCATE(heap, category, type, count) \
+  (type *)reallocate(heap, category, NULL, 0, sizeof(type) * (count))
+
+// like ALLOCATE, but zero-filled
+// big blocks come straight from fresh zero pages, so the cost of touching them is spread over their first use instead of paid up front
+#define ALLOCATE_ZEROED(heap, category, type, count) \
+  (type *)allocateZeroed(heap, category, sizeof(type) * (count))
+
+#define FREE(heap, category, type, pointer) reallocate(heap, category, pointer, sizeof(type), 0)
 
 #define GROW_CAPACITY(capacity) \
   ((capacity) < 8 ? 8 : (capacity) * 2)
 
-#define GROW_ARRAY(type, pointer, oldCount, newCount) \
+#define GROW_ARRAY(heap, category, type, pointer, oldCount, newCount) \
   (type *)reallocate( \
+    heap, \
+    category, \
     pointer, \
     sizeof(type) * (oldCount), \
     sizeof(type) * (newCount) \
   )
 
-#define FREE_ARRAY(type, pointer, oldCount) \
-  reallocate(pointer, sizeof(type) * (oldCount), 0)
+#define FREE_ARRAY(heap, category, type, pointer, oldCount) \
+  reallocate(heap, category, pointer, sizeof(type) * (oldCount), 0)
+
+void initHeap(Heap *heap);
+void *reallocate(Heap *heap, MemoryCategory category, void *pointer, size_t oldSize, size_t newSize);
+void *allocateZeroed(Heap *heap, MemoryCategory category, size_t size);
+void freePools(Heap *heap);
+void freeRegions(Heap *heap);
+
+Obj *allocateObjectSlot(Heap *heap, size_t size);
 
-void *reallocate(void *pointer, size_t oldSize, size_t newSize);
+// for memory that doesn't come from `reallocate` (e.g. mappings), so it still shows up in the heap
+void trackMemory(Heap *heap, MemoryCategory category, size_t oldSize, size_t newSize);
+bool heapHasRoom(Heap *heap, size_t size);
 
-void freeObjects();
+void freeObjects(Heap *heap);
 
 #endif
\ No newline at end of file
@@ -3,49 +3,47 @@
 
 #include "memory.h"
 #include "object.h"
-#include "table.h"
+#include "intern.h"
+#include "shared.h"
 #include "value.h"
 #include "vm.h"
 
-#define ALLOCATE_OBJ(type, objectType) \
-  (type *)allocateObject(sizeof(type), objectType)
+#define ALLOCATE_OBJ(vm, type, objectType) \
+  (type *)allocateObject(vm, sizeof(type), objectType)
 
 static Obj *allocateObject(
+  VM *vm,
   size_t size,
   ObjType type
 ) {
-  Obj *object = (Obj *)reallocate(NULL, 0, size);
+  Obj *object = allocateObjectSlot(&vm->heap, size);
 
-  object->type = type;
+  trackMemory(&vm->heap, OBJECT_MEMORY(type), 0, size);
 
-  object->next = vm.objects;
-  vm.objects = object;
+  object->type = type;
+  object->flags = 0;
 
   return object;
 }
 
 static ObjString *allocateString(
+  VM *vm,
   char *chars,
-  int length,
-  uint32_t hash
+  int length
 ) {
-  ObjString *string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
+  ObjString *string = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
 
   string->length = length;
   string->chars = chars;
-  string->hash = hash;
-
-  tableSet(
-    &vm.strings,
-    string,
-    NIL_VAL // we don't need a value, we just care about the key (it's a set)
-  );
+  string->hash = 0;
 
   return string;
 }
 
+#ifdef STRING_HASH_FNV1A
+
 // fnv-1a
-static uint32_t hashString(
+uint32_t hashString(
   const char *key,
   int length
 ) {
@@ -63,44 +61,122 @@ static uint32_t hashString(
   return hash;
 }
 
-// takes ownership of the string
-ObjString *takeString(
-  char *chars,
+#else
+
+static inline uint64_t rotateLeft(
+  uint64_t x,
+  int bits
+) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+// fixed size loads, so they compile down to a single (unaligned) move
+static inline uint64_t read64(const char *p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+static inline uint64_t read32(const char *p) {
+  uint32_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+// word-at-a-time: mixes in 8 bytes per step instead of 1
+// the final avalanche (murmur3's fmix64) spreads every input bit over the low bits too, which is what the tables use to pick buckets and tags
+// most identifiers are shorter than 8 bytes and get hashed with a single multiply plus the avalanche
+uint32_t hashString(
+  const char *key,
   int length
 ) {
-  uint32_t hash = hashString(chars, length);
+  uint64_t hash = 0x9e3779b97f4a7c15ull;
+  uint64_t word;
 
-  ObjString *interned = tableFindString(
-    &vm.strings,
-    chars,
-    length,
-    hash
-  );
+  const char *end = key + length;
 
-  if (interned != NULL) {
-    // ownership of chars is being passed to this function and we no longer need the duplicate string, so it's up to us to free it
-    // we have a duplicate string e.g. when we concatenate two strings and receive a third one that already exists, so we free that one here
-    FREE_ARRAY(
-      char,
-      chars,
-      length + 1
-    );
+  if (length >= 8) {
+    while (end - key > 8) {
+      hash = rotateLeft((hash ^ read64(key)) * 0xbf58476d1ce4e5b9ull, 31);
+      key += 8;
+    }
 
-    return interned;
+    // the last 1-8 bytes, by loading the final 8 bytes of the string (overlapping what's already been mixed in)
+    word = read64(end - 8);
+  } else if (length >= 4) {
+    // two possibly overlapping 4 byte loads cover all of 4-7 bytes
+    word = (read32(key) << 32) | read32(end - 4);
+  } else if (length > 0) {
+    // first, middle and last byte cover all of 1-3 bytes
+    word = (
+      (uint64_t)(uint8_t)key[0] << 16 |
+      (uint64_t)(uint8_t)key[length >> 1] << 8 |
+      (uint64_t)(uint8_t)key[length - 1]
+    );
+  } else {
+    word = 0;
   }
 
-  return allocateString(chars, length, hash);
+  // mixing in the length keeps strings apart that only differ in how much the tail loads overlap
+  // it goes in after the multiply, so it can't cancel out against bits of the tail word
+  hash = ((hash ^ word) * 0x94d049bb133111ebull) ^ (uint64_t)length;
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+
+  return (uint32_t)hash;
+}
+
+#endif
+
+// takes ownership of the string
+// runtime strings are mostly intermediate values that get printed once and thrown away, so we don't hash or intern them here (see `internString`)
+ObjString *takeString(
+  VM *vm,
+  char *chars,
+  int length
+) {
+  return allocateString(vm, chars, length);
 }
 
+static ObjString *makeInterned(
+  VM *vm,
+  const char *chars,
+  int length,
+  bool borrow
+);
+
 // take a slice of a string and return the (possibly new) interned string object for it
 ObjString *copyString(
+  VM *vm,
+  const char *chars,
+  int length
+) {
+  return makeInterned(vm, chars, length, false);
+}
+
+// like `copyString`, but a new string borrows `chars` instead of copying them, for the compiler when the host keeps the source around (see `VM.borrowSource`)
+ObjString *borrowInterned(
+  VM *vm,
   const char *chars,
   int length
+) {
+  return makeInterned(vm, chars, length, true);
+}
+
+static ObjString *makeInterned(
+  VM *vm,
+  const char *chars,
+  int length,
+  bool borrow
 ) {
   uint32_t hash = hashString(chars, length);
 
-  ObjString *interned = tableFindString(
-    &vm.strings,
+  ObjString *interned = internSetFind(
+    &vm->strings,
     chars,
     length,
     hash
@@ -108,7 +184,28 @@ ObjString *copyString(
 
   if (interned != NULL) return interned; // that string already exists
 
-  char *heapChars = ALLOCATE(char, length + 1);
+  // some other vm may have made it already
+  if (vm->shared != NULL) {
+    ObjString *shared = sharedIntern(vm, chars, length, hash);
+
+    internSetAdd(&vm->strings, shared);
+
+    return shared;
+  }
+
+  if (borrow) {
+    // never written through, and never reused for other contents like a line (see lines.h), so it can be interned as it is
+    ObjString *string = allocateString(vm, (char *)chars, length);
+
+    string->hash = hash;
+    string->obj.flags |= OBJ_HASHED | OBJ_INTERNED | OBJ_BORROWED;
+
+    internSetAdd(&vm->strings, string);
+
+    return string;
+  }
+
+  char *heapChars = ALLOCATE(&vm->heap, MEMORY_STRING_CHARS, char, length + 1);
   
   memcpy(
     heapChars,
@@ -118,11 +215,274 @@ ObjString *copyString(
 
   heapChars[length] = '\0';
 
-  return allocateString(heapChars, length, hash);
+  ObjString *string = allocateString(vm, heapChars, length);
+
+  string->hash = hash;
+  string->obj.flags |= OBJ_HASHED;
+
+  return internString(vm, string);
 }
 
-void printObject(Value value) {
+uint32_t stringHash(ObjString *string) {
+  if (!(string->obj.flags & OBJ_HASHED)) {
+    string->hash = hashString(string->chars, string->length);
+    string->obj.flags |= OBJ_HASHED;
+  }
+
+  return string->hash;
+}
+
+// returns the canonical interned string with the same contents, interning this one if there is none yet
+// anything that uses a string as a table key has to go through here first, since tables compare keys by reference
+ObjString *internString(
+  VM *vm,
+  ObjString *string
+) {
+  if (string->obj.flags & OBJ_INTERNED) return string;
+
+  ObjString *interned = internSetFind(
+    &vm->strings,
+    string->chars,
+    string->length,
+    stringHash(string)
+  );
+
+  if (interned != NULL) return interned; // the duplicate stays in the vm's heap and is freed along with everything else
+
+  // the set keeps it for good, and as a key it shouldn't hold on to a whole parent string for a few characters of it
+  if (string->obj.flags & (OBJ_BORROWED | OBJ_VIEW)) ownString(vm, string);
+
+  string->obj.flags |= OBJ_INTERNED;
+
+  internSetAdd(&vm->strings, string);
+
+  return string;
+}
+
+// a string that points at someone else's characters instead of copying them (see OBJ_BORROWED)
+ObjString *borrowString(
+  VM *vm,
+  const char *chars,
+  int length
+) {
+  // never written through
+  ObjString *string = allocateString(vm, (char *)chars, length);
+
+  string->obj.flags |= OBJ_BORROWED;
+
+  return string;
+}
+
+// a slice of `parent` that shares its characters (see OBJ_VIEW)
+// objects live as long as the vm, and an owned string's characters never move, so the view is good for as long as it can be reached
+// a borrowed parent gets its own copy first (once, however many views are taken of it), since what it borrows from can go away
+// a view of a view points straight into the characters they both share
+ObjString *viewString(
+  VM *vm,
+  ObjString *parent,
+  int start,
+  int length
+) {
+  if (parent->obj.flags & OBJ_BORROWED) ownString(vm, parent);
+
+  ObjString *string = allocateString(vm, parent->chars + start, length);
+
+  string->obj.flags |= OBJ_VIEW;
+
+  return string;
+}
+
+// copies a borrowed string's (or a view's) characters into the heap, every reference to the string sees the copy from now on
+void ownString(
+  VM *vm,
+  ObjString *string
+) {
+  char *chars = ALLOCATE(&vm->heap, MEMORY_STRING_CHARS, char, string->length + 1);
+
+  memcpy(
+    chars,
+    string->chars,
+    string->length
+  );
+
+  chars[string->length] = '\0';
+
+  string->chars = chars;
+  string->obj.flags &= ~(OBJ_BORROWED | OBJ_VIEW);
+}
+
+bool stringsEqual(
+  ObjString *a,
+  ObjString *b
+) {
+  if (a == b) return true;
+
+  // two distinct interned strings can't have the same contents
+  if (a->obj.flags & b->obj.flags & OBJ_INTERNED) return false;
+
+  return (
+    a->length == b->length &&
+    stringHash(a) == stringHash(b) &&
+    memcmp(
+      a->chars,
+      b->chars,
+      a->length
+    ) == 0
+  );
+}
+
+ObjActor *newActorHandle(
+  VM *vm,
+  struct Actor *actor
+) {
+  ObjActor *handle = ALLOCATE_OBJ(vm, ObjActor, OBJ_ACTOR);
+
+  handle->actor = actor;
+
+  return handle;
+}
+
+ObjCoroutine *newCoroutine(
+  VM *vm,
+  uint8_t *ip
+) {
+  ObjCoroutine *coroutine = ALLOCATE_OBJ(vm, ObjCoroutine, OBJ_COROUTINE);
+
+  coroutine->state = COROUTINE_NEW;
+  coroutine->async = false;
+  coroutine->run = vm->runs;
+  coroutine->caller = NULL;
+
+  // the stack is only allocated by the first push, a coroutine that's never resumed doesn't need one
+  coroutine->fiber = (Fiber){NULL, NULL, NULL, ip};
+
+  coroutine->next = vm->coroutines;
+  vm->coroutines = coroutine;
+
+  return coroutine;
+}
+
+ObjHandle *newHandle(
+  VM *vm,
+  int fd,
+  bool pollable
+) {
+  ObjHandle *handle = ALLOCATE_OBJ(vm, ObjHandle, OBJ_HANDLE);
+
+  handle->fd = fd;
+  handle->pollable = pollable;
+  handle->reader.waiting = false;
+  handle->writer.waiting = false;
+  handle->next = NULL;
+
+  return handle;
+}
+
+ObjLines *newLines(
+  VM *vm,
+  const char *start,
+  size_t size
+) {
+  ObjLines *lines = ALLOCATE_OBJ(vm, ObjLines, OBJ_LINES);
+
+  lines->start = start;
+  lines->size = size;
+  lines->offset = 0;
+  lines->released = 0;
+  lines->line = NULL;
+  lines->previous = NULL;
+  lines->next = NULL;
+
+  return lines;
+}
+
+ObjList *newList(VM *vm) {
+  ObjList *list = ALLOCATE_OBJ(vm, ObjList, OBJ_LIST);
+
+  // empty counts as all numbers
+  list->numeric = true;
+  list->count = 0;
+  list->capacity = 0;
+  list->as.numbers = NULL;
+
+  return list;
+}
+
+ObjMap *newMap(VM *vm) {
+  ObjMap *map = ALLOCATE_OBJ(vm, ObjMap, OBJ_MAP);
+
+  initTable(&map->table, &vm->heap);
+
+  return map;
+}
+
+static void printList(
+  FILE *out,
+  ObjList *list
+) {
+  if (list->obj.flags & OBJ_PRINTING) {
+    fputs("[...]", out);
+    return;
+  }
+
+  list->obj.flags |= OBJ_PRINTING;
+
+  fputc('[', out);
+
+  for (int i = 0; i < list->count; i++) {
+    if (i > 0) fputs(", ", out);
+
+    printValue(out, list->numeric ? NUMBER_VAL(list->as.numbers[i]) : list->as.values[i]);
+  }
+
+  fputc(']', out);
+
+  list->obj.flags &= ~OBJ_PRINTING;
+}
+
+// in bucket order, which is no order in particular
+static void printMap(
+  FILE *out,
+  ObjMap *map
+) {
+  if (map->obj.flags & OBJ_PRINTING) {
+    fputs("{...}", out);
+    return;
+  }
+
+  map->obj.flags |= OBJ_PRINTING;
+
+  fputc('{', out);
+
+  int cursor = 0;
+  Entry *entry;
+
+  for (bool first = true; tableNext(&map->table, &cursor, &entry); first = false) {
+    if (!first) fputs(", ", out);
+
+    printValue(out, entry->key);
+    fputs(": ", out);
+    printValue(out, entry->value);
+  }
+
+  fputc('}', out);
+
+  map->obj.flags &= ~OBJ_PRINTING;
+}
+
+void printObject(
+  FILE *out,
+  Value value
+) {
   switch (OBJ_TYPE(value)) {
-    case OBJ_STRING: printf("%s", AS_CSTRING(value)); break;
+    // borrowed strings aren't null terminated
+    case OBJ_STRING: fwrite(AS_CSTRING(value), 1, AS_STRING(value)->length, out); break;
+    case OBJ_NATIVE: fputs("<native fn>", out); break;
+    case OBJ_ACTOR: fputs("<actor>", out); break;
+    case OBJ_COROUTINE: fputs("<coroutine>", out); break;
+    case OBJ_HANDLE: fputs("<handle>", out); break;
+    case OBJ_LINES: fputs("<lines>", out); break;
+    case OBJ_LIST: printList(out, AS_LIST(value)); break;
+    case OBJ_MAP: printMap(out, AS_MAP(value)); break;
   }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define clox_object_h
 
 #include "common.h"
+#include "table.h"
 #include "value.h"
 
 // assume a value is an object and get its type
@@ -9,6 +10,13 @@
 
 // is the value a string object?
 #define IS_STRING(value) isObjType(value, OBJ_STRING)
+#define IS_NATIVE(value) isObjType(value, OBJ_NATIVE)
+#define IS_ACTOR(value) isObjType(value, OBJ_ACTOR)
+#define IS_COROUTINE(value) isObjType(value, OBJ_COROUTINE)
+#define IS_HANDLE(value) isObjType(value, OBJ_HANDLE)
+#define IS_LINES(value) isObjType(value, OBJ_LINES)
+#define IS_LIST(value) isObjType(value, OBJ_LIST)
+#define IS_MAP(value) isObjType(value, OBJ_MAP)
 
 // assume a value is a string object
 #define AS_STRING(value) ((ObjString *)AS_OBJ(value))
@@ -16,32 +24,184 @@
 // assume a value is a string object and then access its char array
 #define AS_CSTRING(value) (((ObjString *)AS_OBJ(value))->chars)
 
+#define AS_NATIVE(value) ((ObjNative *)AS_OBJ(value))
+#define AS_ACTOR(value) (((ObjActor *)AS_OBJ(value))->actor)
+#define AS_COROUTINE(value) ((ObjCoroutine *)AS_OBJ(value))
+#define AS_HANDLE(value) ((ObjHandle *)AS_OBJ(value))
+#define AS_LINES(value) ((ObjLines *)AS_OBJ(value))
+#define AS_LIST(value) ((ObjList *)AS_OBJ(value))
+#define AS_MAP(value) ((ObjMap *)AS_OBJ(value))
+
 typedef enum {
   OBJ_STRING,
+  OBJ_NATIVE,
+  OBJ_ACTOR,
+  OBJ_COROUTINE,
+  OBJ_HANDLE,
+  OBJ_LINES,
+  OBJ_LIST,
+  OBJ_MAP,
 } ObjType;
 
+// bits of an object's `flags`
+#define OBJ_MARKED 0x01 // reachable, for a collector's mark phase
+#define OBJ_HASHED 0x02 // strings: `hash` has been computed
+#define OBJ_INTERNED 0x04 // strings: this is the copy in `vm.strings`
+#define OBJ_SHARED 0x08 // strings: lives in a `SharedStrings` table, outside of any vm's heap
+#define OBJ_BORROWED 0x10 // strings: `chars` belongs to something else (a mapped file, the source), isn't null terminated, and has to be copied with `ownString` before the string outlives it
+#define OBJ_PRINTING 0x20 // lists and maps: being printed, so one that contains itself prints as "[...]" (or "{...}") the second time
+#define OBJ_VIEW 0x40 // strings: `chars` points into another string's characters (see `viewString`), isn't null terminated, but stays valid as long as the vm, so unlike a borrowed string it can be kept around as it is
+
+// the whole header fits in one word
+// objects aren't chained together, the vm finds them by walking the pages they live in (see `ObjectHeap`)
 struct Obj {
-  ObjType type;
-  struct Obj *next; // next in line in the list of objects that the vm stores
+  uint8_t type; // an ObjType
+  uint8_t flags;
 };
 
 // a pointer to a struct is a pointer to the struct's first field, so we can:
 // - safely cast an ObjString to an Obj (upcast)
 // - safely cast an Obj to and ObjString once we checked its type field (downcast)
 
+// strings created at runtime (e.g. by concatenation) are hashed and interned lazily, only when they're needed as a table key, see OBJ_HASHED and OBJ_INTERNED
 struct ObjString {
   Obj obj;
   int length;
-  char *chars;
 
-  // cached hash code
+  // cached hash code, only valid once OBJ_HASHED is set
   uint32_t hash;
+
+  char *chars;
 };
 
-ObjString *takeString(char *chars, int length);
-ObjString *copyString(const char *chars, int length);
+// a function implemented in C
+// the arguments are `args[0]` to `args[argCount - 1]`, and the result goes into `args[-1]` (where the callee was)
+// returns false after reporting a runtime error with `runtimeError`
+typedef bool (*NativeFn)(VM *vm, int argCount, Value *args);
+
+// natives are static objects shared by every vm (see vm.c), they're never allocated or freed
+typedef struct {
+  Obj obj;
+  const char *name;
+  NativeFn function;
+} ObjNative;
+
+#define NATIVE(name, function) {{OBJ_NATIVE, 0}, name, function}
+
+// a vm's handle on an actor (see actor.h), the actor itself belongs to all the vms that spawned it together
+typedef struct {
+  Obj obj;
+  struct Actor *actor;
+} ObjActor;
+
+// the part of the vm's state every coroutine has its own copy of: a value stack, grown on demand, and where to carry on
+typedef struct {
+  Value *stack;
+  Value *stackTop; // exclusive
+  Value *stackEnd; // one past the last slot there's room for
+  uint8_t *ip;
+} Fiber;
 
-void printObject(Value value);
+typedef enum {
+  COROUTINE_NEW, // not resumed yet
+  COROUTINE_SUSPENDED, // in a call to `yield`, which the next `resume` returns from
+  COROUTINE_RUNNING, // running, or resuming another coroutine
+  COROUTINE_WAITING, // for the event loop to run it: parked in an I/O native, or an async one that yielded and is back in line (see io.h)
+  COROUTINE_DONE,
+} CoroutineState;
+
+// made by a `coroutine { ... }` expression
+// the body's code is in the chunk it was compiled into, so a coroutine is just its fiber: the object and a stack that starts out empty
+typedef struct ObjCoroutine {
+  Obj obj;
+  uint8_t state; // a CoroutineState
+  bool async; // run by the event loop instead of by `resume`
+  uint32_t run; // `vm.runs` when it was made, the chunk it runs is gone once the vm runs another one
+  struct ObjCoroutine *caller; // while it runs: who resumed it, NULL for the main script
+  Fiber fiber; // while it doesn't
+  struct ObjCoroutine *next; // every coroutine that can still run (see `vm.coroutines`)
+} ObjCoroutine;
+
+// a coroutine (or the main script) parked in an I/O native until the handle is ready
+typedef struct {
+  bool waiting;
+  uint8_t operation; // an IoOperation, see io.c
+  ObjCoroutine *coroutine; // NULL for the main script
+
+  // writes: the string and how much of it is out already
+  ObjString *data;
+  size_t done;
+} IoWaiter;
+
+// an open file or socket (see io.h)
+typedef struct ObjHandle {
+  Obj obj;
+  int fd; // -1 once it's closed
+  bool pollable; // sockets are, regular files aren't (epoll doesn't take them, they're always ready anyway)
+
+  // at most one operation each way at a time
+  IoWaiter reader;
+  IoWaiter writer;
+
+  struct ObjHandle *next; // every handle the vm has opened, so they're all closed when it's freed
+} ObjHandle;
+
+// a file mapped into memory and read a line at a time (see lines.h)
+typedef struct ObjLines {
+  Obj obj;
+  const char *start; // the mapping, NULL once it's closed (and for an empty file)
+  size_t size;
+  size_t offset; // where the next line starts
+  size_t released; // the pages before this have been handed back to the kernel
+
+  // the last two lines it returned, borrowed from the mapping
+  // by the time a line is two behind, the variable it went into has usually moved on to the next one, and its object is reused
+  ObjString *line;
+  ObjString *previous;
+
+  struct ObjLines *next; // every file the vm has mapped, so they're all unmapped when it's freed
+} ObjLines;
+
+// a growable array of values (see list.h)
+// while every element is a number it keeps just the doubles, half the size of boxed values and contiguous, so the numeric natives go through them with simd
+// the first element that isn't a number turns it into an array of values for good
+typedef struct {
+  Obj obj;
+  bool numeric; // the elements are in `as.numbers`, otherwise in `as.values`
+  int count;
+  int capacity;
+
+  union {
+    double *numbers;
+    Value *values;
+  } as;
+} ObjList;
+
+// `{key: value}`, a hash table of its own (the same kind the globals are in)
+// keys are strings, numbers, booleans or nil, see map.h
+typedef struct {
+  Obj obj;
+  Table table;
+} ObjMap;
+
+ObjString *takeString(VM *vm, char *chars, int length);
+ObjString *copyString(VM *vm, const char *chars, int length);
+ObjString *borrowInterned(VM *vm, const char *chars, int length);
+ObjString *internString(VM *vm, ObjString *string);
+ObjString *borrowString(VM *vm, const char *chars, int length);
+ObjString *viewString(VM *vm, ObjString *parent, int start, int length);
+void ownString(VM *vm, ObjString *string);
+uint32_t hashString(const char *key, int length);
+uint32_t stringHash(ObjString *string);
+bool stringsEqual(ObjString *a, ObjString *b);
+ObjActor *newActorHandle(VM *vm, struct Actor *actor);
+ObjCoroutine *newCoroutine(VM *vm, uint8_t *ip);
+ObjHandle *newHandle(VM *vm, int fd, bool pollable);
+ObjLines *newLines(VM *vm, const char *start, size_t size);
+ObjList *newList(VM *vm);
+ObjMap *newMap(VM *vm);
+
+void printObject(FILE *out, Value value);
 
 static inline bool isObjType(Value value, ObjType type) {
   return (
@@ -50,4 +210,30 @@ static inline bool isObjType(Value value, ObjType type) {
   );
 }
 
+// a borrowed string is about to go where nothing looks for it before reusing it (another coroutine's stack, the event loop, a list), so it needs its own copy
+static inline void ownValue(
+  VM *vm,
+  Value value
+) {
+  if (
+    IS_STRING(value) &&
+    AS_STRING(value)->obj.flags & OBJ_BORROWED
+  ) {
+    ownString(vm, AS_STRING(value));
+  }
+}
+
+// a string is about to be used as a c string, which borrowed strings and views aren't (no null terminator)
+static inline void terminateValue(
+  VM *vm,
+  Value value
+) {
+  if (
+    IS_STRING(value) &&
+    AS_STRING(value)->obj.flags & (OBJ_BORROWED | OBJ_VIEW)
+  ) {
+    ownString(vm, AS_STRING(value));
+  }
+}
+
 #endif
\ No newline at end of file
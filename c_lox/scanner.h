@@ -7,7 +7,10 @@ typedef enum {
   TOKEN_RIGHT_PAREN,
   TOKEN_LEFT_BRACE,
   TOKEN_RIGHT_BRACE,
+  TOKEN_LEFT_BRACKET,
+  TOKEN_RIGHT_BRACKET,
   TOKEN_COMMA,
+  TOKEN_COLON,
   TOKEN_DOT,
   TOKEN_MINUS,
   TOKEN_PLUS,
@@ -33,6 +36,7 @@ typedef enum {
   // keywords
   TOKEN_AND,
   TOKEN_CLASS,
+  TOKEN_COROUTINE,
   TOKEN_ELSE,
   TOKEN_FALSE,
   TOKEN_FOR,
@@ -60,8 +64,14 @@ typedef struct {
   int line;
 } Token;
 
-void initScanner(const char *source);
+typedef struct {
+  const char *start;
+  const char *current;
+  int line;
+} Scanner;
+
+void initScanner(Scanner *scanner, const char *source);
 
-Token scanToken();
+Token scanToken(Scanner *scanner);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include "scheduler.h"
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void initScheduler(
+  Scheduler *scheduler,
+  long slice,
+  TaskDone done
+) {
+  pthread_mutex_init(&scheduler->lock, NULL);
+  pthread_cond_init(&scheduler->ready, NULL);
+
+  scheduler->head = NULL;
+  scheduler->tail = NULL;
+  scheduler->pending = 0;
+  scheduler->slice = slice;
+  scheduler->done = done;
+}
+
+void freeScheduler(Scheduler *scheduler) {
+  pthread_mutex_destroy(&scheduler->lock);
+  pthread_cond_destroy(&scheduler->ready);
+}
+
+void initTask(
+  Task *task,
+  const char *source,
+  void *context
+) {
+  initVM(&task->vm);
+  initChunk(&task->chunk, &task->vm.heap);
+
+  task->source = source;
+  task->context = context;
+  task->slices = 0;
+  task->seconds = 0;
+  task->next = NULL;
+}
+
+// with the lock held
+static void enqueue(
+  Scheduler *scheduler,
+  Task *task
+) {
+  task->next = NULL;
+
+  if (scheduler->tail == NULL) {
+    scheduler->head = task;
+  } else {
+    scheduler->tail->next = task;
+  }
+
+  scheduler->tail = task;
+
+  pthread_cond_signal(&scheduler->ready);
+}
+
+void scheduleTask(
+  Scheduler *scheduler,
+  Task *task
+) {
+  task->vm.slice = scheduler->slice;
+
+  pthread_mutex_lock(&scheduler->lock);
+
+  scheduler->pending++;
+  enqueue(scheduler, task);
+
+  pthread_mutex_unlock(&scheduler->lock);
+}
+
+// the next task's turn, NULL once there are no more
+static Task *next(Scheduler *scheduler) {
+  pthread_mutex_lock(&scheduler->lock);
+
+  // a pending task that isn't queued is being run by another thread, and may come back
+  while (
+    scheduler->head == NULL &&
+    scheduler->pending > 0
+  ) {
+    pthread_cond_wait(&scheduler->ready, &scheduler->lock);
+  }
+
+  Task *task = scheduler->head;
+
+  if (task != NULL) {
+    scheduler->head = task->next;
+
+    if (scheduler->head == NULL) scheduler->tail = NULL;
+  }
+
+  pthread_mutex_unlock(&scheduler->lock);
+
+  return task;
+}
+
+static InterpretResult runSlice(Task *task) {
+  if (task->slices++ > 0) return resumeChunk(&task->vm);
+
+  // compiling isn't sliced, it's linear in the size of the source anyway
+  InterpretResult result = compileChunk(&task->vm, task->source, &task->chunk);
+
+  if (result != INTERPRET_OK) return result;
+
+  return runChunk(&task->vm, &task->chunk);
+}
+
+static void *work(void *argument) {
+  Scheduler *scheduler = argument;
+  Task *task;
+
+  while ((task = next(scheduler)) != NULL) {
+    double start = now();
+
+    InterpretResult result = runSlice(task);
+
+    task->seconds += now() - start;
+
+    if (result == INTERPRET_YIELD) {
+      pthread_mutex_lock(&scheduler->lock);
+      enqueue(scheduler, task);
+      pthread_mutex_unlock(&scheduler->lock);
+
+      continue;
+    }
+
+    freeChunk(&task->chunk);
+    freeVM(&task->vm);
+
+    scheduler->done(task, result);
+
+    pthread_mutex_lock(&scheduler->lock);
+
+    // the last one wakes everyone, so they see there's nothing left and return
+    if (--scheduler->pending == 0) pthread_cond_broadcast(&scheduler->ready);
+
+    pthread_mutex_unlock(&scheduler->lock);
+  }
+
+  return NULL;
+}
+
+void runScheduler(
+  Scheduler *scheduler,
+  int threads
+) {
+  pthread_t *extra = malloc(sizeof(pthread_t) * (threads > 1 ? threads - 1 : 1));
+
+  if (extra == NULL) exit(1);
+
+  for (int i = 0; i < threads - 1; i++) {
+    pthread_create(&extra[i], NULL, work, scheduler);
+  }
+
+  work(scheduler);
+
+  for (int i = 0; i < threads - 1; i++) {
+    pthread_join(extra[i], NULL);
+  }
+
+  free(extra);
+}
\ No newline at end of file
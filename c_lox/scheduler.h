@@ -0,0 +1,57 @@
+#ifndef clox_scheduler_h
+#define clox_scheduler_h
+
+#include <pthread.h>
+
+#include "chunk.h"
+#include "common.h"
+#include "vm.h"
+
+// runs any number of scripts on a few threads by taking turns: each gets a slice (see `vm.slice`), then goes to the back of the queue until everyone else has had theirs
+// a script that never ends only ever holds a thread for one slice at a time, no signals or timers needed
+// a script that blocks inside a native (an actor's `receive`) does hold on to its thread though
+
+typedef struct Task Task;
+
+// called on the thread that ran the task's last slice, once its vm has been freed
+typedef void (*TaskDone)(Task *task, InterpretResult result);
+
+struct Task {
+  // the host sets it up after `initTask` (heap options, shared strings, output streams), the scheduler frees it once the script is done
+  VM vm;
+  Chunk chunk;
+  const char *source; // compiled at the start of the first slice, the host's to free
+
+  void *context; // the host's
+
+  int slices; // how many it has had so far
+  double seconds; // spent running, waiting in the queue not included
+
+  Task *next; // in the run queue
+};
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t ready; // a task was queued, or the last one finished
+
+  // the run queue, first in first out
+  Task *head;
+  Task *tail;
+
+  int pending; // scheduled and not done yet
+  long slice;
+  TaskDone done;
+} Scheduler;
+
+void initScheduler(Scheduler *scheduler, long slice, TaskDone done);
+void freeScheduler(Scheduler *scheduler);
+
+void initTask(Task *task, const char *source, void *context);
+
+// may be called from any thread at any time, `done` included
+void scheduleTask(Scheduler *scheduler, Task *task);
+
+// runs every scheduled task on `threads` threads (the calling one plus `threads - 1` more), returns once none is pending
+void runScheduler(Scheduler *scheduler, int threads);
+
+#endif
\ No newline at end of file
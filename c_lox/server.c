@@ -0,0 +1,413 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "object.h"
+#include "server.h"
+#include "table.h"
+#include "vm.h"
+
+// compiled programs a worker keeps around (a power of two), when it runs out of room the vm is recycled
+#define PROGRAM_CACHE_CAPACITY 512
+#define PROGRAM_CACHE_MAX_LOAD (PROGRAM_CACHE_CAPACITY / 4 * 3)
+
+// without a collector, strings a script creates at runtime stay around until the vm is freed, so once a vm's heap gets this big it's thrown away and started afresh
+#ifndef RECYCLE_BYTES
+#define RECYCLE_BYTES (64 * 1024 * 1024)
+#endif
+
+// accepted connections waiting for a free worker
+#define CONNECTION_QUEUE 1024
+
+// a source that compiled, and its bytecode
+// the chunk's constants are strings on the heap of the vm that compiled it, so a cache belongs to one vm and goes away with it
+typedef struct {
+  char *source; // NULL for an empty bucket
+  size_t length;
+  uint32_t hash;
+  Chunk chunk;
+} Program;
+
+typedef struct {
+  int count;
+  Program programs[PROGRAM_CACHE_CAPACITY]; // open addressing, linear probing
+} ProgramCache;
+
+typedef struct Server Server;
+
+typedef struct {
+  Server *server;
+  pthread_t thread;
+
+  // stays initialized between requests (only the globals are cleared), that's what makes it warm
+  VM vm;
+  ProgramCache cache;
+} Worker;
+
+struct Server {
+  int listener;
+  bool regions;
+  size_t heapLimit;
+  SharedStrings *shared;
+
+  Worker *workers;
+  int workerCount;
+
+  // accepted connections, a ring buffer guarded by `lock`
+  pthread_mutex_t lock;
+  pthread_cond_t waiting; // signaled when a connection is queued
+  int connections[CONNECTION_QUEUE];
+  int first;
+  int count;
+};
+
+// sockets
+
+static bool readAll(
+  int fd,
+  void *buffer,
+  size_t length
+) {
+  char *bytes = buffer;
+
+  while (length > 0) {
+    ssize_t got = read(fd, bytes, length);
+
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return false;
+
+    bytes += got;
+    length -= got;
+  }
+
+  return true;
+}
+
+static bool writeAll(
+  int fd,
+  const void *buffer,
+  size_t length
+) {
+  const char *bytes = buffer;
+
+  while (length > 0) {
+    // MSG_NOSIGNAL: a client that hung up is an error here, not a SIGPIPE that kills the server
+    ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+
+    bytes += sent;
+    length -= sent;
+  }
+
+  return true;
+}
+
+// the program cache
+
+static Program *findProgram(
+  ProgramCache *cache,
+  const char *source,
+  size_t length,
+  uint32_t hash
+) {
+  for (
+    uint32_t index = hash & (PROGRAM_CACHE_CAPACITY - 1);
+    ;
+    index = (index + 1) & (PROGRAM_CACHE_CAPACITY - 1)
+  ) {
+    Program *program = &cache->programs[index];
+
+    // either the program or the empty bucket it would go into
+    if (
+      program->source == NULL ||
+      (
+        program->hash == hash &&
+        program->length == length &&
+        memcmp(program->source, source, length) == 0
+      )
+    ) {
+      return program;
+    }
+  }
+}
+
+static void freeProgramCache(ProgramCache *cache) {
+  for (int i = 0; i < PROGRAM_CACHE_CAPACITY; i++) {
+    Program *program = &cache->programs[i];
+
+    if (program->source == NULL) continue;
+
+    freeChunk(&program->chunk);
+    free(program->source);
+
+    program->source = NULL;
+  }
+
+  cache->count = 0;
+}
+
+// running scripts
+
+static void startVM(Worker *worker) {
+  initVM(&worker->vm);
+
+  worker->vm.heap.regions = worker->server->regions;
+  worker->vm.heap.limit = worker->server->heapLimit;
+
+  if (worker->server->shared != NULL) attachSharedStrings(&worker->vm, worker->server->shared);
+}
+
+static void recycleVM(Worker *worker) {
+  // the chunks first, their memory is accounted to the heap
+  freeProgramCache(&worker->cache);
+  freeVM(&worker->vm);
+
+  startVM(worker);
+}
+
+static int execute(
+  Worker *worker,
+  char *source,
+  size_t length,
+  FILE *out,
+  FILE *err
+) {
+  VM *vm = &worker->vm;
+  uint32_t hash = hashString(source, (int)length);
+
+  if (worker->cache.count >= PROGRAM_CACHE_MAX_LOAD) recycleVM(worker);
+
+  vm->out = out;
+  vm->err = err;
+
+  Program *program = findProgram(&worker->cache, source, length, hash);
+
+  if (program->source == NULL) {
+    initChunk(&program->chunk, &vm->heap);
+
+    InterpretResult result = compileChunk(vm, source, &program->chunk);
+
+    // sources that don't compile aren't cached, the error messages have to be printed again next time anyway
+    if (result != INTERPRET_OK) {
+      freeChunk(&program->chunk);
+      return result == INTERPRET_COMPILE_ERROR ? 65 : 70;
+    }
+
+    program->source = malloc(length);
+
+    if (program->source == NULL) exit(1);
+
+    memcpy(program->source, source, length);
+    program->length = length;
+    program->hash = hash;
+
+    worker->cache.count++;
+  }
+
+  InterpretResult result = runChunk(vm, &program->chunk);
+
+  // every request starts out with no globals, as if it had a process of its own
+  freeTable(&vm->globals);
+
+  // a script that spawned actors has to wait for them before its output is complete, and that's what freeing its vm does
+  // one that did i/o leaves handles open (or files mapped), freeing the vm closes them
+  if (
+    vm->actor != NULL ||
+    vm->loop != NULL ||
+    vm->files != NULL ||
+    vm->heap.current > RECYCLE_BYTES
+  ) {
+    recycleVM(worker);
+  }
+
+  return result == INTERPRET_RUNTIME_ERROR ? 70 : 0;
+}
+
+// requests on one connection until the client closes it (or sends something we can't handle)
+static void serve(
+  Worker *worker,
+  int fd
+) {
+  for (;;) {
+    uint32_t length;
+
+    if (!readAll(fd, &length, sizeof(length))) return;
+    if (length > SERVER_MAX_SOURCE) return;
+
+    char *source = malloc(length + 1);
+
+    if (source == NULL) exit(1);
+
+    if (!readAll(fd, source, length)) {
+      free(source);
+      return;
+    }
+
+    source[length] = '\0';
+
+    char *outChars = NULL;
+    char *errChars = NULL;
+    size_t outLength = 0;
+    size_t errLength = 0;
+
+    FILE *out = open_memstream(&outChars, &outLength);
+    FILE *err = open_memstream(&errChars, &errLength);
+
+    if (
+      out == NULL ||
+      err == NULL
+    ) {
+      exit(1);
+    }
+
+    uint32_t header[3];
+
+    header[0] = execute(worker, source, length, out, err);
+
+    fclose(out);
+    fclose(err);
+    free(source);
+
+    header[1] = (uint32_t)outLength;
+    header[2] = (uint32_t)errLength;
+
+    bool sent =
+      writeAll(fd, header, sizeof(header)) &&
+      writeAll(fd, outChars, outLength) &&
+      writeAll(fd, errChars, errLength);
+
+    free(outChars);
+    free(errChars);
+
+    if (!sent) return;
+  }
+}
+
+static void *work(void *argument) {
+  Worker *worker = argument;
+  Server *server = worker->server;
+
+  startVM(worker);
+
+  for (;;) {
+    pthread_mutex_lock(&server->lock);
+
+    while (server->count == 0) pthread_cond_wait(&server->waiting, &server->lock);
+
+    int fd = server->connections[server->first];
+
+    server->first = (server->first + 1) % CONNECTION_QUEUE;
+    server->count--;
+
+    pthread_mutex_unlock(&server->lock);
+
+    serve(worker, fd);
+    close(fd);
+  }
+
+  return NULL;
+}
+
+static int listenOn(const char *path) {
+  struct sockaddr_un address;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "socket path too long \"%s\"\n", path);
+    return -1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  // a socket left behind by an earlier server
+  unlink(path);
+
+  if (
+    bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+    listen(fd, SOMAXCONN) != 0
+  ) {
+    fprintf(stderr, "could not listen on \"%s\": %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+int runServer(
+  const char *path,
+  int workers,
+  bool regions,
+  size_t heapLimit,
+  SharedStrings *shared
+) {
+  Server server;
+
+  server.listener = listenOn(path);
+
+  if (server.listener < 0) return 74;
+
+  if (workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (workers < 1) workers = 1;
+
+  server.regions = regions;
+  server.heapLimit = heapLimit;
+  server.shared = shared;
+  server.workerCount = workers;
+  server.workers = calloc(workers, sizeof(Worker));
+  server.first = 0;
+  server.count = 0;
+
+  if (server.workers == NULL) exit(1);
+
+  pthread_mutex_init(&server.lock, NULL);
+  pthread_cond_init(&server.waiting, NULL);
+
+  for (int i = 0; i < workers; i++) {
+    server.workers[i].server = &server;
+    pthread_create(&server.workers[i].thread, NULL, work, &server.workers[i]);
+  }
+
+  fprintf(stderr, "listening on %s with %d workers\n", path, workers);
+
+  for (;;) {
+    int fd = accept(server.listener, NULL, NULL);
+
+    if (fd < 0) {
+      if (errno != EINTR) perror("accept");
+      continue;
+    }
+
+    pthread_mutex_lock(&server.lock);
+
+    if (server.count == CONNECTION_QUEUE) {
+      // far more clients than workers, turn this one away rather than queue without bound
+      pthread_mutex_unlock(&server.lock);
+      close(fd);
+      continue;
+    }
+
+    server.connections[(server.first + server.count) % CONNECTION_QUEUE] = fd;
+    server.count++;
+
+    pthread_cond_signal(&server.waiting);
+    pthread_mutex_unlock(&server.lock);
+  }
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef clox_server_h
+#define clox_server_h
+
+#include "common.h"
+#include "shared.h"
+
+// a daemon that runs scripts sent to it over a unix domain socket, so a client doesn't pay for starting a process, setting up a vm and (for a script it has sent before) compiling
+//
+// a connection carries any number of requests, one after the other
+// request: the length of the source (uint32_t) followed by the source itself
+// response: the exit code `clox <script>` would have had (uint32_t: 0, 65 or 70), the length of what the script printed to stdout and to stderr (uint32_t each), then those bytes
+// all integers are in host byte order, client and server are on the same machine
+
+// sources larger than this make the server drop the connection
+#define SERVER_MAX_SOURCE (16 * 1024 * 1024)
+
+// runs until killed
+// `workers` threads each own a vm and serve one connection at a time, 0 means one per core
+// every worker's vm may use `heapLimit` bytes of heap (see `Heap.limit`), 0 for no limit, a request that takes it over fails with a runtime error
+// with `shared` (may be NULL) the workers' vms share one intern table (see shared.h)
+int runServer(const char *path, int workers, bool regions, size_t heapLimit, SharedStrings *shared);
+
+#endif
\ No newline at end of file
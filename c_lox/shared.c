@@ -0,0 +1,473 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "object.h"
+#include "shared.h"
+#include "vm.h"
+
+#define BUCKET_EMPTY ((uintptr_t)0)
+
+// or'ed into a bucket once a rebuild has seen it, nobody may change it anymore (string pointers are at least 8 byte aligned, so the low bits are free)
+#define BUCKET_FROZEN ((uintptr_t)1)
+
+#define BUCKET_STRING(bucket) ((ObjString *)((bucket) & ~BUCKET_FROZEN))
+
+#define SHARED_MIN_CAPACITY 1024
+
+// maximum load factor of 3/4
+#define SHARED_MAX_LOAD(capacity) ((capacity) - (capacity) / 4)
+
+// how many retired blocks a record collects before it tries to move the epoch on
+#define RETIRE_THRESHOLD 64
+
+// a shared string lives outside of every vm's heap, in one malloc'ed block with its characters
+typedef struct {
+  atomic_int references; // one for the table itself plus one per attached vm that has it in its `vm.strings`, 0 once it's been evicted
+  ObjString string;
+  char chars[];
+} SharedString;
+
+#define AS_SHARED(object) ((SharedString *)((char *)(object) - offsetof(SharedString, string)))
+
+// something that was unlinked from the table but may still be read by a thread that found it just before
+struct Retired {
+  Retired *next;
+  void *block;
+  unsigned epoch; // the epoch it was retired in
+};
+
+static SharedArray *newArray(size_t capacity) {
+  SharedArray *array = calloc(1, sizeof(SharedArray) + sizeof(SharedBucket) * capacity);
+
+  if (array == NULL) exit(1);
+
+  array->capacity = capacity;
+
+  return array;
+}
+
+void initSharedStrings(SharedStrings *shared) {
+  atomic_init(&shared->array, newArray(SHARED_MIN_CAPACITY));
+  atomic_init(&shared->count, 0);
+  atomic_init(&shared->epoch, 0);
+  atomic_init(&shared->records, NULL);
+
+  pthread_mutex_init(&shared->growing, NULL);
+}
+
+void freeSharedStrings(SharedStrings *shared) {
+  SharedArray *array = atomic_load(&shared->array);
+
+  // the vms have all detached, so these are only held by the table
+  for (size_t i = 0; i < array->capacity; i++) {
+    uintptr_t bucket = atomic_load(&array->buckets[i]);
+
+    if (BUCKET_STRING(bucket) != NULL) free(AS_SHARED(BUCKET_STRING(bucket)));
+  }
+
+  free(array);
+
+  EpochRecord *record = atomic_load(&shared->records);
+
+  while (record != NULL) {
+    EpochRecord *next = record->next;
+    free(record);
+    record = next;
+  }
+
+  pthread_mutex_destroy(&shared->growing);
+}
+
+// epochs
+//
+// threads only read buckets and strings between `enter` and `leave`
+// anything unlinked from the table in epoch e is retired instead of freed, and freed once the global epoch has reached e + 2
+// the global epoch only moves on when every thread that's inside has seen the current one, so by e + 2 every thread that could have seen the block before it was unlinked has left
+
+#define EPOCH_MASK 0x7fffffffu
+
+static void enter(
+  SharedStrings *shared,
+  EpochRecord *record
+) {
+  unsigned epoch = atomic_load(&shared->epoch) & EPOCH_MASK;
+
+  // sequentially consistent, so the record reads as inside before anything in the table is read
+  atomic_store(&record->state, epoch << 1 | 1);
+}
+
+static void leave(EpochRecord *record) {
+  // everything read inside happens before this
+  atomic_store_explicit(&record->state, atomic_load_explicit(&record->state, memory_order_relaxed) & ~1u, memory_order_release);
+}
+
+// moves the global epoch on if every thread that's inside has seen it
+static void tryAdvance(SharedStrings *shared) {
+  unsigned epoch = atomic_load(&shared->epoch);
+
+  for (
+    EpochRecord *record = atomic_load(&shared->records);
+    record != NULL;
+    record = record->next
+  ) {
+    unsigned state = atomic_load(&record->state);
+
+    if (
+      (state & 1) &&
+      (state >> 1) != (epoch & EPOCH_MASK)
+    ) {
+      return;
+    }
+  }
+
+  atomic_compare_exchange_strong(&shared->epoch, &epoch, epoch + 1);
+}
+
+// frees what's old enough
+static void reclaim(
+  SharedStrings *shared,
+  EpochRecord *record
+) {
+  unsigned epoch = atomic_load(&shared->epoch);
+
+  // retired in order, so the oldest ones come first
+  while (
+    record->oldest != NULL &&
+    epoch - record->oldest->epoch >= 2
+  ) {
+    Retired *retired = record->oldest;
+
+    record->oldest = retired->next;
+    record->retiredCount--;
+
+    free(retired->block);
+    free(retired);
+  }
+
+  if (record->oldest == NULL) record->newest = NULL;
+}
+
+// only while inside
+static void retire(
+  SharedStrings *shared,
+  EpochRecord *record,
+  void *block
+) {
+  Retired *retired = malloc(sizeof(Retired));
+
+  if (retired == NULL) exit(1);
+
+  retired->next = NULL;
+  retired->block = block;
+  retired->epoch = atomic_load(&shared->epoch);
+
+  if (record->newest == NULL) {
+    record->oldest = retired;
+  } else {
+    record->newest->next = retired;
+  }
+
+  record->newest = retired;
+  record->retiredCount++;
+
+  if (record->retiredCount >= RETIRE_THRESHOLD) {
+    tryAdvance(shared);
+    reclaim(shared, record);
+  }
+}
+
+// the table
+
+static bool acquire(ObjString *string) {
+  atomic_int *references = &AS_SHARED(string)->references;
+  int count = atomic_load(references);
+
+  // a string whose count has dropped to 0 is being removed, it can't come back
+  while (count > 0) {
+    if (atomic_compare_exchange_weak(references, &count, count + 1)) return true;
+  }
+
+  return false;
+}
+
+static bool matches(
+  ObjString *string,
+  const char *chars,
+  int length,
+  uint32_t hash
+) {
+  return (
+    string->hash == hash &&
+    string->length == length &&
+    memcmp(string->chars, chars, length) == 0
+  );
+}
+
+static ObjString *newString(
+  const char *chars,
+  int length,
+  uint32_t hash
+) {
+  SharedString *shared = malloc(sizeof(SharedString) + length + 1);
+
+  if (shared == NULL) exit(1);
+
+  // the table's and the vm's
+  atomic_init(&shared->references, 2);
+
+  memcpy(shared->chars, chars, length);
+  shared->chars[length] = '\0';
+
+  ObjString *string = &shared->string;
+
+  string->obj.type = OBJ_STRING;
+  string->obj.flags = OBJ_HASHED | OBJ_INTERNED | OBJ_SHARED;
+  string->length = length;
+  string->hash = hash;
+  string->chars = shared->chars;
+
+  return string;
+}
+
+// a resize froze `array`, wait until the new one is in place
+static void waitForResize(
+  SharedStrings *shared,
+  SharedArray *array
+) {
+  while (atomic_load(&shared->array) == array) sched_yield();
+}
+
+static void insertCopy(
+  SharedArray *array,
+  ObjString *string
+) {
+  size_t mask = array->capacity - 1;
+  size_t index = string->hash & mask;
+
+  while (atomic_load_explicit(&array->buckets[index], memory_order_relaxed) != BUCKET_EMPTY) index = (index + 1) & mask;
+
+  atomic_store_explicit(&array->buckets[index], (uintptr_t)string, memory_order_relaxed);
+  atomic_fetch_add_explicit(&array->used, 1, memory_order_relaxed);
+}
+
+// replaces `array` by a new one with the strings some vm still holds, and evicts the others
+// every bucket of the old array gets frozen first, so an insert that races with the rebuild fails its compare and swap and retries on the new array
+static void rebuild(
+  SharedStrings *shared,
+  EpochRecord *record,
+  SharedArray *array
+) {
+  pthread_mutex_lock(&shared->growing);
+
+  if (atomic_load(&shared->array) != array) {
+    // someone else got here first
+    pthread_mutex_unlock(&shared->growing);
+    return;
+  }
+
+  size_t kept = 0;
+
+  for (size_t i = 0; i < array->capacity; i++) {
+    uintptr_t bucket = atomic_fetch_or(&array->buckets[i], BUCKET_FROZEN);
+    ObjString *string = BUCKET_STRING(bucket);
+
+    if (string == NULL) continue;
+
+    // only the table holds it, so nobody will miss it
+    // once its count is 0 nobody can acquire it anymore, but threads that found it a moment ago may still be comparing its characters
+    int expected = 1;
+
+    if (atomic_compare_exchange_strong(&AS_SHARED(string)->references, &expected, 0)) {
+      atomic_fetch_sub(&shared->count, 1);
+      retire(shared, record, AS_SHARED(string));
+    } else {
+      kept++;
+    }
+  }
+
+  // twice as big if what's left would fill more than a quarter of it, otherwise the same size (it was full of strings nobody used anymore)
+  size_t capacity = array->capacity;
+
+  if (kept > capacity / 4) capacity *= 2;
+
+  SharedArray *rebuilt = newArray(capacity);
+
+  for (size_t i = 0; i < array->capacity; i++) {
+    ObjString *string = BUCKET_STRING(atomic_load(&array->buckets[i]));
+
+    // the table's reference keeps a kept string's count above 0 from here on
+    if (
+      string != NULL &&
+      atomic_load(&AS_SHARED(string)->references) > 0
+    ) {
+      insertCopy(rebuilt, string);
+    }
+  }
+
+  atomic_store(&shared->array, rebuilt);
+
+  pthread_mutex_unlock(&shared->growing);
+
+  retire(shared, record, array);
+}
+
+ObjString *sharedIntern(
+  VM *vm,
+  const char *chars,
+  int length,
+  uint32_t hash
+) {
+  SharedStrings *shared = vm->shared;
+  EpochRecord *record = vm->epochRecord;
+
+  // only published once it's in a bucket, until then it can simply be freed
+  ObjString *fresh = NULL;
+  ObjString *result = NULL;
+
+  enter(shared, record);
+
+  while (result == NULL) {
+    SharedArray *array = atomic_load(&shared->array);
+    size_t mask = array->capacity - 1;
+    size_t index = hash & mask;
+    bool retry = false;
+
+    // the load factor guarantees that every cluster ends in an empty bucket
+    while (
+      result == NULL &&
+      !retry
+    ) {
+      uintptr_t bucket = atomic_load(&array->buckets[index]);
+      ObjString *string = BUCKET_STRING(bucket);
+
+      // a string, frozen or not, is still fine to hand out as long as it hasn't been evicted
+      if (
+        string != NULL &&
+        matches(string, chars, length, hash) &&
+        acquire(string)
+      ) {
+        result = string;
+        break;
+      }
+
+      if (bucket & BUCKET_FROZEN) {
+        // can't insert into a frozen bucket, and strings might have been evicted or moved, so look in the new array
+        waitForResize(shared, array);
+        retry = true;
+        break;
+      }
+
+      if (bucket != BUCKET_EMPTY) {
+        index = (index + 1) & mask;
+        continue;
+      }
+
+      // the end of the cluster without a match, so claim this bucket
+      if (atomic_load(&array->used) + 1 > SHARED_MAX_LOAD(array->capacity)) {
+        rebuild(shared, record, array);
+        retry = true;
+        break;
+      }
+
+      if (fresh == NULL) fresh = newString(chars, length, hash);
+
+      uintptr_t expected = BUCKET_EMPTY;
+
+      if (atomic_compare_exchange_strong(&array->buckets[index], &expected, (uintptr_t)fresh)) {
+        atomic_fetch_add(&array->used, 1);
+        atomic_fetch_add(&shared->count, 1);
+
+        result = fresh;
+        fresh = NULL;
+      }
+
+      // otherwise someone else just filled the bucket (maybe with this very string), and the next time around we look at it again
+    }
+  }
+
+  leave(record);
+
+  if (fresh != NULL) free(AS_SHARED(fresh));
+
+  return result;
+}
+
+void retainSharedString(ObjString *string) {
+  atomic_fetch_add(&AS_SHARED(string)->references, 1);
+}
+
+void releaseSharedString(ObjString *string) {
+  atomic_fetch_sub(&AS_SHARED(string)->references, 1);
+}
+
+// attaching vms
+
+void attachSharedStrings(
+  VM *vm,
+  SharedStrings *shared
+) {
+  EpochRecord *record;
+
+  // reuse the record of a vm that has detached already
+  for (
+    record = atomic_load(&shared->records);
+    record != NULL;
+    record = record->next
+  ) {
+    bool free = false;
+
+    if (atomic_compare_exchange_strong(&record->inUse, &free, true)) break;
+  }
+
+  if (record == NULL) {
+    record = malloc(sizeof(EpochRecord));
+
+    if (record == NULL) exit(1);
+
+    atomic_init(&record->inUse, true);
+    atomic_init(&record->state, 0);
+    record->oldest = NULL;
+    record->newest = NULL;
+    record->retiredCount = 0;
+
+    record->next = atomic_load(&shared->records);
+
+    while (!atomic_compare_exchange_weak(&shared->records, &record->next, record));
+  }
+
+  vm->shared = shared;
+  vm->epochRecord = record;
+}
+
+// drops the vm's reference, the string stays in the table until the next rebuild evicts it (if no other vm holds it by then)
+static void releaseString(
+  ObjString *string,
+  void *context
+) {
+  (void)context;
+
+  if (string->obj.flags & OBJ_SHARED) releaseSharedString(string);
+}
+
+void detachSharedStrings(VM *vm) {
+  SharedStrings *shared = vm->shared;
+  EpochRecord *record = vm->epochRecord;
+
+  internSetForEach(&vm->strings, releaseString, NULL);
+
+  // wait until everything this vm's rebuilds evicted can be freed, so a record is always clean when the next vm picks it up
+  // threads only stay inside the table for a single lookup, so this doesn't take long
+  while (record->oldest != NULL) {
+    tryAdvance(shared);
+    reclaim(shared, record);
+
+    if (record->oldest != NULL) sched_yield();
+  }
+
+  atomic_store(&record->inUse, false);
+
+  vm->shared = NULL;
+  vm->epochRecord = NULL;
+}
\ No newline at end of file
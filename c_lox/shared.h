@@ -0,0 +1,70 @@
+#ifndef clox_shared_h
+#define clox_shared_h
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "value.h"
+
+// an intern table that any number of vms, on any number of threads, can share, so identifiers and literals that every script uses exist once per process instead of once per vm
+// optional: a vm only uses it once it's been attached with `attachSharedStrings`
+//
+// only strings made by `copyString` (the compiler's identifiers and literals) are shared, strings built at runtime stay in the vm that made them
+// an attached vm still keeps its own `vm.strings`, and puts every shared string it gets there too, so only its first use of a string ever touches the shared table
+//
+// lookups and inserts are lock-free (compare and swap on the buckets), only rebuilding the table once it's full takes a lock
+// a shared string counts the vms that hold it, and stays in the table until a rebuild finds that none do anymore
+// an evicted string is only freed once no thread can still be looking at it (epoch based reclamation, see shared.c)
+
+// a bucket: empty or a pointer to a shared ObjString, plus the frozen bit while the table is being rebuilt
+typedef _Atomic(uintptr_t) SharedBucket;
+
+typedef struct {
+  size_t capacity; // a power of two
+  atomic_size_t used; // buckets that aren't empty
+  SharedBucket buckets[];
+} SharedArray;
+
+typedef struct Retired Retired;
+
+// what a vm needs to take part in epoch based reclamation, one per attached vm (and reused once it's detached)
+typedef struct EpochRecord {
+  struct EpochRecord *next; // every record there is, they're only freed with the table
+  atomic_bool inUse;
+
+  // the global epoch when the owner last entered the table (shifted left by one), with the lowest bit set while it's inside
+  atomic_uint state;
+
+  // what the owner removed and can't free yet, oldest first
+  Retired *oldest;
+  Retired *newest;
+  int retiredCount;
+} EpochRecord;
+
+typedef struct SharedStrings {
+  _Atomic(SharedArray *) array;
+  atomic_size_t count; // live strings
+  atomic_uint epoch;
+  _Atomic(EpochRecord *) records;
+  pthread_mutex_t growing; // one rebuild at a time
+} SharedStrings;
+
+void initSharedStrings(SharedStrings *shared);
+// only once no vm is attached anymore
+void freeSharedStrings(SharedStrings *shared);
+
+// right after `initVM`, the vm detaches itself in `freeVM`
+void attachSharedStrings(VM *vm, SharedStrings *shared);
+void detachSharedStrings(VM *vm);
+
+// the shared string with these contents, made (and added) if there is none yet
+// the vm holds a reference to it until it detaches
+ObjString *sharedIntern(VM *vm, const char *chars, int length, uint32_t hash);
+
+// for references held by something other than a vm (a message on its way to another vm, see actor.h)
+// retaining needs a reference that's held already, so the string can't be on its way out of the table
+void retainSharedString(ObjString *string);
+void releaseSharedString(ObjString *string);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+bool mapSource(
+  Source *source,
+  const char *path
+) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat info;
+
+  if (fd < 0) return false;
+
+  if (
+    fstat(fd, &info) != 0 ||
+    !S_ISREG(info.st_mode)
+  ) {
+    close(fd);
+    return false;
+  }
+
+  size_t length = (size_t)info.st_size;
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+  // room for one byte past the end, for the terminator: the rest of the file's last page reads as zeros, and when the file fills its last page exactly, the extra page is anonymous (zeros too)
+  size_t mapped = (length + page) / page * page;
+
+  char *chars = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (chars == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  // the file goes over the start of that
+  if (
+    length > 0 &&
+    mmap(chars, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED
+  ) {
+    munmap(chars, mapped);
+    close(fd);
+    return false;
+  }
+
+  // the mapping keeps the file
+  close(fd);
+
+  // the compiler reads it front to back, once
+  madvise(chars, mapped, MADV_SEQUENTIAL);
+
+  source->chars = chars;
+  source->length = length;
+  source->mapped = mapped;
+
+  return true;
+}
+
+void unmapSource(Source *source) {
+  munmap((char *)source->chars, source->mapped);
+
+  source->chars = NULL;
+  source->length = 0;
+  source->mapped = 0;
+}
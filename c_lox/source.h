@@ -0,0 +1,20 @@
+#ifndef clox_source_h
+#define clox_source_h
+
+#include "common.h"
+
+// a script's source, mapped straight from its file instead of being read into a buffer
+// the scanner's tokens point into the mapping, and with `VM.borrowSource` so do the compiler's identifiers and string literals, so nothing is copied out of a big script at all (and its pages are the page cache's, shared with every other process that has the file open)
+typedef struct {
+  const char *chars; // null terminated, like any source the compiler takes
+  size_t length;
+  size_t mapped; // bytes mapped, whole pages
+} Source;
+
+// false if the file can't be opened or isn't a regular file
+bool mapSource(Source *source, const char *path);
+
+// strings that borrowed from it have to be gone or given their own copy first (see `releaseSource`)
+void unmapSource(Source *source);
+
+#endif
@@ -6,220 +6,731 @@
 #include "table.h"
 #include "value.h"
 
-#define TABLE_MAX_LOAD 0.75
+// control bytes
+// full buckets hold a 7-bit tag (high bit clear), the two special values both have the high bit set
+#define CONTROL_EMPTY 0x80
+#define CONTROL_DELETED 0xfe
 
-void initTable(Table *table) {
+// the low 7 bits of the hash go into the control byte, the rest picks the group where probing starts
+#define HASH_TAG(hash) ((uint8_t)((hash) & 0x7f))
+#define HASH_GROUP(hash) ((hash) >> 7)
+
+// we probe a whole group of control bytes at once
+// with sse2 a group is 16 bytes compared in a single instruction, otherwise we fall back to comparing 8 bytes at a time packed into a u64 ("simd within a register")
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define GROUP_WIDTH 16
+
+// one bit per bucket in the group
+typedef uint32_t GroupMask;
+
+static inline GroupMask matchByte(
+  const uint8_t *group,
+  uint8_t byte
+) {
+  __m128i control = _mm_loadu_si128((const __m128i *)group);
+
+  return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(
+    control,
+    _mm_set1_epi8((char)byte)
+  ));
+}
+
+static inline GroupMask matchEmpty(const uint8_t *group) {
+  return matchByte(group, CONTROL_EMPTY);
+}
+
+static inline GroupMask matchEmptyOrDeleted(const uint8_t *group) {
+  // the high bit is set exactly for the special values
+  return (GroupMask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+
+static inline int lowestMatch(GroupMask mask) {
+  return __builtin_ctz(mask);
+}
+
+#else
+
+#define GROUP_WIDTH 8
+
+// one bit per bucket in the group, namely the high bit of each byte
+typedef uint64_t GroupMask;
+
+#define LOW_BITS 0x0101010101010101ull
+#define HIGH_BITS 0x8080808080808080ull
+
+static inline uint64_t loadGroup(const uint8_t *group) {
+  uint64_t control;
+  memcpy(&control, group, sizeof(control));
+  return control;
+}
+
+// can report false positives, but only for a byte right after a real match
+// that's fine, since every match gets checked against the actual key anyway
+static inline GroupMask matchByte(
+  const uint8_t *group,
+  uint8_t byte
+) {
+  uint64_t x = loadGroup(group) ^ (LOW_BITS * byte);
+  return (x - LOW_BITS) & ~x & HIGH_BITS;
+}
+
+static inline GroupMask matchEmpty(const uint8_t *group) {
+  // 0x80 is the only control byte with the high bit set and bit 1 clear
+  uint64_t control = loadGroup(group);
+  return control & (~control << 6) & HIGH_BITS;
+}
+
+static inline GroupMask matchEmptyOrDeleted(const uint8_t *group) {
+  return loadGroup(group) & HIGH_BITS;
+}
+
+// assumes a little-endian load, so the first bucket is the lowest byte
+static inline int lowestMatch(GroupMask mask) {
+  return __builtin_ctzll(mask) / 8;
+}
+
+#endif
+
+// drop the lowest set bit to move on to the next match
+#define NEXT_MATCH(mask) ((mask) & ((mask) - 1))
+
+// maximum load factor of 7/8, counting tombstones
+// this guarantees there's always an empty bucket somewhere, which is what ends a probe for a missing key
+#define TABLE_MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+// when the table fills up but at most this many of its buckets are live, the rest are tombstones and we rebuild at the same capacity instead of growing
+#define TABLE_MAX_REHASH_LOAD(capacity) (TABLE_MAX_LOAD(capacity) / 2)
+
+#define GROW_TABLE_CAPACITY(capacity) \
+  ((capacity) < GROUP_WIDTH ? GROUP_WIDTH : (capacity) * 2)
+
+// how many buckets of the old array each operation moves over while a resize is in progress
+// the move should be done before the new array fills up (the next resize would have to finish it in one go), and every insert moves a step:
+// - growing, the new array is twice the size and ends up with at most 7/8 of the old capacity in it, which leaves room for 7/8 of the old capacity in inserts, so 2 per operation would do
+// - rebuilding at the same capacity, it ends up at most 7/16 full (see TABLE_MAX_REHASH_LOAD), which leaves room for 7/16 of the capacity in inserts, so that takes at least 3
+#ifndef TABLE_MIGRATE_STEP
+#define TABLE_MIGRATE_STEP 32
+#endif
+
+#define IS_FULL(control) (((control) & 0x80) == 0)
+
+// numbers hash by their bits, which for small integers are all in the high half, so they're mixed (murmur3's finalizer) until every bit of the hash depends on all of them
+static inline uint32_t hashNumber(double number) {
+  uint64_t bits;
+
+  memcpy(&bits, &number, sizeof(bits));
+
+  bits ^= bits >> 33;
+  bits *= 0xff51afd7ed558ccdull;
+  bits ^= bits >> 33;
+  bits *= 0xc4ceb9fe1a85ec53ull;
+  bits ^= bits >> 33;
+
+  return (uint32_t)bits;
+}
+
+static inline uint32_t hashKey(Value key) {
+  switch (key.type) {
+    case VAL_OBJ: return AS_STRING(key)->hash; // interned, so already hashed
+    case VAL_NUMBER: return hashNumber(AS_NUMBER(key));
+    case VAL_BOOL: return AS_BOOL(key) ? 0x9e3779b9u : 0x7f4a7c15u;
+    default: return 0x85ebca6bu; // nil
+  }
+}
+
+// the key with every byte of its payload spelled out (a boolean only sets one of them, nil none), and -0 as 0
+// keys are only ever compared in this form, so the same key is the same bits (strings are interned, so that goes for them too)
+static inline Value canonicalKey(Value key) {
+  Value canonical;
+
+  memset(&canonical, 0, sizeof(canonical));
+
+  canonical.type = key.type;
+
+  switch (key.type) {
+    case VAL_OBJ: canonical.as.obj = AS_OBJ(key); break;
+    case VAL_NUMBER: canonical.as.number = AS_NUMBER(key) == 0 ? 0 : AS_NUMBER(key); break;
+    case VAL_BOOL: canonical.as.boolean = AS_BOOL(key); break;
+    default: break; // nil
+  }
+
+  return canonical;
+}
+
+static inline bool keysEqual(
+  Value a,
+  Value b
+) {
+  uint64_t x;
+  uint64_t y;
+
+  memcpy(&x, &a.as, sizeof(x));
+  memcpy(&y, &b.as, sizeof(y));
+
+  return x == y && a.type == b.type;
+}
+
+void initTable(
+  Table *table,
+  Heap *heap
+) {
+  table->heap = heap;
   table->count = 0;
+  table->tombstones = 0;
   table->capacity = 0;
+  table->control = NULL;
   table->entries = NULL;
+
+  table->oldCount = 0;
+  table->oldCapacity = 0;
+  table->oldControl = NULL;
+  table->oldEntries = NULL;
+  table->migrated = 0;
 }
 
-void freeTable(Table *table) {
+static void freeBuckets(
+  Heap *heap,
+  uint8_t *control,
+  Entry *entries,
+  int capacity
+) {
   FREE_ARRAY(
+    heap,
+    MEMORY_TABLE,
+    uint8_t,
+    control,
+    capacity
+  );
+
+  FREE_ARRAY(
+    heap,
+    MEMORY_TABLE,
     Entry,
-    table->entries,
-    table->capacity
+    entries,
+    capacity
   );
+}
+
+void freeTable(Table *table) {
+  freeBuckets(table->heap, table->control, table->entries, table->capacity);
+  freeBuckets(table->heap, table->oldControl, table->oldEntries, table->oldCapacity);
 
-  initTable(table);
+  initTable(table, table->heap);
 }
 
-static Entry *findEntry(
+// groups are probed quadratically (1, 2, 3, ... groups further each step)
+// with a power of two number of groups this visits every group exactly once before wrapping around
+// the mask replaces the `% capacity` of a plain linear probe
+#define FOR_EACH_PROBED_GROUP(capacity, hash, group) \
+  for ( \
+    size_t groupMask_ = (size_t)(capacity) / GROUP_WIDTH - 1, \
+      stride_ = 0, \
+      group = HASH_GROUP(hash) & groupMask_; \
+    ; \
+    stride_++, \
+      group = (group + stride_) & groupMask_ \
+  )
+
+// returns the bucket index of the key, or -1 if it's not in the array
+static inline int findEntry(
+  const uint8_t *control,
   Entry *entries,
   int capacity,
-  ObjString *key
+  Value key,
+  uint32_t hash
 ) {
-  uint32_t index = key->hash % capacity;
-
-  // the first tombstone we encountered, if any
-  Entry *tombstone = NULL;
-
-  // not an infinite loop because of our load factor
-  // how the hell would one prove this statically?
-  for (;;) {
-    Entry *entry = &entries[index];
-
-    if (entry->key == NULL) {
-
-      if (IS_NIL(entry->value)) {
-        // found an empty entry, which means the key is not present
-        // in this case we return the first tombstone we passed, if there is one, so that it can be reused
-        return (
-          tombstone != NULL
-            ? tombstone
-            : entry
-        );
-      } else {
-        // found a tombstone
-        if (tombstone == NULL) tombstone = entry;
-      }
+  if (capacity == 0) return -1;
 
-    } else if (entry->key == key) {
-      // found the key
-      return entry;
-    }
+  uint8_t tag = HASH_TAG(hash);
 
-    if (
-      entry->key == key ||
-      entry->key == NULL
+  FOR_EACH_PROBED_GROUP(capacity, hash, group) {
+    const uint8_t *groupControl = &control[group * GROUP_WIDTH];
+
+    for (
+      GroupMask match = matchByte(groupControl, tag);
+      match != 0;
+      match = NEXT_MATCH(match)
     ) {
-      return entry;
+      int index = (int)(group * GROUP_WIDTH) + lowestMatch(match);
+
+      if (keysEqual(entries[index].key, key)) return index;
     }
 
-    // not found, look at the next one (and wrap around if necessary)
-    index = (index + 1) % capacity;
+    // the key would have been placed in an empty bucket of this group if it was ever inserted
+    if (matchEmpty(groupControl) != 0) return -1;
   }
 }
 
-// returns if found or not (has)
-bool tableGet(
-  Table *table,
-  ObjString *key,
-  Value *value // pointer to output value (inout parameter)
+// returns the first bucket along the key's probe sequence that can take a new entry (empty or tombstone)
+static int findFreeEntry(
+  const uint8_t *control,
+  int capacity,
+  uint32_t hash
 ) {
-  if (table->count == 0) return false;
+  FOR_EACH_PROBED_GROUP(capacity, hash, group) {
+    GroupMask match = matchEmptyOrDeleted(&control[group * GROUP_WIDTH]);
 
-  Entry *entry = findEntry(
-    table->entries,
+    if (match != 0) return (int)(group * GROUP_WIDTH) + lowestMatch(match);
+  }
+}
+
+// returns true if the freed bucket became a tombstone
+static bool removeEntry(
+  uint8_t *control,
+  Entry *entries,
+  int index
+) {
+  entries[index].key = NIL_VAL;
+
+  // a group that still has an empty bucket has never been full, so no probe ever moved past it to the next group
+  // (groups only lose their empty buckets, they never get one back before a rebuild)
+  // that means no key can be sitting further along because of this bucket, and we can free it outright instead of leaving a tombstone
+  if (matchEmpty(&control[index & ~(GROUP_WIDTH - 1)]) != 0) {
+    control[index] = CONTROL_EMPTY;
+    return false;
+  }
+
+  // place a tombstone
+  control[index] = CONTROL_DELETED;
+
+  return true;
+}
+
+// put a key we know isn't in the table yet into the current array
+static void insertEntry(
+  Table *table,
+  Value key,
+  uint32_t hash,
+  Value value
+) {
+  int index = findFreeEntry(
+    table->control,
     table->capacity,
-    key
+    hash
   );
 
-  if (entry->key == NULL) return false;
+  if (table->control[index] == CONTROL_DELETED) table->tombstones--;
 
-  *value = entry->value;
+  table->control[index] = HASH_TAG(hash);
+  table->entries[index].key = key;
+  table->entries[index].value = value;
+}
 
-  return true;
+// move up to `buckets` buckets of the old array over to the current one, and release the old array once it's empty
+static void migrate(
+  Table *table,
+  int buckets
+) {
+  while (
+    buckets > 0 &&
+    table->migrated < table->oldCapacity
+  ) {
+    int i = table->migrated++;
+
+    buckets--;
+
+    if (!IS_FULL(table->oldControl[i])) continue;
+
+    Entry *entry = &table->oldEntries[i];
+
+    insertEntry(table, entry->key, hashKey(entry->key), entry->value);
+
+    // the current array has the only copy from now on, so lookups (and a set or delete) mustn't find this one anymore
+    // a tombstone rather than empty: keys that overflowed past this group and haven't been moved yet still have to be found along the probe
+    table->oldControl[i] = CONTROL_DELETED;
+    table->oldCount--;
+  }
+
+  if (
+    table->oldEntries != NULL &&
+    table->migrated == table->oldCapacity
+  ) {
+    freeBuckets(table->heap, table->oldControl, table->oldEntries, table->oldCapacity);
+
+    table->oldCount = 0;
+    table->oldCapacity = 0;
+    table->oldControl = NULL;
+    table->oldEntries = NULL;
+    table->migrated = 0;
+  }
 }
 
-// allocate an array of buckets
+// do our share of an ongoing resize, if there is one
+static inline void migrateStep(Table *table) {
+  if (table->oldEntries != NULL) migrate(table, TABLE_MIGRATE_STEP);
+}
+
+// allocate a new array of buckets
 // this is our chance to get rid of old tombstones
+// instead of re-inserting every entry right away (which for a big table is a noticeable stall in whatever operation happened to cross the load factor), the old array stays around and its entries get moved over a few buckets at a time by the following operations
 static void adjustCapacity(
   Table *table,
   int capacity
 ) {
-  Entry *entries = ALLOCATE(Entry, capacity);
-
-  // initialize new array
-  for (
-    int i = 0;
-    i < capacity;
-    i++
-  ) {
-    entries[i].key = NULL;
-    entries[i].value = NIL_VAL;
+  // only one resize at a time, the old array of a previous one has to go first
+  migrate(table, table->oldCapacity);
+
+  if (table->count > 0) {
+    table->oldCount = table->count;
+    table->oldCapacity = table->capacity;
+    table->oldControl = table->control;
+    table->oldEntries = table->entries;
+    table->migrated = 0;
+  } else {
+    freeBuckets(table->heap, table->control, table->entries, table->capacity);
   }
 
-  table->count = 0; // since we are pruning tombstones, our count might change, so we count again
+  table->tombstones = 0;
+  table->capacity = capacity;
+  table->control = ALLOCATE(table->heap, MEMORY_TABLE, uint8_t, capacity);
+  table->entries = ALLOCATE(table->heap, MEMORY_TABLE, Entry, capacity);
 
-  // rebuild the table from scratch, re-insert every entry into the new empty array
-  for (
-    int i = 0;
-    i < table->capacity;
-    i++
-  ) {
-    Entry *entry = &table->entries[i];
+  memset(
+    table->control,
+    CONTROL_EMPTY,
+    capacity
+  );
+}
 
-    if (entry->key == NULL) continue;
+// returns if found or not (has)
+static inline bool get(
+  Table *table,
+  Value key, // canonical
+  uint32_t hash,
+  Value *value // pointer to output value (inout parameter)
+) {
+  if (table->count == 0) return false;
 
-    Entry *dest = findEntry(
-      entries,
-      capacity,
-      entry->key
-    );
+  migrateStep(table);
 
-    dest->key = entry->key;
-    dest->value = entry->value;
+  int index = findEntry(table->control, table->entries, table->capacity, key, hash);
 
-    table->count++;
+  if (index != -1) {
+    *value = table->entries[index].value;
+    return true;
   }
 
-  // release the memory for the old array
-  FREE_ARRAY(
-    Entry,
-    table->entries,
-    table->capacity
-  );
+  // during a resize, the key may not have been moved over yet
+  index = findEntry(table->oldControl, table->oldEntries, table->oldCapacity, key, hash);
 
-  table->entries = entries;
-  table->capacity = capacity;
+  if (index != -1) {
+    *value = table->oldEntries[index].value;
+    return true;
+  }
+
+  return false;
 }
 
 // returns true for inserts and false for updates
-bool tableSet(
+static inline bool set(
   Table *table,
-  ObjString *key,
+  Value key,
+  uint32_t hash,
   Value value
 ) {
+  migrateStep(table);
+
+  int index = findEntry(table->control, table->entries, table->capacity, key, hash);
+
+  if (index != -1) {
+    table->entries[index].value = value;
+    return false;
+  }
+
+  index = findEntry(table->oldControl, table->oldEntries, table->oldCapacity, key, hash);
+
+  if (index != -1) {
+    // update it in place, it'll get moved over with the new value
+    table->oldEntries[index].value = value;
+    return false;
+  }
+
+  // tombstones and entries still in the old array don't take up room in the current one
+  int currentCount = table->count - table->oldCount;
+
+  if (currentCount + table->tombstones + 1 > TABLE_MAX_LOAD(table->capacity)) {
+    // under delete-heavy churn the table is mostly tombstones, so getting rid of them is enough
+    int capacity = (
+      table->count + 1 > TABLE_MAX_REHASH_LOAD(table->capacity)
+        ? GROW_TABLE_CAPACITY(table->capacity)
+        : table->capacity
+    );
 
-  if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
-    int capacity = GROW_CAPACITY(table->capacity);
     adjustCapacity(table, capacity);
   }
 
-  Entry *entry = findEntry(
-    table->entries,
-    table->capacity,
-    key
-  );
+  insertEntry(table, key, hash, value);
 
-  bool isNewKey = entry->key == NULL;
+  table->count++;
 
-  if (
-    isNewKey &&
-    IS_NIL(entry->value) // we don't increment the count when reusing a tombstone
-  ) table->count++;
+  return true;
+}
+
+static inline bool delete(
+  Table *table,
+  Value key,
+  uint32_t hash
+) {
+  if (table->count == 0) return false;
+
+  migrateStep(table);
+
+  // find the entry
+  int index = findEntry(table->control, table->entries, table->capacity, key, hash);
 
-  entry->key = key;
-  entry->value = value;
+  if (index != -1) {
+    if (removeEntry(table->control, table->entries, index)) table->tombstones++;
 
-  return isNewKey;
+    table->count--;
+
+    return true;
+  }
+
+  index = findEntry(table->oldControl, table->oldEntries, table->oldCapacity, key, hash);
+
+  if (index != -1) {
+    // tombstones in the old array don't matter, it's going away anyway
+    removeEntry(table->oldControl, table->oldEntries, index);
+
+    table->oldCount--;
+    table->count--;
+
+    return true;
+  }
+
+  return false;
+}
+
+// string keys (globals) skip working out the key's type
+bool tableGet(
+  Table *table,
+  ObjString *key,
+  Value *value
+) {
+  return get(table, OBJ_VAL(key), key->hash, value);
+}
+
+bool tableSet(
+  Table *table,
+  ObjString *key,
+  Value value
+) {
+  return set(table, OBJ_VAL(key), key->hash, value);
 }
 
 bool tableDelete(
   Table *table,
   ObjString *key
 ) {
-  if (table->count == 0) return false;
+  return delete(table, OBJ_VAL(key), key->hash);
+}
 
-  // find the entry
-  Entry *entry = findEntry(
-    table->entries,
-    table->capacity,
-    key
-  );
+bool tableGetValue(
+  Table *table,
+  Value key,
+  Value *value
+) {
+  key = canonicalKey(key);
 
-  if (entry->key == NULL) return false;
+  return get(table, key, hashKey(key), value);
+}
 
-  // place a tombstone
-  entry->key = NULL;
-  entry->value = BOOL_VAL(true);
+bool tableSetValue(
+  Table *table,
+  Value key,
+  Value value
+) {
+  key = canonicalKey(key);
+
+  return set(table, key, hashKey(key), value);
+}
+
+bool tableDeleteValue(
+  Table *table,
+  Value key
+) {
+  key = canonicalKey(key);
+
+  return delete(table, key, hashKey(key));
+}
+
+// make room for `count` entries in all, so filling the table up to that many never resizes it
+// false if the buckets wouldn't fit under the heap's limit, nothing is allocated then (and the heap is exhausted)
+bool tableReserve(
+  Table *table,
+  int count
+) {
+  int capacity = table->capacity;
+
+  while (count > TABLE_MAX_LOAD(capacity)) capacity = GROW_TABLE_CAPACITY(capacity);
+
+  if (capacity == table->capacity) return true;
+
+  // the count may come straight from a script, and the new array is in addition to the old one until it's migrated
+  if (!heapHasRoom(table->heap, (size_t)capacity * (sizeof(uint8_t) + sizeof(Entry)))) return false;
+
+  adjustCapacity(table, capacity);
+
+  // a bulk load is coming, moving everything over now means it won't have to look in two arrays
+  migrate(table, table->oldCapacity);
 
   return true;
 }
 
+// the entry after bucket `*cursor` (start at 0), false at the end
+// the current array first, then whatever a resize hasn't moved over yet
+// nothing moves while iterating, but setting or deleting keys in between can move entries around, and then an iteration can miss or repeat some
+bool tableNext(
+  Table *table,
+  int *cursor,
+  Entry **entry
+) {
+  for (; *cursor < table->capacity + table->oldCapacity; (*cursor)++) {
+    int i = *cursor;
+
+    if (i < table->capacity) {
+      if (!IS_FULL(table->control[i])) continue;
+
+      *entry = &table->entries[i];
+    } else {
+      i -= table->capacity;
+
+      // what's below `migrated` has been moved to the current array, where it was visited already
+      if (
+        i < table->migrated ||
+        !IS_FULL(table->oldControl[i])
+      ) {
+        continue;
+      }
+
+      *entry = &table->oldEntries[i];
+    }
+
+    (*cursor)++;
+
+    return true;
+  }
+
+  return false;
+}
+
+static void addAllBuckets(
+  const uint8_t *control,
+  Entry *entries,
+  int from, // the first bucket to look at
+  int capacity,
+  Table *to
+) {
+  for (
+    int i = from;
+    i < capacity;
+    i++
+  ) {
+    if (!IS_FULL(control[i])) continue; // empty or tombstone
+
+    tableSetValue(
+      to,
+      entries[i].key,
+      entries[i].value
+    );
+  }
+}
+
 void tableAddAll(
   Table *from,
   Table *to
+) {
+  addAllBuckets(from->control, from->entries, 0, from->capacity, to);
+
+  // the old array's buckets below `migrated` are in the current array already
+  addAllBuckets(from->oldControl, from->oldEntries, from->migrated, from->oldCapacity, to);
+}
+
+static bool bucketsHold(
+  const uint8_t *control,
+  Entry *entries,
+  int from, // the first bucket to look at
+  int capacity,
+  Obj *object
 ) {
   for (
-    int i = 0;
-    i < from->capacity;
+    int i = from;
+    i < capacity;
     i++
   ) {
-    Entry *entry = &from->entries[i];
-
-    if (entry->key != NULL) {
-      tableSet(
-        to,
-        entry->key,
-        entry->value
-      );
+    if (
+      IS_FULL(control[i]) &&
+      IS_OBJ(entries[i].value) &&
+      AS_OBJ(entries[i].value) == object
+    ) {
+      return true;
     }
   }
+
+  return false;
+}
+
+// whether `object` is the value of any entry, a scan over every bucket
+bool tableHoldsObject(
+  Table *table,
+  Obj *object
+) {
+  return (
+    bucketsHold(table->control, table->entries, 0, table->capacity, object) ||
+    bucketsHold(table->oldControl, table->oldEntries, table->migrated, table->oldCapacity, object)
+  );
 }
 
 // similar to `findEntry` but works on strings (char *) directly instead of on `ObjString` structs
+static ObjString *findString(
+  const uint8_t *control,
+  Entry *entries,
+  int capacity,
+  const char *chars,
+  int length,
+  uint32_t hash
+) {
+  if (capacity == 0) return NULL;
+
+  uint8_t tag = HASH_TAG(hash);
+
+  FOR_EACH_PROBED_GROUP(capacity, hash, group) {
+    const uint8_t *groupControl = &control[group * GROUP_WIDTH];
+
+    for (
+      GroupMask match = matchByte(groupControl, tag);
+      match != 0;
+      match = NEXT_MATCH(match)
+    ) {
+      Value entryKey = entries[group * GROUP_WIDTH + lowestMatch(match)].key;
+
+      if (!IS_OBJ(entryKey)) continue;
+
+      ObjString *key = AS_STRING(entryKey);
+
+      if (
+        key->length == length &&
+        key->hash == hash &&
+        memcmp(
+          key->chars,
+          chars,
+          length
+        ) == 0
+      ) {
+        // found it
+        return key;
+      }
+    }
+
+    // stop if the group has an empty bucket (tombstones are ok)
+    if (matchEmpty(groupControl) != 0) return NULL;
+  }
+}
+
 ObjString *tableFindString(
   Table *table,
   const char *chars,
@@ -228,28 +739,70 @@ ObjString *tableFindString(
 ) {
   if (table->count == 0) return NULL;
 
-  uint32_t index = hash % table->capacity;
-
-  for (;;) {
-    Entry *entry = &table->entries[index];
-
-    if (entry->key == NULL) {
-      // stop if we find an empty entry (tombstones are ok)
-      if (IS_NIL(entry->value)) return NULL;
-    } else if (
-      entry->key->length == length &&
-      entry->key->hash == hash &&
-      memcmp(
-        entry->key->chars,
-        chars,
-        length
-      ) == 0
-    ) {
-      // found it
-      return entry->key;
+  migrateStep(table);
+
+  ObjString *key = findString(
+    table->control,
+    table->entries,
+    table->capacity,
+    chars,
+    length,
+    hash
+  );
+
+  if (key != NULL) return key;
+
+  return findString(
+    table->oldControl,
+    table->oldEntries,
+    table->oldCapacity,
+    chars,
+    length,
+    hash
+  );
+}
+
+static void bucketStats(
+  const uint8_t *control,
+  Entry *entries,
+  int from, // the first bucket to look at
+  int capacity,
+  long *totalProbe,
+  TableStats *stats
+) {
+  for (
+    int i = from;
+    i < capacity;
+    i++
+  ) {
+    if (!IS_FULL(control[i])) continue; // empty or tombstone
+
+    // follow the key's probe sequence until we reach the group it sits in
+    int probe = 0;
+
+    FOR_EACH_PROBED_GROUP(capacity, hashKey(entries[i].key), group) {
+      probe++;
+
+      if (group == (size_t)i / GROUP_WIDTH) break;
     }
 
-    // not found, look at the next one (and wrap around if necessary)
-    index = (index + 1) % table->capacity;
+    *totalProbe += probe;
+
+    if (probe > stats->maxProbe) stats->maxProbe = probe;
   }
+}
+
+void tableStats(
+  Table *table,
+  TableStats *stats
+) {
+  long totalProbe = 0;
+
+  stats->averageProbe = 0;
+  stats->maxProbe = 0;
+
+  bucketStats(table->control, table->entries, 0, table->capacity, &totalProbe, stats);
+  bucketStats(table->oldControl, table->oldEntries, table->migrated, table->oldCapacity, &totalProbe, stats);
+
+  if (table->count > 0) stats->averageProbe = (double)totalProbe / table->count;
 }
\ No newline at end of file
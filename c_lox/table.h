@@ -4,23 +4,51 @@
 #include "common.h"
 #include "value.h"
 
+// keys are strings (interned ones, so the same key is the same object), numbers (not NaN, and -0 is the same key as 0), booleans or nil
 typedef struct {
-  ObjString *key;
+  Value key;
   Value value;
 } Entry;
 
+// swiss table: buckets live in `entries`, and a parallel array of one control byte per bucket says whether the bucket is empty, deleted (tombstone) or full
+// for full buckets the control byte holds 7 bits of the key's hash, so a probe can rule out most buckets without touching `entries` (or dereferencing the key) at all
 typedef struct {
-  int count; // number of full buckets, including tombstones
-  int capacity; // total number of buckets
+  Heap *heap; // where the buckets come from
+  int count; // number of live entries
+  int tombstones; // number of deleted buckets, these still make probes longer until the next rebuild
+  int capacity; // total number of buckets (always a power of two, and a multiple of the group width)
+  uint8_t *control;
   Entry *entries;
+
+  // while a resize is in progress, the previous array of buckets
+  // its entries get moved over to the current array a few at a time, and lookups check both until it's empty
+  int oldCount; // number of live entries still in the old array (these are included in `count`)
+  int oldCapacity;
+  uint8_t *oldControl;
+  Entry *oldEntries;
+  int migrated; // buckets of the old array before this index have been moved over already
 } Table;
 
-void initTable(Table *table);
+void initTable(Table *table, Heap *heap);
 void freeTable(Table *table);
 bool tableGet(Table *table, ObjString *key, Value *value);
 bool tableSet(Table *table, ObjString *key, Value value);
 bool tableDelete(Table *table, ObjString *key);
+bool tableGetValue(Table *table, Value key, Value *value);
+bool tableSetValue(Table *table, Value key, Value value);
+bool tableDeleteValue(Table *table, Value key);
+bool tableReserve(Table *table, int count);
+bool tableNext(Table *table, int *cursor, Entry **entry);
 void tableAddAll(Table *from, Table *to);
+bool tableHoldsObject(Table *table, Obj *object);
 ObjString *tableFindString(Table *table, const char *chars, int length, uint32_t hash);
 
+// probe statistics, for benchmarks and debugging
+typedef struct {
+  double averageProbe; // average number of groups a lookup of a present key has to look at
+  int maxProbe;
+} TableStats;
+
+void tableStats(Table *table, TableStats *stats);
+
 #endif
\ No newline at end of file
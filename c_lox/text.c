@@ -0,0 +1,162 @@
+// for memmem, which glibc only declares with it
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+
+#include "list.h"
+#include "object.h"
+#include "text.h"
+
+// whether a number is a whole number from `min` to `max`
+static bool isPosition(
+  Value value,
+  int min,
+  int max
+) {
+  if (!IS_NUMBER(value)) return false;
+
+  double number = AS_NUMBER(value);
+
+  return (
+    number >= min &&
+    number <= max &&
+    number == (int)number
+  );
+}
+
+bool substringNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (
+    argCount < 2 ||
+    argCount > 3
+  ) {
+    runtimeError(vm, "Expected 2 or 3 arguments but got %d.", argCount);
+    return false;
+  }
+
+  if (!IS_STRING(args[0])) {
+    runtimeError(vm, "First argument to substring must be a string.");
+    return false;
+  }
+
+  ObjString *string = AS_STRING(args[0]);
+
+  if (
+    !isPosition(args[1], 0, string->length) ||
+    (argCount == 3 && !isPosition(args[2], (int)AS_NUMBER(args[1]), string->length))
+  ) {
+    runtimeError(vm, "Substring bounds out of range.");
+    return false;
+  }
+
+  int start = (int)AS_NUMBER(args[1]);
+  int end = argCount == 3 ? (int)AS_NUMBER(args[2]) : string->length;
+
+  args[-1] = OBJ_VAL(viewString(vm, string, start, end - start));
+
+  return true;
+}
+
+// where `needle` first starts in `haystack` at or after `from`, or -1
+static int find(
+  ObjString *haystack,
+  ObjString *needle,
+  int from
+) {
+  const char *start = haystack->chars + from;
+  size_t rest = (size_t)(haystack->length - from);
+  const char *found;
+
+  // memchr is the faster scan for the common single character case
+  if (needle->length == 1) {
+    found = memchr(start, needle->chars[0], rest);
+  } else {
+    found = memmem(start, rest, needle->chars, needle->length);
+  }
+
+  return found == NULL ? -1 : (int)(found - haystack->chars);
+}
+
+bool indexOfNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (
+    argCount < 2 ||
+    argCount > 3
+  ) {
+    runtimeError(vm, "Expected 2 or 3 arguments but got %d.", argCount);
+    return false;
+  }
+
+  if (
+    !IS_STRING(args[0]) ||
+    !IS_STRING(args[1])
+  ) {
+    runtimeError(vm, "Arguments to indexOf must be strings.");
+    return false;
+  }
+
+  ObjString *string = AS_STRING(args[0]);
+
+  if (
+    argCount == 3 &&
+    !isPosition(args[2], 0, string->length)
+  ) {
+    runtimeError(vm, "Start of search out of range.");
+    return false;
+  }
+
+  args[-1] = NUMBER_VAL(find(string, AS_STRING(args[1]), argCount == 3 ? (int)AS_NUMBER(args[2]) : 0));
+
+  return true;
+}
+
+bool splitNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 2, argCount)) return false;
+
+  if (
+    !IS_STRING(args[0]) ||
+    !IS_STRING(args[1])
+  ) {
+    runtimeError(vm, "Arguments to split must be strings.");
+    return false;
+  }
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjString *separator = AS_STRING(args[1]);
+
+  if (separator->length == 0) {
+    runtimeError(vm, "Separator can't be empty.");
+    return false;
+  }
+
+  ObjList *pieces = newList(vm);
+  int start = 0;
+
+  for (;;) {
+    int end = find(string, separator, start);
+
+    if (end < 0) end = string->length;
+
+    listAppend(vm, pieces, OBJ_VAL(viewString(vm, string, start, end - start)));
+
+    if (end == string->length) break;
+
+    start = end + separator->length;
+  }
+
+  args[-1] = OBJ_VAL(pieces);
+
+  return true;
+}
\ No newline at end of file
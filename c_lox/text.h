@@ -0,0 +1,23 @@
+#ifndef clox_text_h
+#define clox_text_h
+
+#include "common.h"
+#include "vm.h"
+
+// slicing strings without copying them: every piece is a view into the string it came from (see OBJ_VIEW)
+//
+//   substring(s, start)          from `start` to the end
+//   substring(s, start, end)     from `start` up to (not including) `end`, 0 <= start <= end <= length(s)
+//   indexOf(s, needle)           where `needle` first starts in `s`, or -1
+//   indexOf(s, needle, from)     the same, looking from `from` on
+//   split(s, separator)          a list of the pieces between separators, empty ones included
+//   length(s)                    how many bytes it has (see list.h)
+//
+// a piece costs one string header, however long it is, and nothing is hashed or interned until a piece is used as a map key
+// pieces of a line from `nextLine` are views into a copy of the line, made once by the first slice (the line itself is borrowed from the file, see lines.h)
+
+bool substringNative(VM *vm, int argCount, Value *args);
+bool indexOfNative(VM *vm, int argCount, Value *args);
+bool splitNative(VM *vm, int argCount, Value *args);
+
+#endif
\ No newline at end of file
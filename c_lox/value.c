@@ -1,14 +1,20 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "arena.h"
 #include "object.h"
 #include "memory.h"
 #include "value.h"
 
-void initValueArray(ValueArray *array) {
+void initValueArray(
+  ValueArray *array,
+  Heap *heap
+) {
   array->values = NULL;
   array->capacity = 0;
   array->count = 0;
+  array->heap = heap;
+  array->arena = NULL;
 }
 
 // duplicate of writeChunk
@@ -22,7 +28,10 @@ void writeValueArray(
 
     array->capacity = GROW_CAPACITY(oldCapacity);
 
-    array->values = GROW_ARRAY(
+    array->values = GROW_ARRAY_IN(
+      array->heap,
+      array->arena,
+      MEMORY_CHUNK,
       Value,
       array->values,
       oldCapacity,
@@ -36,21 +45,27 @@ void writeValueArray(
 }
 
 void freeValueArray(ValueArray *array) {
-  FREE_ARRAY(
+  FREE_ARRAY_IN(
+    array->heap,
+    array->arena,
+    MEMORY_CHUNK,
     Value,
     array->values,
     array->capacity
   );
 
-  initValueArray(array);
+  initValueArray(array, array->heap);
 }
 
-void printValue(Value value) {
+void printValue(
+  FILE *out,
+  Value value
+) {
   switch (value.type) {
-    case VAL_BOOL: printf(AS_BOOL(value) ? "true" : "false"); break;
-    case VAL_NIL: printf("nil"); break;
-    case VAL_NUMBER: printf("%.17g", AS_NUMBER(value)); break;
-    case VAL_OBJ: printObject(value); break;
+    case VAL_BOOL: fputs(AS_BOOL(value) ? "true" : "false", out); break;
+    case VAL_NIL: fputs("nil", out); break;
+    case VAL_NUMBER: fprintf(out, "%.17g", AS_NUMBER(value)); break;
+    case VAL_OBJ: printObject(out, value); break;
   }
 }
 
@@ -61,7 +76,14 @@ bool valuesEqual(Value a, Value b) {
     case VAL_NIL: return true;
     case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
     case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
-    case VAL_OBJ: return AS_OBJ(a) == AS_OBJ(b); // strings are unique (interned), so same reference means same value
+    case VAL_OBJ:
+      // interned strings are unique, so for those same reference means same value, but runtime strings may not be interned yet
+      if (IS_STRING(a) && IS_STRING(b)) return stringsEqual(AS_STRING(a), AS_STRING(b));
+
+      // every vm has handles of its own
+      if (IS_ACTOR(a) && IS_ACTOR(b)) return AS_ACTOR(a) == AS_ACTOR(b);
+
+      return AS_OBJ(a) == AS_OBJ(b);
     default: return false; // unreachable
   }
 }
\ No newline at end of file
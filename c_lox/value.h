@@ -1,11 +1,15 @@
 #ifndef clox_value_h
 #define clox_value_h
 
+#include <stdio.h>
+
 #include "common.h"
 
 // forward declare
 typedef struct Obj Obj;
 typedef struct ObjString ObjString;
+typedef struct Heap Heap;
+typedef struct VM VM;
 
 typedef enum {
   VAL_BOOL,
@@ -62,14 +66,16 @@ typedef struct {
   int capacity;
   int count;
   Value *values;
+  Heap *heap;
+  struct Arena *arena; // where `values` grows, NULL for the heap
 } ValueArray;
 
 bool valuesEqual(Value a, Value b);
 
-void initValueArray(ValueArray *array);
+void initValueArray(ValueArray *array, Heap *heap);
 void writeValueArray(ValueArray *array, Value value);
 void freeValueArray(ValueArray *array);
 
-void printValue(Value value);
+void printValue(FILE *out, Value value);
 
 #endif
\ No newline at end of file
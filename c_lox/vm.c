@@ -1,68 +1,475 @@
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
+#include "actor.h"
 #include "common.h"
 #include "compiler.h"
 #include "debug.h"
+#include "io.h"
+#include "lines.h"
+#include "list.h"
+#include "map.h"
 #include "object.h"
 #include "memory.h"
+#include "shared.h"
+#include "text.h"
 #include "vm.h"
 
-VM vm;
+static void resetStack(VM *vm) {
+  vm->stackTop = vm->stack;
+}
+
+// coroutines
+
+void saveFiber(
+  VM *vm,
+  Fiber *fiber
+) {
+  fiber->stack = vm->stack;
+  fiber->stackTop = vm->stackTop;
+  fiber->stackEnd = vm->stackEnd;
+  fiber->ip = vm->ip;
+}
+
+void loadFiber(
+  VM *vm,
+  Fiber *fiber
+) {
+  vm->stack = fiber->stack;
+  vm->stackTop = fiber->stackTop;
+  vm->stackEnd = fiber->stackEnd;
+  vm->ip = fiber->ip;
+}
+
+// back to whoever resumed the running coroutine, whose call to `resume` returns `value`
+static void returnToCaller(
+  VM *vm,
+  CoroutineState state,
+  Value value
+) {
+  ObjCoroutine *coroutine = vm->coroutine;
+
+  saveFiber(vm, &coroutine->fiber);
+  coroutine->state = state;
+
+  // nobody resumed it, the event loop decides what runs next (and the value is dropped)
+  if (coroutine->async) {
+    asyncSuspended(vm, coroutine);
+    return;
+  }
+
+  vm->coroutine = coroutine->caller;
+  coroutine->caller = NULL;
+
+  loadFiber(vm, vm->coroutine == NULL ? &vm->main : &vm->coroutine->fiber);
+
+  vm->stackTop[-1] = value;
+}
+
+// after a runtime error in a coroutine, back to the main script's stack for the next run
+// the coroutines that were running stay that way, and can't be resumed anymore since they belong to the run that failed
+static void leaveCoroutines(VM *vm) {
+  if (vm->coroutine == NULL) return;
 
-static void resetStack() {
-  vm.stackTop = vm.stack;
+  loadFiber(vm, &vm->main);
+  vm->coroutine = NULL;
 }
 
-static void runtimeError(const char *format, ...) {
+void runtimeError(
+  VM *vm,
+  const char *format,
+  ...
+) {
   va_list args;
 
   va_start(args, format);
 
-  vfprintf(stderr, format, args);
+  vfprintf(vm->err, format, args);
 
   va_end(args);
 
-  fputs("\n", stderr);
+  fputs("\n", vm->err);
+
+  size_t instruction = vm->ip - vm->chunk->code - 1;
+  int line = vm->chunk->lines[instruction];
+
+  fprintf(vm->err, "[line %d] in script\n", line);
+
+  resetStack(vm);
+}
+
+bool checkArity(
+  VM *vm,
+  int expected,
+  int argCount
+) {
+  if (argCount == expected) return true;
+
+  runtimeError(vm, "Expected %d arguments but got %d.", expected, argCount);
+
+  return false;
+}
+
+// natives
+
+static bool clockNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  (void)vm;
+  (void)argCount;
+
+  args[-1] = NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+
+  return true;
+}
+
+// heapLimit(mb): lowers the heap limit (see --heap-limit) to that many megabytes of what's in use, never raises it
+// so a script (or a test) can hold itself to less than the host allows, but not to more
+static bool heapLimitNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (!checkArity(vm, 1, argCount)) return false;
+
+  if (
+    !IS_NUMBER(args[0]) ||
+    !(AS_NUMBER(args[0]) >= 1 && AS_NUMBER(args[0]) <= 1024 * 1024)
+  ) {
+    runtimeError(vm, "Heap limit must be a number of megabytes between 1 and %d.", 1024 * 1024);
+    return false;
+  }
+
+  size_t limit = (size_t)AS_NUMBER(args[0]) * 1024 * 1024;
+
+  if (
+    vm->heap.limit == 0 ||
+    limit < vm->heap.limit
+  ) {
+    vm->heap.limit = limit;
+  }
+
+  args[-1] = NUMBER_VAL((double)vm->heap.limit / (1024 * 1024));
+
+  return true;
+}
+
+// resume(coroutine) or resume(coroutine, value): runs the coroutine until it yields or finishes, and returns what it yielded (nil once it's finished)
+// `value` is what the coroutine's `yield` returns (a coroutine that hasn't started yet doesn't get it)
+// natives run with the stack already popped down to their result slot, so switching stacks here is safe, the result slot stays behind on the caller's stack until the coroutine fills it in
+static bool resumeNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (
+    argCount < 1 ||
+    argCount > 2
+  ) {
+    runtimeError(vm, "Expected 1 or 2 arguments but got %d.", argCount);
+    return false;
+  }
+
+  if (!IS_COROUTINE(args[0])) {
+    runtimeError(vm, "Can only resume coroutines.");
+    return false;
+  }
+
+  ObjCoroutine *coroutine = AS_COROUTINE(args[0]);
+  Value value = argCount == 2 ? args[1] : NIL_VAL;
+
+  // it goes onto another stack
+  ownValue(vm, value);
+
+  if (coroutine->run != vm->runs) {
+    runtimeError(vm, "Can't resume a coroutine from an earlier script.");
+    return false;
+  }
+
+  if (
+    coroutine->async ||
+    coroutine->state == COROUTINE_WAITING
+  ) {
+    runtimeError(vm, "Can't resume a coroutine the event loop runs.");
+    return false;
+  }
+
+  if (coroutine->state == COROUTINE_RUNNING) {
+    runtimeError(vm, "Can't resume a running coroutine.");
+    return false;
+  }
+
+  if (coroutine->state == COROUTINE_DONE) {
+    runtimeError(vm, "Can't resume a finished coroutine.");
+    return false;
+  }
+
+  args[-1] = NIL_VAL;
 
-  size_t instruction = vm.ip - vm.chunk->code - 1;
-  int line = vm.chunk->lines[instruction];
+  saveFiber(vm, vm->coroutine == NULL ? &vm->main : &vm->coroutine->fiber);
 
-  fprintf(stderr, "[line %d] in script\n", line);
+  bool suspended = coroutine->state == COROUTINE_SUSPENDED;
 
-  resetStack();
+  coroutine->caller = vm->coroutine;
+  coroutine->state = COROUTINE_RUNNING;
+  vm->coroutine = coroutine;
+
+  loadFiber(vm, &coroutine->fiber);
+
+  // the result of its call to `yield`
+  if (suspended) vm->stackTop[-1] = value;
+
+  return true;
 }
 
-void initVM() {
-  resetStack();
+// yield() or yield(value): back to whoever resumed this coroutine, their `resume` returns `value`
+static bool yieldNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (argCount > 1) {
+    runtimeError(vm, "Expected 0 or 1 arguments but got %d.", argCount);
+    return false;
+  }
+
+  if (vm->coroutine == NULL) {
+    runtimeError(vm, "Can't yield from the main script.");
+    return false;
+  }
+
+  Value value = argCount == 1 ? args[0] : NIL_VAL;
 
-  vm.objects = NULL;
+  ownValue(vm, value);
 
-  initTable(&vm.globals);
-  initTable(&vm.strings);
+  // the next `resume` puts its value here
+  args[-1] = NIL_VAL;
+
+  returnToCaller(vm, COROUTINE_SUSPENDED, value);
+
+  return true;
 }
 
-void freeVM() {
-  freeTable(&vm.globals);
-  freeTable(&vm.strings);
-  freeObjects();
+static bool doneNative(
+  VM *vm,
+  int argCount,
+  Value *args
+) {
+  if (
+    argCount != 1 ||
+    !IS_COROUTINE(args[0])
+  ) {
+    runtimeError(vm, "Argument to done must be a coroutine.");
+    return false;
+  }
+
+  args[-1] = BOOL_VAL(AS_COROUTINE(args[0])->state == COROUTINE_DONE);
+
+  return true;
+}
+
+// static, so every vm (and every message between vms) can use the very same objects
+// a global of the same name shadows a native, and the first lookup of one caches it in `vm.globals`
+static ObjNative natives[] = {
+  NATIVE("clock", clockNative),
+  NATIVE("heapLimit", heapLimitNative),
+  NATIVE("spawn", spawnNative),
+  NATIVE("send", sendNative),
+  NATIVE("receive", receiveNative),
+  NATIVE("self", selfNative),
+  NATIVE("parent", parentNative),
+  NATIVE("resume", resumeNative),
+  NATIVE("yield", yieldNative),
+  NATIVE("done", doneNative),
+  NATIVE("async", asyncNative),
+  NATIVE("loop", loopNative),
+  NATIVE("sleep", sleepNative),
+  NATIVE("open", openNative),
+  NATIVE("listen", listenNative),
+  NATIVE("connect", connectNative),
+  NATIVE("accept", acceptNative),
+  NATIVE("read", readNative),
+  NATIVE("write", writeNative),
+  NATIVE("close", closeNative),
+  NATIVE("lines", linesNative),
+  NATIVE("nextLine", nextLineNative),
+  NATIVE("append", appendNative),
+  NATIVE("length", lengthNative),
+  NATIVE("sum", sumNative),
+  NATIVE("dot", dotNative),
+  NATIVE("map", mapNative),
+  NATIVE("sort", sortNative),
+  NATIVE("has", hasNative),
+  NATIVE("remove", removeNative),
+  NATIVE("keys", keysNative),
+  NATIVE("values", valuesNative),
+  NATIVE("reserve", reserveNative),
+  NATIVE("substring", substringNative),
+  NATIVE("indexOf", indexOfNative),
+  NATIVE("split", splitNative),
+};
+
+static ObjNative *findNative(ObjString *name) {
+  for (int i = 0; i < (int)(sizeof(natives) / sizeof(natives[0])); i++) {
+    if (
+      strlen(natives[i].name) == (size_t)name->length &&
+      memcmp(natives[i].name, name->chars, name->length) == 0
+    ) {
+      return &natives[i];
+    }
+  }
+
+  return NULL;
+}
+
+void initVM(VM *vm) {
+  // allocated by the first push, setting up a vm doesn't allocate (see `Heap.regions`)
+  vm->stack = NULL;
+  vm->stackEnd = NULL;
+
+  resetStack(vm);
+
+  vm->coroutine = NULL;
+  vm->coroutines = NULL;
+  vm->runs = 0;
+
+  vm->out = stdout;
+  vm->err = stderr;
+
+  vm->shared = NULL;
+  vm->epochRecord = NULL;
+
+  vm->actor = NULL;
+  vm->loop = NULL;
+  vm->files = NULL;
+  vm->borrowSource = false;
+
+  vm->slice = 0;
+  vm->budget = 0;
+
+  // no limit until the host sets one
+  initHeap(&vm->heap);
+
+  initTable(&vm->globals, &vm->heap);
+  initInternSet(&vm->strings, &vm->heap);
+}
+
+void freeVM(VM *vm) {
+  // the actors the vm spawned give their shared strings back when they finish, so they have to be done before the table can go
+  if (vm->actor != NULL) stopActors(vm);
+
+  // give back the shared strings while `vm.strings` still says which ones it holds
+  if (vm->shared != NULL) detachSharedStrings(vm);
+
+  if (vm->actor != NULL) freeActors(vm);
+
+  // the loop's list of handles points into the heap
+  if (vm->loop != NULL) freeEventLoop(vm);
+  if (vm->files != NULL) freeLines(vm);
+
+  if (vm->heap.regions) {
+    // all of it lives in the regions, so there's no need to visit every object
+    freeRegions(&vm->heap);
+
+    initTable(&vm->globals, &vm->heap);
+    initInternSet(&vm->strings, &vm->heap);
+  } else {
+    leaveCoroutines(vm);
+
+    FREE_ARRAY(
+      &vm->heap,
+      MEMORY_STACK,
+      Value,
+      vm->stack,
+      vm->stackEnd - vm->stack
+    );
+
+    freeTable(&vm->globals);
+    freeInternSet(&vm->strings);
+    freeObjects(&vm->heap);
+  }
+
+  freePools(&vm->heap);
+}
+
+typedef struct {
+  VM *vm;
+  const char *start;
+  const char *end;
+} Release;
+
+static void releaseString(
+  ObjString *string,
+  void *context
+) {
+  Release *release = context;
+
+  if (
+    string->obj.flags & OBJ_BORROWED &&
+    string->chars >= release->start &&
+    string->chars < release->end
+  ) {
+    ownString(release->vm, string);
+  }
+}
+
+void releaseSource(
+  VM *vm,
+  const char *source,
+  size_t length
+) {
+  // the compiler interns everything it makes, so they're all in the set
+  Release release = {vm, source, source + length};
+
+  internSetForEach(&vm->strings, releaseString, &release);
+}
+
+// moves the stack, so nothing may hold on to a pointer into it across a push
+static void growStack(VM *vm) {
+  int count = (int)(vm->stackTop - vm->stack);
+  int oldCapacity = (int)(vm->stackEnd - vm->stack);
+  int capacity = GROW_CAPACITY(oldCapacity);
+
+  vm->stack = GROW_ARRAY(
+    &vm->heap,
+    MEMORY_STACK,
+    Value,
+    vm->stack,
+    oldCapacity,
+    capacity
+  );
+
+  vm->stackTop = vm->stack + count;
+  vm->stackEnd = vm->stack + capacity;
 }
 
-void push(Value value) {
-  *vm.stackTop = value;
-  vm.stackTop++;
+void push(
+  VM *vm,
+  Value value
+) {
+  if (vm->stackTop == vm->stackEnd) growStack(vm);
+
+  *vm->stackTop = value;
+  vm->stackTop++;
 }
 
-Value pop() {
+Value pop(VM *vm) {
   // no deletion necessary, this is enough to mark that slot as no longer in use --- why? how?
-  vm.stackTop--;
+  vm->stackTop--;
 
-  return *vm.stackTop;
+  return *vm->stackTop;
 }
 
-static Value peek(int distance) {
-  return vm.stackTop[-1 - distance];
+static Value peek(
+  VM *vm,
+  int distance
+) {
+  return vm->stackTop[-1 - distance];
 }
 
 static bool isFalsey(Value value) {
@@ -73,13 +480,13 @@ static bool isFalsey(Value value) {
   );
 }
 
-static void concatenate() {
-  ObjString *b = AS_STRING(pop());
-  ObjString *a = AS_STRING(pop());
+static void concatenate(VM *vm) {
+  ObjString *b = AS_STRING(pop(vm));
+  ObjString *a = AS_STRING(pop(vm));
 
   int length = a->length + b->length;
 
-  char *chars = ALLOCATE(char, length + 1);
+  char *chars = ALLOCATE(&vm->heap, MEMORY_STRING_CHARS, char, length + 1);
 
   memcpy(
     chars,
@@ -95,40 +502,56 @@ static void concatenate() {
 
   chars[length] = '\0';
 
-  ObjString *result = takeString(chars, length);
+  ObjString *result = takeString(vm, chars, length);
 
-  push(OBJ_VAL(result));
+  push(vm, OBJ_VAL(result));
 }
 
-static InterpretResult run() {
+static InterpretResult run(VM *vm) {
 
 // read a byte and advance the instruction pointer
-#define READ_BYTE() (*vm.ip++)
+#define READ_BYTE() (*vm->ip++)
 
 // next byte is an index for a constant
-#define READ_CONSTANT() (vm.chunk->constants.values[READ_BYTE()])
+#define READ_CONSTANT() (vm->chunk->constants.values[READ_BYTE()])
 
 // next two bytes are a u16
 #define READ_SHORT() \
-  (vm.ip += 2, (uint16_t)((vm.ip[-2] << 8) | vm.ip[-1]))
+  (vm->ip += 2, (uint16_t)((vm->ip[-2] << 8) | vm->ip[-1]))
 
 // next byte is an index for a constant that's a string object
 #define READ_STRING() AS_STRING(READ_CONSTANT())
 
+// after an instruction that may have allocated: stop if that took the vm over its heap limit
+#define CHECK_HEAP() \
+  do { \
+    if (vm->heap.exhausted) { \
+      runtimeError(vm, "Out of memory."); \
+      return INTERPRET_RUNTIME_ERROR; \
+    } \
+  } while (false)
+
+// the only places a yield is needed: code without backward jumps or calls finishes in at most as many steps as it has instructions
+// with no slice the budget starts at LONG_MAX, which never runs out, so this is one subtraction and one branch either way
+#define CHARGE(cost) \
+  do { \
+    if ((vm->budget -= (cost)) <= 0) return INTERPRET_YIELD; \
+  } while (false)
+
 #define BINARY_OP(valueType, op) \
   do { \
     if ( \
-      !IS_NUMBER(peek(0)) || \
-      !IS_NUMBER(peek(1)) \
+      !IS_NUMBER(peek(vm, 0)) || \
+      !IS_NUMBER(peek(vm, 1)) \
     ) { \
-      runtimeError("Operands must be numbers."); \
+      runtimeError(vm, "Operands must be numbers."); \
       return INTERPRET_RUNTIME_ERROR; \
     } \
     \
-    double b = AS_NUMBER(pop()); \
-    double a = AS_NUMBER(pop()); \
+    double b = AS_NUMBER(pop(vm)); \
+    double a = AS_NUMBER(pop(vm)); \
     \
-    push(valueType(a op b)); \
+    push(vm, valueType(a op b)); \
   } while (false)
 
   for (;;) {
@@ -138,22 +561,22 @@ static InterpretResult run() {
     printf("          ");
 
     for (
-      Value *slot = vm.stack;
-      slot < vm.stackTop;
+      Value *slot = vm->stack;
+      slot < vm->stackTop;
       slot++
     ) {
       printf("[ ");
-      printValue(*slot);
+      printValue(stdout, *slot);
       printf(" ]");
     }
 
     printf("\n");
 
     disassembleInstruction(
-      vm.chunk,
+      vm->chunk,
 
-      // convert `vm.ip` to a relative offset from the beginning of the bytecode
-      (int)(vm.ip - vm.chunk->code)
+      // convert `vm->ip` to a relative offset from the beginning of the bytecode
+      (int)(vm->ip - vm->chunk->code)
     );
 
 #endif
@@ -164,25 +587,25 @@ static InterpretResult run() {
 
       case OP_CONSTANT: {
         Value constant = READ_CONSTANT();
-        push(constant);
+        push(vm, constant);
         break;
       }
 
-      case OP_NIL: push(NIL_VAL); break;
-      case OP_TRUE: push(BOOL_VAL(true)); break;
-      case OP_FALSE: push(BOOL_VAL(false)); break;
+      case OP_NIL: push(vm, NIL_VAL); break;
+      case OP_TRUE: push(vm, BOOL_VAL(true)); break;
+      case OP_FALSE: push(vm, BOOL_VAL(false)); break;
 
-      case OP_POP: pop(); break;
+      case OP_POP: pop(vm); break;
 
       case OP_GET_LOCAL: {
         uint8_t slot = READ_BYTE();
-        push(vm.stack[slot]);
+        push(vm, vm->stack[slot]);
         break;
       }
 
       case OP_SET_LOCAL: {
         uint8_t slot = READ_BYTE();
-        vm.stack[slot] = peek(0);
+        vm->stack[slot] = peek(vm, 0);
         break;
       }
 
@@ -191,15 +614,29 @@ static InterpretResult run() {
         Value value;
 
         if (!tableGet(
-          &vm.globals,
+          &vm->globals,
           name,
           &value
         )) {
-          runtimeError("Undefined variable '%s'.", name->chars);
-          return INTERPRET_RUNTIME_ERROR;
+          ObjNative *native = findNative(name);
+
+          if (native == NULL) {
+            runtimeError(vm, "Undefined variable '%.*s'.", name->length, name->chars);
+            return INTERPRET_RUNTIME_ERROR;
+          }
+
+          value = OBJ_VAL(native);
+
+          tableSet(
+            &vm->globals,
+            name,
+            value
+          );
+
+          CHECK_HEAP();
         }
 
-        push(value);
+        push(vm, value);
 
         break;
       }
@@ -208,13 +645,15 @@ static InterpretResult run() {
         ObjString *name = READ_STRING();
 
         tableSet(
-          &vm.globals,
+          &vm->globals,
           name,
-          peek(0)
+          peek(vm, 0)
         );
 
         // pop after the above statement so that the vm can find the the value (when gc'ing) even if we're in the middle of adding it to the hash table
-        pop();
+        pop(vm);
+
+        CHECK_HEAP();
 
         break;
       }
@@ -225,24 +664,107 @@ static InterpretResult run() {
         // couldn't we just have a `tableHas` that just checks whether it's there instead of inserting and then deleting right after when we have an undefined variable?
 
         if (tableSet(
-          &vm.globals,
+          &vm->globals,
           name,
-          peek(0)
-        )) {
-          tableDelete(&vm.globals, name);
+          peek(vm, 0)
+        ) && findNative(name) == NULL) {
+          tableDelete(&vm->globals, name);
           
-          runtimeError("Undefined variable '%s'.", name->chars);
+          runtimeError(vm, "Undefined variable '%.*s'.", name->length, name->chars);
+
+          return INTERPRET_RUNTIME_ERROR;
+        }
+
+        CHECK_HEAP();
+
+        break;
+      }
+
+      case OP_LIST: {
+        int count = READ_BYTE();
+        ObjList *list = newList(vm);
+
+        for (int i = count; i > 0; i--) {
+          listAppend(vm, list, peek(vm, i - 1));
+        }
+
+        vm->stackTop -= count;
+
+        push(vm, OBJ_VAL(list));
+
+        CHECK_HEAP();
+
+        break;
+      }
+
+      case OP_MAP: {
+        int count = READ_BYTE();
+        ObjMap *map = newMap(vm);
+
+        // one table for all of them, instead of growing it along the way
+        tableReserve(&map->table, count);
+
+        for (int i = count; i > 0; i--) {
+          if (!mapSet(
+            vm,
+            map,
+            peek(vm, 2 * i - 1),
+            peek(vm, 2 * i - 2)
+          )) {
+            return INTERPRET_RUNTIME_ERROR;
+          }
+        }
+
+        vm->stackTop -= 2 * count;
+
+        push(vm, OBJ_VAL(map));
+
+        CHECK_HEAP();
+
+        break;
+      }
+
+      case OP_GET_INDEX: {
+        Value index = pop(vm);
+        Value container = pop(vm);
+        Value element;
+
+        if (!(IS_MAP(container)
+          ? mapGet(vm, AS_MAP(container), index, &element)
+          : listGet(vm, container, index, &element)
+        )) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+
+        push(vm, element);
+
+        break;
+      }
+
+      case OP_SET_INDEX: {
+        Value element = pop(vm);
+        Value index = pop(vm);
+        Value container = pop(vm);
 
+        if (!(IS_MAP(container)
+          ? mapSet(vm, AS_MAP(container), index, element)
+          : listSet(vm, container, index, element)
+        )) {
           return INTERPRET_RUNTIME_ERROR;
         }
 
+        // an assignment is an expression, its value is what was assigned
+        push(vm, element);
+
+        CHECK_HEAP();
+
         break;
       }
 
       case OP_EQUAL: {
-        Value b = pop();
-        Value a = pop();
-        push(BOOL_VAL(valuesEqual(a, b)));
+        Value b = pop(vm);
+        Value a = pop(vm);
+        push(vm, BOOL_VAL(valuesEqual(a, b)));
         break;
       }
 
@@ -251,19 +773,20 @@ static InterpretResult run() {
 
       case OP_ADD: {
         if (
-          IS_STRING(peek(0)) &&
-          IS_STRING(peek(1))
+          IS_STRING(peek(vm, 0)) &&
+          IS_STRING(peek(vm, 1))
         ) {
-          concatenate();
+          concatenate(vm);
+          CHECK_HEAP();
         } else if (
-          IS_NUMBER(peek(0)) &&
-          IS_NUMBER(peek(1))
+          IS_NUMBER(peek(vm, 0)) &&
+          IS_NUMBER(peek(vm, 1))
         ) {
-          double b = AS_NUMBER(pop());
-          double a = AS_NUMBER(pop());
-          push(NUMBER_VAL(a + b));
+          double b = AS_NUMBER(pop(vm));
+          double a = AS_NUMBER(pop(vm));
+          push(vm, NUMBER_VAL(a + b));
         } else {
-          runtimeError("Operands must be two numbers or two strings.");
+          runtimeError(vm, "Operands must be two numbers or two strings.");
           return INTERPRET_RUNTIME_ERROR;
         }
         break;
@@ -274,35 +797,38 @@ static InterpretResult run() {
       case OP_DIVIDE: BINARY_OP(NUMBER_VAL, /); break;
 
       case OP_NOT:
-        push(BOOL_VAL(isFalsey(pop())));
+        push(vm, BOOL_VAL(isFalsey(pop(vm))));
         break;
 
       case OP_NEGATE:
-        if (!IS_NUMBER(peek(0))) {
-          runtimeError("Operand must be a number.");
+        if (!IS_NUMBER(peek(vm, 0))) {
+          runtimeError(vm, "Operand must be a number.");
           return INTERPRET_RUNTIME_ERROR;
         }
 
-        push(NUMBER_VAL(-AS_NUMBER(pop())));
+        push(vm, NUMBER_VAL(-AS_NUMBER(pop(vm))));
 
         break;
 
       case OP_PRINT: {
-        printValue(pop());
-        printf("\n");
+        // actors print to the same stream from different threads, keep each line in one piece
+        flockfile(vm->out);
+        printValue(vm->out, pop(vm));
+        fputc('\n', vm->out);
+        funlockfile(vm->out);
         break;
       }
 
       case OP_JUMP: {
         uint16_t offset = READ_SHORT();
-        vm.ip += offset;
+        vm->ip += offset;
         break;
       }
 
       case OP_JUMP_IF_FALSE: {
         uint16_t offset = READ_SHORT();
 
-        if (isFalsey(peek(0))) vm.ip += offset;
+        if (isFalsey(peek(vm, 0))) vm->ip += offset;
 
         break;
       }
@@ -310,7 +836,65 @@ static InterpretResult run() {
       case OP_LOOP: {
         uint16_t offset = READ_SHORT();
         
-        vm.ip -= offset;
+        vm->ip -= offset;
+
+        CHARGE(offset);
+
+        break;
+      }
+
+      case OP_CALL: {
+        int argCount = READ_BYTE();
+        Value callee = peek(vm, argCount);
+
+        if (!IS_NATIVE(callee)) {
+          runtimeError(vm, "Can only call functions.");
+          return INTERPRET_RUNTIME_ERROR;
+        }
+
+        Value *args = vm->stackTop - argCount;
+
+        // the arguments are still there for the native to read, and the callee's slot is where its result goes
+        vm->stackTop = args;
+
+        if (!AS_NATIVE(callee)->function(vm, argCount, args)) return INTERPRET_RUNTIME_ERROR;
+
+        CHECK_HEAP();
+        CHARGE(1);
+
+        break;
+      }
+
+      case OP_COROUTINE: {
+        uint16_t length = READ_SHORT();
+
+        push(vm, OBJ_VAL(newCoroutine(vm, vm->ip)));
+
+        // over the body
+        vm->ip += length;
+
+        CHECK_HEAP();
+
+        break;
+      }
+
+      case OP_FINISH: {
+        // the end of a coroutine's body, only ever reached by a running coroutine
+        ObjCoroutine *coroutine = vm->coroutine;
+
+        returnToCaller(vm, COROUTINE_DONE, NIL_VAL);
+
+        Fiber *fiber = &coroutine->fiber;
+
+        FREE_ARRAY(
+          &vm->heap,
+          MEMORY_STACK,
+          Value,
+          fiber->stack,
+          fiber->stackEnd - fiber->stack
+        );
+
+        *fiber = (Fiber){NULL, NULL, NULL, NULL};
 
         break;
       }
@@ -327,23 +911,68 @@ static InterpretResult run() {
 #undef READ_CONSTANT
 #undef READ_STRING
 #undef BINARY_OP
+#undef CHECK_HEAP
+#undef CHARGE
 
 }
 
-InterpretResult interpret(const char *source) {
-  Chunk chunk;
+InterpretResult compileChunk(
+  VM *vm,
+  const char *source,
+  Chunk *chunk
+) {
+  // the heap may have gone over the limit during an earlier run, give it another chance (it's still over if the memory wasn't freed, and then the next allocation says so again)
+  vm->heap.exhausted = false;
 
-  initChunk(&chunk);
+  if (!compile(vm, source, chunk)) return INTERPRET_COMPILE_ERROR;
 
-  if (!compile(source, &chunk)) {
-    freeChunk(&chunk);
-    return INTERPRET_COMPILE_ERROR;
+  // the compiler's allocations (constants, identifiers) count too
+  if (vm->heap.exhausted) {
+    fprintf(vm->err, "Out of memory.\n");
+    return INTERPRET_RUNTIME_ERROR;
   }
 
-  vm.chunk = &chunk;
-  vm.ip = vm.chunk->code;
+  return INTERPRET_OK;
+}
+
+InterpretResult runChunk(
+  VM *vm,
+  Chunk *chunk
+) {
+  vm->heap.exhausted = false;
+
+  leaveCoroutines(vm);
+  resetStack(vm);
+
+  if (vm->loop != NULL) resetEventLoop(vm);
+
+  vm->runs++;
+  vm->chunk = chunk;
+  vm->ip = vm->chunk->code;
+
+  return resumeChunk(vm);
+}
+
+InterpretResult resumeChunk(VM *vm) {
+  vm->budget = vm->slice > 0 ? vm->slice : LONG_MAX;
+
+  return run(vm);
+}
+
+InterpretResult interpret(
+  VM *vm,
+  const char *source
+) {
+  Chunk chunk;
+
+  initChunk(&chunk, &vm->heap);
+
+  InterpretResult result = compileChunk(vm, source, &chunk);
+
+  if (result == INTERPRET_OK) result = runChunk(vm, &chunk);
 
-  InterpretResult result = run();
+  // a host that sets a slice and still calls `interpret` just gets the whole run
+  while (result == INTERPRET_YIELD) result = resumeChunk(vm);
 
   freeChunk(&chunk);
 
@@ -2,46 +2,107 @@
 #define clox_vm_h
 
 #include "chunk.h"
+#include "intern.h"
+#include "memory.h"
 #include "table.h"
 #include "value.h"
 
-#define STACK_MAX 256
-
-typedef struct {
+// everything one interpreter needs, nothing is shared between vms
+// so as long as each vm is only used by one thread at a time, different threads can run different vms in parallel
+struct VM {
   Chunk *chunk;
 
   // instruction pointer
   // points to the *next* instruction, not the current one
   uint8_t *ip;
 
-  // the value stack
-  Value stack[STACK_MAX];
+  // the value stack of whatever runs right now, the main script or a coroutine
+  // starts out empty and grows on demand (see `push`), so a coroutine that's never deep costs a few slots only
+  Value *stack;
   Value *stackTop; // exclusive (one after the last element)
+  Value *stackEnd; // one past the last slot there's room for
+
+  // the coroutine that runs right now (NULL for the main script), and the main script's stack and ip while it doesn't
+  struct ObjCoroutine *coroutine;
+  Fiber main;
+
+  // every coroutine made that may still run, so whatever needs to see all the stacks can find them (see lines.c)
+  // the finished ones are only dropped from it the next time it's walked
+  struct ObjCoroutine *coroutines;
+
+  // how many chunks the vm has started running, coroutines belong to the run that made them
+  uint32_t runs;
 
   // global variable table
   Table globals;
 
   // interned strings (hash set)
-  Table strings;
+  InternSet strings;
+
+  // where `print` and error messages go, stdout and stderr unless the host redirects them
+  FILE *out;
+  FILE *err;
+
+  // a process wide intern table the vm shares with others, NULL unless it's been attached (see shared.h)
+  struct SharedStrings *shared;
+  struct EpochRecord *epochRecord;
+
+  // the actor the vm runs (see actor.h), NULL until the script spawns one or is one
+  struct Actor *actor;
+
+  // handles, timers and the coroutines waiting on them (see io.h), NULL until the script does any i/o
+  struct EventLoop *loop;
 
-  // linked list of objects
-  Obj *objects;
-} VM;
+  // files mapped with `lines` (see lines.h)
+  struct ObjLines *files;
+
+  // the host keeps the source it compiles around for as long as the strings made from it (see source.h)
+  // so the compiler's identifiers and string literals borrow their characters from the source instead of copying them, until `releaseSource`
+  bool borrowSource;
+
+  // how much `run` may do before it hands the thread back (see `INTERPRET_YIELD`), 0 for no limit
+  // measured in bytecode bytes: a backward jump costs the length of the loop it closes, and a call costs one
+  long slice;
+  long budget; // what's left of the current slice
+
+  // everything the vm allocates, objects included, and how much of it it may use (see `Heap`)
+  Heap heap;
+};
 
 typedef enum {
   INTERPRET_OK,
   INTERPRET_COMPILE_ERROR,
-  INTERPRET_RUNTIME_ERROR
+  INTERPRET_RUNTIME_ERROR,
+
+  // the vm used up its slice and stopped at a loop or after a call, `resumeChunk` carries on where it left off
+  INTERPRET_YIELD
 } InterpretResult;
 
-extern VM vm;
+void initVM(VM *vm);
+void freeVM(VM *vm);
+
+InterpretResult interpret(VM *vm, const char *source);
+
+// the two halves of `interpret`, for hosts that run the same program more than once (see server.c)
+// `chunk` has to be initialized with `initChunk` on this vm's heap, and is the caller's to free, whether or not it compiled
+InterpretResult compileChunk(VM *vm, const char *source, Chunk *chunk);
+InterpretResult runChunk(VM *vm, Chunk *chunk);
+InterpretResult resumeChunk(VM *vm);
+
+// gives every string that borrows from `source` its own copy, before the host frees or unmaps it while the vm lives on
+void releaseSource(VM *vm, const char *source, size_t length);
+
+// reports an error at the current instruction and resets the stack, for natives as well as the vm itself
+void runtimeError(VM *vm, const char *format, ...);
 
-void initVM();
-void freeVM();
+// for natives that take a fixed number of arguments: false, after a runtime error, if they got a different number
+bool checkArity(VM *vm, int expected, int argCount);
 
-InterpretResult interpret(const char *source);
+// switching between the main script and coroutines: where the running one's stack and ip are kept while it doesn't run
+void saveFiber(VM *vm, Fiber *fiber);
+void loadFiber(VM *vm, Fiber *fiber);
 
-void push(Value value);
-Value pop();
+void push(VM *vm, Value value);
+Value pop(VM *vm);
 
 #endif
\ No newline at end of file